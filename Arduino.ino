@@ -1,19 +1,42 @@
 
 #include <Arduino.h>
 #include <SoftwareSerial.h>
+#include "src/I2CBus.h"
 #include "src/LiquidCrystal_I2C.h"
+#include "src/OledDisplay.h"
 #include "src/SdFat/SdFat.h"
 #include "src/SimpleGPS.h"
 #include "src/MS5611.h"
 #include "src/SimpleVario.h"
 #include "src/IGCFileRecorder.h"
+#include "src/JournalLog.h"
 #include "src/Utils.h"
+#include "src/FlightScreen.h"
 #include "src/Units/UnitSpeed.h"
 #include "src/Units/UnitLength.h"
 #include "src/Units/Measurement.h"
 #include "src/Settings.h"
+#include "src/CardBenchmark.h"
 
+// Climb bar on the left of the second line, climb rate of either end in m/s
+#define CLIMB_BAR_CELLS 8
+#define CLIMB_BAR_RANGE 4.0
+// Redrawn ten times a second, only cells with a new level go out
+#define CLIMB_BAR_MILLIS 100
+
+// Barometer and display, the barometer has its slots
+static I2CBus m_bus(Wire);
+#if LCD_ON_WIRE1
+static I2CBus m_displayBus(Wire1);
+#endif
+#if DISPLAY_OLED
+static OledDisplay m_lcd(OLED_ADDRESS, 16, 2, OLED_SH1106 ? OledDisplay::kSH1106 : OledDisplay::kSSD1306);
+// Pages of the OLED go by DMA
+#define DISPLAY_BUS_MODE I2C_OP_MODE_DMA
+#else
 static LiquidCrystal_I2C m_lcd(0x3F, 16, 2);
+#define DISPLAY_BUS_MODE I2C_OP_MODE_ISR
+#endif
 static SoftwareSerial m_gpsSerial(0, 1);
 static SimpleGPS m_gps(&m_gpsSerial);
 static MS5611 m_ms5611;
@@ -30,21 +53,36 @@ static bool m_manualAltitude = false;
 static bool m_hasSdCard = false;
 static bool m_showFlighTime = true;
 static bool m_showTotalDistance = false;
+static bool m_showClimbBar = false;
+static uint32_t m_climbBarTimer = 0;
 
 static void adjustAltitude();
 static void updateLCD();
+static void updateClimbBar();
 static void applySettings();
 static void checkForSettings();
 static void checkInflightOptions();
 static void setClock();
+static void showCardSpace();
+static void runCardBenchmark();
 
 void setup()
 {
 	m_gpsSerial.begin(9600);
 	m_gps.begin();
 	m_vario.begin(21);
-	m_ms5611.begin();
+#if LCD_ON_WIRE1
+	m_bus.begin(I2C_PINS_18_19);
+	m_displayBus.begin(I2C_PINS_29_30, I2C_BUS_RATE, DISPLAY_BUS_MODE);
+	m_lcd.setBus(&m_displayBus);
+#else
+	m_bus.begin(I2C_PINS_18_19, I2C_BUS_RATE, DISPLAY_BUS_MODE);
+	m_lcd.setBus(&m_bus);
+#endif
+	m_ms5611.begin(m_bus);
+	m_ms5611.startSampling();
 	m_lcd.begin(16, 2);
+	m_lcd.init_bargraph(LCDI2C_CENTER_BAR_GRAPH);
 	m_settings.begin(14, 16, 15);
 
 	m_lcd.backlight();
@@ -67,13 +105,31 @@ void setup()
 	else
 	{
 		m_hasSdCard = true;
+		// Repair a flight cut short by a power loss, bounded to a few reads
+		if (JournalLog::recover())
+		{
+			lcdPrint(m_lcd, "Recovered flight", "", true);
+			delay(1000);
+		}
 	}
 	m_settings.setLCD(m_lcd);
 	m_settings.hasSdCard(m_hasSdCard);
 	m_settings.readSettings();
 	m_recorder.setPilotName(m_settings.pilotName());
 	m_recorder.setGliderType(m_settings.gliderModel());
+	m_recorder.setLogRate(m_settings.logRate());
+	m_recorder.setLogFormats(m_settings.logsIGC(), m_settings.logsBinary(), m_settings.logsJournal());
+	m_recorder.setDetectionWindows(m_settings.takeoffSeconds(), m_settings.landingSeconds());
+	// GPS stays at 4Hz unless logging needs more
+	if (m_settings.logRate() > 4)
+	{
+		m_gps.setUpdateRate(m_settings.logRate());
+	}
 	applySettings();
+	if (m_hasSdCard)
+	{
+		showCardSpace();
+	}
 	m_vario.initialBeep();
 
 }
@@ -101,37 +157,168 @@ void loop()
 	}
 	// update GPS
 	m_gps.update();
-	// update vario
-	m_vario.update(m_ms5611.getPressure());
+	// update vario when the barometer has a new sample, it converts while the loop runs
+	if (m_ms5611.update())
+	{
+		m_vario.update(m_ms5611.pressure());
+	}
 	// update file recorder
 	m_recorder.update(m_gps, m_vario);
-	// update LCD
+	// update LCD, the screen goes out in the background
 	updateLCD();
+	updateClimbBar();
+	m_lcd.update();
 }
 
-static void showResults()
+// Hours of flight the card has room for, warns before a flight if that is short
+static void showCardSpace()
+{
+	const double lowHours = 3;
+	// Kept by the FAT32 FSINFO sector, no scan of the whole FAT
+	int32_t clusters = m_sd.vol()->freeClusterCount();
+	if (clusters < 0) return;
+	double hours = (double)clusters * m_sd.vol()->blocksPerCluster() * 512 / m_recorder.bytesPerHour();
+	lcdPrint(m_lcd, hours < lowHours ? "CARD ALMOST FULL" : "SD card space", "", true);
+	lcdPrint(m_lcd, String(hours, hours < 10 ? 1 : 0) + " hours left", "", false);
+	delay(hours < lowHours ? 3000 : 1000);
+}
+
+// Writes a report of how the card copes with logging, see CardBenchmark
+static void runCardBenchmark()
+{
+	CardBenchmark benchmark(m_sd.card());
+	lcdPrint(m_lcd, "Card benchmark", "Sequential...", true);
+	bool done = benchmark.begin() && benchmark.sequentialWrite();
+	if (done)
+	{
+		lcdPrint(m_lcd, "", "Random...", false);
+		done = benchmark.randomWrite();
+	}
+	// Report whatever ran, the scratch file goes either way
+	done = benchmark.end() && done;
+	if (!done)
+	{
+		lcdPrint(m_lcd, "Card benchmark", "FAILED", true);
+		delay(3000);
+		return;
+	}
+	const CardBenchmark::result& sequential = benchmark.sequential();
+	const CardBenchmark::result& random = benchmark.random();
+	uint32_t stalls = sequential.stalls + random.stalls;
+	uint32_t maxMillis = max(sequential.maxMicros, random.maxMicros) / 1000;
+	lcdPrint(m_lcd, "Write KB/s", String(CardBenchmark::kilobytesPerSecond(sequential), 0), true);
+	lcdPrint(m_lcd, "Max ms", String(maxMillis), false);
+	delay(3000);
+	// Report name without the folder
+	lcdPrint(m_lcd, "Stalls", String(stalls), true);
+	lcdPrint(m_lcd, benchmark.reportPath().substring(sizeof(BENCH_FOLDER)), "", false);
+	delay(3000);
+}
+
+static void showResultsPage(int page)
 {
-	Measurement<UnitLength> distance(m_recorder.travelledDistance(), UnitLength::kilometers());
-	Measurement<UnitLength> altitude(m_recorder.highestAltitude(), UnitLength::meters());
-	if (!m_useMetricSystem)
+	const FlightStatistics& stats = m_recorder.statistics();
+	Measurement<UnitSpeed> maxClimb(stats.maxClimb(), UnitSpeed::metersPerSecond());
+	Measurement<UnitSpeed> maxSink(stats.maxSink(), UnitSpeed::metersPerSecond());
+	Measurement<UnitSpeed> averageClimb(stats.averageClimb(), UnitSpeed::metersPerSecond());
+	Measurement<UnitSpeed> bestClimb(stats.bestClimb(), UnitSpeed::metersPerSecond());
+	Measurement<UnitSpeed> maxSpeed(stats.maxSpeed(), UnitSpeed::knots());
+	Measurement<UnitLength> gain(stats.altitudeGain(), UnitLength::meters());
+	if (m_useMetricSystem)
+	{
+		maxClimb = maxClimb.convertedTo(UnitSpeed::metersPerSecond(), 0.1);
+		maxSink = maxSink.convertedTo(UnitSpeed::metersPerSecond(), 0.1);
+		averageClimb = averageClimb.convertedTo(UnitSpeed::metersPerSecond(), 0.1);
+		bestClimb = bestClimb.convertedTo(UnitSpeed::metersPerSecond(), 0.1);
+		maxSpeed = maxSpeed.convertedTo(UnitSpeed::kilometersPerHour());
+	}
+	else
 	{
-		distance = distance.convertedTo(UnitLength::miles(), 0.25);
-		altitude = altitude.convertedTo(UnitLength::feet());
+		maxClimb = maxClimb.convertedTo(UnitSpeed::feetPerMinute(), 10);
+		maxSink = maxSink.convertedTo(UnitSpeed::feetPerMinute(), 10);
+		averageClimb = averageClimb.convertedTo(UnitSpeed::feetPerMinute(), 10);
+		bestClimb = bestClimb.convertedTo(UnitSpeed::feetPerMinute(), 10);
+		maxSpeed = maxSpeed.convertedTo(UnitSpeed::milesPerHour());
+		gain = gain.convertedTo(UnitLength::feet());
 	}
-	auto totalTime = m_recorder.totalTime();
-	lcdPrint(m_lcd, "Stats:", altitude.description(), true); 
-	lcdPrint(m_lcd, totalTime, distance.description(), false);
 
-	m_recorder.reset();
-	m_showFlighTime = true;
-	m_showTotalDistance = false;
+	switch (page)
+	{
+		case 0:
+		{
+			Measurement<UnitLength> distance(m_recorder.travelledDistance(), UnitLength::kilometers());
+			Measurement<UnitLength> altitude(m_recorder.highestAltitude(), UnitLength::meters());
+			if (!m_useMetricSystem)
+			{
+				distance = distance.convertedTo(UnitLength::miles(), 0.25);
+				altitude = altitude.convertedTo(UnitLength::feet());
+			}
+			char duration[CLOCK_TEXT_SIZE];
+			formatDuration(duration, stats.duration());
+			lcdPrint(m_lcd, "Stats:", altitude, true);
+			lcdPrint(m_lcd, duration, distance, false);
+			break;
+		}
+		case 1:
+			lcdPrint(m_lcd, "Climb", maxClimb, true);
+			lcdPrint(m_lcd, "Sink", maxSink, false);
+			break;
+		case 2:
+			lcdPrint(m_lcd, "Avg", averageClimb, true);
+			lcdPrint(m_lcd, "Best 30s", bestClimb, false);
+			break;
+		case 3:
+		{
+			char count[MEASUREMENT_TEXT_SIZE];
+			char lift[CLOCK_TEXT_SIZE];
+			formatMeasure(count, sizeof(count), stats.thermalCount(), 1, 0, "");
+			formatDuration(lift, stats.liftTime());
+			lcdPrint(m_lcd, "Thermals", count, true);
+			lcdPrint(m_lcd, "Lift", lift, false);
+			break;
+		}
+		case 4:
+			lcdPrint(m_lcd, "Speed", maxSpeed, true);
+			lcdPrint(m_lcd, "Gain", gain, false);
+			break;
+		default:
+		{
+			char glide[MEASUREMENT_TEXT_SIZE] = "--";
+			if (stats.glideRatio() > 0) {
+				formatMeasure(glide, sizeof(glide), stats.glideRatio(), 0.1, 1, "");
+			}
+			lcdPrint(m_lcd, "Glide", glide, true);
+			lcdPrint(m_lcd, "", "", false);
+			break;
+		}
+	}
+}
+
+static void showResults()
+{
+	// Up and down go through the pages, menu leaves
+	const int pages = 6;
+	int page = 0;
+	showResultsPage(page);
 
 	while (true) {
-		if (m_settings.menuButtonPressed()) return;
-		if (m_settings.upButtonPressed()) return;
-		if (m_settings.downButtonPressed()) return;
+		if (m_settings.menuButtonPressed()) break;
+		if (m_settings.upButtonPressed()) {
+			page = (page + pages - 1) % pages;
+			showResultsPage(page);
+		}
+		if (m_settings.downButtonPressed()) {
+			page = (page + 1) % pages;
+			showResultsPage(page);
+		}
 		delay(20);
 	}
+
+	m_recorder.reset();
+	m_showFlighTime = true;
+	// The next flight starts on the speed line
+	m_showTotalDistance = false;
+	m_showClimbBar = false;
 }
 static void applySettings()
 {
@@ -180,6 +367,10 @@ static void checkForSettings()
 	{
 		// If over 2 seconds, get to the secondary menu
 		m_settings.promtSecondaryMenu();
+		if (m_settings.cardBenchmarkRequested())
+		{
+			runCardBenchmark();
+		}
 	}
 	else 
 	{
@@ -209,10 +400,16 @@ static void checkInflightOptions()
 		m_showFlighTime = !m_showFlighTime;
 		return;
 	}
-	// Button 2 - Toggle sink alarm
+	// Button 2 - Speed, distance or climb bar
 	if (m_settings.downButtonPressed())
 	{
-		m_showTotalDistance = !m_showTotalDistance;
+		if (m_showTotalDistance) {
+			m_showTotalDistance = false;
+			m_showClimbBar = true;
+		} else {
+			m_showTotalDistance = !m_showClimbBar;
+			m_showClimbBar = false;
+		}
 		return;
 	}
 	// Button 3 - Toggle sound
@@ -237,50 +434,83 @@ static void adjustAltitude()
 	m_timeSinceGPS = millis();
 }
 
+static void updateClimbBar()
+{
+	if (!m_showClimbBar || millis() - m_climbBarTimer < CLIMB_BAR_MILLIS) return;
+	// Five pixels a cell, half the cells each way
+	int pixels = CLIMB_BAR_CELLS / 2 * 5;
+	double fraction = constrain(m_vario.climbRate() / CLIMB_BAR_RANGE, -1.0, 1.0);
+	m_lcd.draw_center_graph(1, 0, CLIMB_BAR_CELLS, round(fraction * pixels));
+	m_climbBarTimer = millis();
+}
+
+#ifdef P_TESTING
+static void printI2CTelemetry(i2c_t3& wire)
+{
+	for (uint8_t i = 0; i < wire.telemetryCount(); i++) {
+		const i2cTelemetry& t = wire.telemetry(i);
+		Serial.println("I2C 0x" + String(t.addr, HEX) + " n/bytes/nak/timeout/arb	:" + String(t.transactions) + "/" +
+			String(t.bytes) + "/" + String(t.naks) + "/" + String(t.timeouts) + "/" + String(t.arbLost));
+		String latency = "I2C 0x" + String(t.addr, HEX) + " us <64.. max	:";
+		for (int b = 0; b < I2C_LATENCY_BUCKETS; b++) {
+			latency += String(t.latency[b]) + " ";
+		}
+		Serial.println(latency + String(t.maxMicros));
+	}
+}
+#endif
+
 static void updateLCD()
 {
 	// Update the screen once every 1/4 of a second
 	if ((millis() - m_lcd_timer) < 250) return;
 
-	String timeString;
-	String speedString;
-	String climbRateString;
-	String altitudeString;
-
-	Measurement<UnitSpeed> speed(m_gps.knots(), UnitSpeed::knots());
-	Measurement<UnitSpeed> climbRate(m_vario.climbRate(), UnitSpeed::metersPerSecond());
-	Measurement<UnitLength> rawAltitude(m_vario.altitude(), UnitLength::meters());
+	// On the stack, the screen allocates nothing in flight
+	char timeText[CLOCK_TEXT_SIZE];
+	flight_screen_text text;
 
-	if (m_recorder.recording())
-	{
-		timeString = m_showFlighTime ? m_recorder.totalTime() : readableTime();
-	}
-	else
+	if (m_recorder.recording() && m_showFlighTime)
 	{
-		timeString = m_gps.fixed() ? readableTime() : String("NO GPS");	
+		formatDuration(timeText, m_recorder.statistics().duration());
 	}
-
-	if (m_useMetricSystem)
+	else if (m_recorder.recording() || m_gps.fixed())
 	{
-		speedString = speed.convertedTo(UnitSpeed::kilometersPerHour()).description();
-		climbRateString = climbRate.convertedTo(UnitSpeed::metersPerSecond(), 0.02).description();
-		altitudeString = rawAltitude.convertedTo(UnitLength::meters()).description();
+		formatTime(timeText);
 	}
 	else
 	{
-		speedString = speed.convertedTo(UnitSpeed::milesPerHour()).description();
-		climbRateString = climbRate.convertedTo(UnitSpeed::feetPerMinute(), 25).description();
-		altitudeString = rawAltitude.convertedTo(UnitLength::feet()).description();
+		strcpy(timeText, "NO GPS");
 	}
-	lcdPrint(m_lcd, timeString, altitudeString, true);
-	if (m_showTotalDistance) {
-		Measurement<UnitLength> distance(m_recorder.travelledDistance(), UnitLength::kilometers());
-		if (!m_useMetricSystem) {
-			distance = distance.convertedTo(UnitLength::miles(), 0.25);
-		}
-		lcdPrint(m_lcd, distance.description(), climbRateString, false);
+	formatFlightScreen(&text, m_gps.knots(), m_vario.climbRate(), m_vario.altitude(),
+		m_recorder.travelledDistance(), m_useMetricSystem);
+#ifdef P_TESTING
+	// Sent by update() since the last screen
+	static uint32_t lcdBytes = 0;
+	Serial.println("LCD refresh bytes	:" + String(m_lcd.bytesSent() - lcdBytes));
+	lcdBytes = m_lcd.bytesSent();
+	const I2CBus::device_stats& baro = m_bus.stats(I2CBus::kBaro);
+	Serial.println("Baro bus us/waits	:" + String(baro.busyMicros) + "/" + String(baro.waits));
+#if LCD_ON_WIRE1
+	const I2CBus::device_stats& display = m_displayBus.stats(I2CBus::kDisplay);
+#else
+	const I2CBus::device_stats& display = m_bus.stats(I2CBus::kDisplay);
+#endif
+	Serial.println("LCD bus us/waits	:" + String(display.busyMicros) + "/" + String(display.waits));
+	Serial.println("Baro dropped samples	:" + String(m_ms5611.errors()));
+	printI2CTelemetry(Wire);
+#if LCD_ON_WIRE1
+	printI2CTelemetry(Wire1);
+#endif
+#endif
+	// A screen not fully sent yet is replaced, only its latest text goes out
+	lcdSetLine(m_lcd, timeText, text.altitude, true);
+	if (m_showClimbBar) {
+		// Leaves the bar cells to updateClimbBar()
+		lcdSetRight(m_lcd, text.climbRate, CLIMB_BAR_CELLS, false);
+	} else if (m_showTotalDistance) {
+		lcdSetLine(m_lcd, text.distance, text.climbRate, false);
 	} else {
-		lcdPrint(m_lcd, speedString, climbRateString, false);
+		lcdSetLine(m_lcd, text.speed, text.climbRate, false);
 	}
 
 	m_lcd_timer = millis();
@@ -0,0 +1,142 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include "CardBenchmark.h"
+
+static String hexNumber(uint32_t value, int digits)
+{
+	String result((unsigned long)value, HEX);
+	while ((int)result.length() < digits) {
+		result = String("0") + result;
+	}
+	result.toUpperCase();
+	return result;
+}
+
+bool CardBenchmark::begin()
+{
+	m_sequential = result();
+	m_random = result();
+	m_reportPath = "";
+	SdFile old;
+	if (old.open(BENCH_FILE, O_WRITE)) old.remove();
+	if (!m_file.createContiguous(BENCH_FILE, BENCH_SEQUENTIAL_BLOCKS * 512UL)) return false;
+	for (int i = 0; i < 512; i++) {
+		m_block[i] = i;
+	}
+#if USE_SD_LATENCY_STATS
+	m_card->latency()->reset();
+#endif
+	return true;
+}
+
+bool CardBenchmark::writeBlock(uint32_t index, result& r)
+{
+	// Different data every time, so no card can skip the write
+	memcpy(m_block, &index, sizeof(index));
+	uint32_t start = micros();
+	bool written = m_file.seekSet(index * 512UL) && m_file.write(m_block, 512) == 512;
+	uint32_t elapsed = micros() - start;
+	r.blocks++;
+	r.micros += elapsed;
+	r.maxMicros = max(r.maxMicros, elapsed);
+	if (elapsed >= SD_LATENCY_STALL_US) r.stalls++;
+	return written;
+}
+
+bool CardBenchmark::sequentialWrite()
+{
+	for (uint32_t i = 0; i < BENCH_SEQUENTIAL_BLOCKS; i++) {
+		if (!writeBlock(i, m_sequential)) return false;
+	}
+	return true;
+}
+
+bool CardBenchmark::randomWrite()
+{
+	// Same blocks on every card so reports compare
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < BENCH_RANDOM_BLOCKS; i++) {
+		seed = seed * 1103515245 + 12345;
+		if (!writeBlock((seed >> 16) % BENCH_SEQUENTIAL_BLOCKS, m_random)) return false;
+	}
+	return true;
+}
+
+bool CardBenchmark::end()
+{
+#if USE_SD_LATENCY_STATS
+	// Only the tests, not the report that follows
+	SdLatency latency = *m_card->latency();
+#endif
+	if (m_file.isOpen()) m_file.remove();
+
+	cid_t cid;
+	if (!m_card->readCID(&cid)) return false;
+	SdFile dir;
+	if (!dir.open(BENCH_FOLDER, O_READ) && !dir.mkdir(FatFile::cwd(), BENCH_FOLDER, true)) return false;
+	dir.close();
+	m_reportPath = String(BENCH_FOLDER "/") + hexNumber(cid.psn, 8) + ".TXT";
+	SdFile report;
+	if (!report.open(m_reportPath.c_str(), O_CREAT | O_WRITE | O_TRUNC)) return false;
+
+	report.println("SimpleVario card benchmark");
+	String oem = String(cid.oid[0]) + cid.oid[1];
+	String product;
+	for (int i = 0; i < 5; i++) {
+		product += cid.pnm[i];
+	}
+	report.println("Card MID " + hexNumber(cid.mid, 2) + " OEM " + oem + " " + product +
+		" rev " + cid.prv_n + "." + cid.prv_m + " serial " + hexNumber(cid.psn, 8) +
+		" date " + cid.mdt_month + "/" + (2000 + cid.mdt_year_high * 16 + cid.mdt_year_low));
+	report.println("Size " + String(m_card->cardSize() / 2048) + " MB" +
+		(m_card->type() == SD_CARD_TYPE_SDHC ? " SDHC" : " SD"));
+	printResult(report, "Sequential", m_sequential);
+	printResult(report, "Random", m_random);
+#if USE_SD_LATENCY_STATS
+	writeLatency(report, latency);
+#endif
+	return report.close();
+}
+
+void CardBenchmark::printResult(Print& out, const char* name, const result& r)
+{
+	out.println(String(name) + " " + r.blocks + " blocks " + String(kilobytesPerSecond(r), 0) +
+		" KB/s avg " + (r.blocks ? r.micros / r.blocks : 0) + " us max " + r.maxMicros +
+		" us stalls " + r.stalls);
+}
+
+#if USE_SD_LATENCY_STATS
+static const char* kOperationNames[SD_OP_COUNT] = {
+	"CMD", "READ", "WRITE", "BUSY", "ERASE"
+};
+
+void CardBenchmark::writeLatency(Print& out, const SdLatency& latency)
+{
+	out.print("Latency us");
+	for (int op = 0; op < SD_OP_COUNT; op++) {
+		out.print(String("\t") + kOperationNames[op]);
+	}
+	out.println();
+	for (int b = 0; b < SD_LATENCY_BUCKETS; b++) {
+		uint32_t limit = SdLatency::bucketLimit(b);
+		out.print(limit ? "<" + String(limit) : ">=" + String(SdLatency::bucketLimit(b - 1)));
+		for (int op = 0; op < SD_OP_COUNT; op++) {
+			out.print(String("\t") + latency.histogram(op, b));
+		}
+		out.println();
+	}
+	out.print("max");
+	for (int op = 0; op < SD_OP_COUNT; op++) {
+		out.print(String("\t") + latency.maxMicros(op));
+	}
+	out.println();
+	out.print("stalls");
+	for (int op = 0; op < SD_OP_COUNT; op++) {
+		out.print(String("\t") + latency.stallCount(op));
+	}
+	out.println();
+}
+#endif
@@ -0,0 +1,76 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef CardBenchmark_h
+#define CardBenchmark_h
+
+#include <Arduino.h>
+#include "SdFat/SdFat.h"
+
+// Scratch file, removed when done
+#define BENCH_FILE "BENCH.DAT"
+// Reports go in BENCH_FOLDER, named after the card serial number
+#define BENCH_FOLDER "/CARDS"
+// 1 MB written in order, then blocks written anywhere in it
+#define BENCH_SEQUENTIAL_BLOCKS 2048
+#define BENCH_RANDOM_BLOCKS 256
+
+/**
+ * Qualifies an SD card for logging before it goes into a unit.
+ *
+ * Both tests write one block at a time through the file, like the logs do,
+ * and time every write. The card keeps latency histograms of its commands,
+ * transfers and busy waits while they run, see SdLatency, and the report
+ * has both along with the card identification.
+ */
+class CardBenchmark
+{
+public:
+	struct result {
+		uint32_t blocks;
+		uint32_t micros;
+		uint32_t maxMicros;
+		// Writes of SD_LATENCY_STALL_US or more, long enough to glitch the audio
+		uint32_t stalls;
+	};
+
+	CardBenchmark(SdSpiCard* card) : m_card(card) {};
+	// Allocates the scratch file and clears the card statistics
+	bool begin();
+	bool sequentialWrite();
+	bool randomWrite();
+	// Writes the report and removes the scratch file
+	bool end();
+
+	const result& sequential() const {
+		return m_sequential;
+	}
+	const result& random() const {
+		return m_random;
+	}
+	// Path of the report written by end()
+	const String& reportPath() const {
+		return m_reportPath;
+	}
+	// Kilobytes per second of a test, blocks are half a kilobyte
+	static double kilobytesPerSecond(const result& r) {
+		return r.micros ? r.blocks * 500000.0 / r.micros : 0;
+	}
+private:
+	bool writeBlock(uint32_t index, result& r);
+	void printResult(Print& out, const char* name, const result& r);
+#if USE_SD_LATENCY_STATS
+	void writeLatency(Print& out, const SdLatency& latency);
+#endif
+
+	SdSpiCard* m_card;
+	SdFile m_file;
+	uint8_t m_block[512];
+	result m_sequential {};
+	result m_random {};
+	String m_reportPath;
+};
+
+#endif
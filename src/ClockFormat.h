@@ -0,0 +1,33 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef ClockFormat_h
+#define ClockFormat_h
+
+// hh:mm:ss with its terminator, hours up to 999
+#define CLOCK_TEXT_SIZE 10
+
+// Into `buffer` of CLOCK_TEXT_SIZE, no String
+inline void formatClock(char* buffer, unsigned long hours, unsigned long minutes, unsigned long seconds)
+{
+	hours %= 1000;
+	char* out = buffer;
+	if (hours >= 100) *out++ = '0' + hours / 100;
+	*out++ = '0' + hours / 10 % 10;
+	*out++ = '0' + hours % 10;
+	*out++ = ':';
+	*out++ = '0' + minutes / 10;
+	*out++ = '0' + minutes % 10;
+	*out++ = ':';
+	*out++ = '0' + seconds / 10;
+	*out++ = '0' + seconds % 10;
+	*out = '\0';
+}
+inline void formatDuration(char* buffer, unsigned long seconds)
+{
+	formatClock(buffer, seconds / 3600, (seconds / 60) % 60, seconds % 60);
+}
+
+#endif
@@ -0,0 +1,61 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef Display_h
+#define Display_h
+
+#include <Arduino.h>
+#include "I2CBus.h"
+#include "DisplayText.h"
+
+// 1 for a 128x64 I2C OLED instead of the 16x2 character LCD
+#define DISPLAY_OLED 0
+// With DISPLAY_OLED, 1 for an SH1106 controller instead of an SSD1306
+#define OLED_SH1106 0
+
+// Bar graphs of init_bargraph()
+#define LCDI2C_VERTICAL_BAR_GRAPH 1
+#define LCDI2C_HORIZONTAL_BAR_GRAPH 2
+// Horizontal, from the middle of the bar to either side
+#define LCDI2C_CENTER_BAR_GRAPH 4
+
+/**
+ * What the vario draws on: a grid of character cells, see
+ * LiquidCrystal_I2C and OledDisplay.
+ *
+ * setText() and the bar graphs change a shadow of the screen, refresh()
+ * and update() send only what changed. Text printed through Print goes
+ * out at once at the cursor.
+ */
+class Display : public Print
+{
+public:
+	virtual void begin(uint8_t cols, uint8_t rows, uint8_t charsize = 0) = 0;
+	virtual void clear() = 0;
+	virtual void backlight() = 0;
+	virtual void setCursor(uint8_t col, uint8_t row) = 0;
+	// Shared bus the display waits its turn on
+	virtual void setBus(I2CBus* bus) = 0;
+
+	virtual void setText(uint8_t col, uint8_t row, const char* text, uint8_t length) = 0;
+	// Sends the changes, returns the I2C bytes sent
+	virtual uint16_t refresh() = 0;
+	// Starts at most one background transfer of changes, true when the
+	// display is up to date
+	virtual bool update() = 0;
+	virtual uint8_t columns() = 0;
+	virtual uint8_t rows() = 0;
+	// I2C bytes sent since power on, address bytes included
+	virtual uint32_t bytesSent() = 0;
+
+	// 1 when the graph type is not supported. Bars are in fifths of a cell
+	// across and eighths of a cell up, whatever the display's pixels.
+	virtual uint8_t init_bargraph(uint8_t graphtype) = 0;
+	virtual void draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_col_end) = 0;
+	virtual void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_row_end) = 0;
+	virtual void draw_center_graph(uint8_t row, uint8_t column, uint8_t len, int8_t pixels) = 0;
+};
+
+#endif
@@ -0,0 +1,48 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef DisplayText_h
+#define DisplayText_h
+
+#include <stdint.h>
+#include <string.h>
+
+// Largest text grid of any display
+#define DISPLAY_MAX_COLS 20
+#define DISPLAY_MAX_ROWS 4
+
+// Fills a line of the display's framebuffer, sent by refresh() or update().
+// Any display with columns() and setText(), so they run on a computer too.
+template<class D>
+static void lcdSetLine(D& lcd, const char* left, const char* right, bool firstLine)
+{
+	int leftLength = strlen(left);
+	int rightLength = strlen(right);
+	int spaces = lcd.columns() - leftLength - rightLength;
+	if (spaces < 0) return;
+
+	char line[DISPLAY_MAX_COLS];
+	memset(line, ' ', sizeof(line));
+	memcpy(line, left, leftLength);
+	memcpy(line + leftLength + spaces, right, rightLength);
+	lcd.setText(0, firstLine ? 0 : 1, line, lcd.columns());
+}
+
+// Right aligned in the cells from `col` to the end of the line, the cells
+// before it are left as they are
+template<class D>
+static void lcdSetRight(D& lcd, const char* text, uint8_t col, bool firstLine)
+{
+	int length = strlen(text);
+	int spaces = lcd.columns() - col - length;
+	if (spaces < 0) return;
+
+	char cells[DISPLAY_MAX_COLS];
+	memset(cells, ' ', sizeof(cells));
+	memcpy(cells + spaces, text, length);
+	lcd.setText(col, firstLine ? 0 : 1, cells, lcd.columns() - col);
+}
+
+#endif
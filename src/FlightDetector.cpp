@@ -0,0 +1,108 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include <math.h>
+#include "FlightDetector.h"
+
+// Averages over the takeoff window that start a flight
+#define TAKEOFF_SPEED_KNOTS 5.0
+#define TAKEOFF_CLIMB 1.0
+// Meters away from the launch altitude
+#define TAKEOFF_ALTITUDE 30.0
+// Averages over the landing window that end it
+#define LANDING_SPEED_KNOTS 3.0
+#define LANDING_CLIMB 0.2
+#define LANDING_ALTITUDE 5.0
+
+// No Arduino here, the detector is replayed on a computer by tools/flightreplay
+static int clampWindow(int seconds)
+{
+	return seconds < 1 ? 1 : seconds > FlightDetector::kMaxWindow ? FlightDetector::kMaxWindow : seconds;
+}
+
+void FlightDetector::reset()
+{
+	int takeoffWindow = m_takeoffWindow;
+	int landingWindow = m_landingWindow;
+	*this = FlightDetector();
+	m_takeoffWindow = takeoffWindow;
+	m_landingWindow = landingWindow;
+}
+
+void FlightDetector::setWindows(int takeoffSeconds, int landingSeconds)
+{
+	m_takeoffWindow = clampWindow(takeoffSeconds);
+	m_landingWindow = clampWindow(landingSeconds);
+	// The running sums belong to the old windows
+	bool flying = m_flying;
+	reset();
+	m_flying = flying;
+}
+
+const FlightDetector::sample& FlightDetector::sampleAgo(int seconds) const
+{
+	int index = m_head - 1 - seconds;
+	if (index < 0) index += kMaxWindow + 1;
+	return m_samples[index];
+}
+
+FlightDetector::Event FlightDetector::update(double altitude, double climbRate, double knots)
+{
+	sample current { (float)altitude, (float)climbRate, (float)(knots > 0 ? knots : 0) };
+	m_samples[m_head] = current;
+	m_head = (m_head + 1) % (kMaxWindow + 1);
+	if (m_count <= kMaxWindow) m_count++;
+	m_sinceEvent++;
+
+	m_takeoffSpeed += current.knots;
+	m_takeoffClimb += current.climbRate;
+	if (m_count > m_takeoffWindow)
+	{
+		const sample& old = sampleAgo(m_takeoffWindow);
+		m_takeoffSpeed -= old.knots;
+		m_takeoffClimb -= old.climbRate;
+	}
+	m_landingSpeed += current.knots;
+	// Either way, a climb and the glide after it do not cancel out
+	m_landingClimb += fabs(current.climbRate);
+	if (m_count > m_landingWindow)
+	{
+		const sample& old = sampleAgo(m_landingWindow);
+		m_landingSpeed -= old.knots;
+		m_landingClimb -= fabs(old.climbRate);
+	}
+
+	if (!m_flying)
+	{
+		// Follow the ground altitude so weather drift is not a takeoff
+		const sample& launch = sampleAgo((m_count < m_landingWindow + 1 ? m_count : m_landingWindow + 1) - 1);
+		m_launchAltitude = launch.altitude;
+		if (m_sinceEvent < m_takeoffWindow || m_count < m_takeoffWindow) return kNone;
+
+		double speed = m_takeoffSpeed / m_takeoffWindow;
+		double climb = m_takeoffClimb / m_takeoffWindow;
+		if (speed >= TAKEOFF_SPEED_KNOTS) m_reason = "SPEED";
+		else if (fabs(climb) >= TAKEOFF_CLIMB) m_reason = "CLIMB";
+		else if (fabs(altitude - m_launchAltitude) >= TAKEOFF_ALTITUDE) m_reason = "ALTITUDE";
+		else return kNone;
+
+		m_flying = true;
+		m_sinceEvent = 0;
+		return kTakeoff;
+	}
+
+	if (m_sinceEvent < m_landingWindow || m_count <= m_landingWindow) return kNone;
+	double speed = m_landingSpeed / m_landingWindow;
+	double climb = m_landingClimb / m_landingWindow;
+	double altitudeChange = altitude - sampleAgo(m_landingWindow).altitude;
+	if (speed >= LANDING_SPEED_KNOTS ||
+		climb >= LANDING_CLIMB ||
+		fabs(altitudeChange) >= LANDING_ALTITUDE) return kNone;
+
+	m_reason = "STILL";
+	m_flying = false;
+	m_sinceEvent = 0;
+	return kLanding;
+}
@@ -0,0 +1,73 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef FlightDetector_h
+#define FlightDetector_h
+
+/**
+ * Takeoff and landing detection, fed one sample per second.
+ *
+ * Takeoff needs any of ground speed, vertical speed or altitude change from
+ * launch over the takeoff window. Landing needs all three to stay quiet over
+ * the longer landing window, with lower thresholds so a slow moment in the
+ * air does not end the flight. Sums are kept running, so every update is
+ * constant time and memory.
+ */
+class FlightDetector
+{
+public:
+	enum Event {
+		kNone = 0,
+		kTakeoff = 1,
+		kLanding = 2
+	};
+	// Largest window, in seconds
+	static const int kMaxWindow = 60;
+
+	FlightDetector() {};
+	void reset();
+	void setWindows(int takeoffSeconds, int landingSeconds);
+	// Knots below zero means there is no GPS speed, landing then relies on the baro
+	Event update(double altitude, double climbRate, double knots);
+
+	bool flying() const {
+		return m_flying;
+	}
+	// What triggered the last event: SPEED, CLIMB, ALTITUDE or STILL
+	const char* reason() const {
+		return m_reason;
+	}
+	int takeoffWindow() const {
+		return m_takeoffWindow;
+	}
+	int landingWindow() const {
+		return m_landingWindow;
+	}
+private:
+	struct sample {
+		float altitude;
+		float climbRate;
+		float knots;
+	};
+	const sample& sampleAgo(int seconds) const;
+
+	sample m_samples[kMaxWindow + 1];
+	int m_head { 0 };
+	int m_count { 0 };
+	// Samples since the last event, windows only look at one state
+	int m_sinceEvent { 0 };
+	int m_takeoffWindow { 10 };
+	int m_landingWindow { 30 };
+
+	double m_takeoffSpeed { 0 };
+	double m_takeoffClimb { 0 };
+	double m_landingSpeed { 0 };
+	double m_landingClimb { 0 };
+	double m_launchAltitude { 0 };
+	bool m_flying { false };
+	const char* m_reason { "" };
+};
+
+#endif
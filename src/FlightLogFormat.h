@@ -0,0 +1,276 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef FlightLogFormat_h
+#define FlightLogFormat_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+/**
+ * Binary flight log, shared by the vario and the host side exporter.
+ *
+ * File:   header, then blocks until the end of the file
+ * Header: "SVFL", version, uint16 text length, IGC header text, crc16
+ * Block:  sync byte, record count, uint16 payload length, payload, crc16
+ *
+ * Fix blocks use FLIGHT_LOG_BLOCK_SYNC. Any other IGC line, like the
+ * L-records, goes verbatim in its own FLIGHT_LOG_TEXT_SYNC block.
+ *
+ * A record is every fix field as a zigzag varint delta against the previous
+ * record of the same block. The first record of a block is against zero, so
+ * a damaged block never takes the following ones with it.
+ * All integers are little endian, crc16 is CRC-CCITT (0x1021, 0xFFFF).
+ */
+#define FLIGHT_LOG_MAGIC            "SVFL"
+#define FLIGHT_LOG_VERSION          1
+#define FLIGHT_LOG_HEADER_OVERHEAD  9
+#define FLIGHT_LOG_BLOCK_SYNC       0xB7
+#define FLIGHT_LOG_TEXT_SYNC        0xB8
+#define FLIGHT_LOG_BLOCK_SIZE       512
+#define FLIGHT_LOG_BLOCK_HEADER     4
+#define FLIGHT_LOG_BLOCK_PAYLOAD    (FLIGHT_LOG_BLOCK_SIZE - FLIGHT_LOG_BLOCK_HEADER - 2)
+// B-record plus the FXA VXA SIU VAT TDS extensions, without CRLF
+#define FLIGHT_LOG_IGC_LENGTH       48
+
+enum FlightLogField {
+	kFixTime = 0,             // Deciseconds since midnight UTC
+	kFixLatitude = 1,         // Thousandths of minute, south is negative
+	kFixLongitude = 2,        // Thousandths of minute, west is negative
+	kFixBaroAltitude = 3,     // Meters
+	kFixGPSAltitude = 4,      // Meters
+	kFixVario = 5,            // Decimeters per second
+	kFixAccuracy = 6,         // Meters
+	kFixVerticalAccuracy = 7, // Meters
+	kFixSatellites = 8,
+	kFixFieldCount = 9
+};
+// Worst case is five varint bytes per field
+#define FLIGHT_LOG_MAX_RECORD (kFixFieldCount * 5)
+
+struct flight_log_fix {
+	int32_t field[kFixFieldCount];
+};
+
+static inline uint16_t flightLogCrc(const uint8_t* data, size_t size, uint16_t crc = 0xFFFF)
+{
+	while (size--) {
+		crc ^= (uint16_t)(*data++) << 8;
+		for (int i = 0; i < 8; i++) {
+			crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+		}
+	}
+	return crc;
+}
+
+static inline size_t flightLogPutVarint(uint8_t* dst, int32_t value)
+{
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	size_t n = 0;
+	while (zigzag >= 0x80) {
+		dst[n++] = (zigzag & 0x7F) | 0x80;
+		zigzag >>= 7;
+	}
+	dst[n++] = zigzag;
+	return n;
+}
+
+// Returns the bytes used, or 0 if the varint is truncated
+static inline size_t flightLogGetVarint(const uint8_t* src, size_t size, int32_t* value)
+{
+	uint32_t zigzag = 0;
+	for (size_t n = 0; n < size && n < 5; n++) {
+		zigzag |= (uint32_t)(src[n] & 0x7F) << (7 * n);
+		if (!(src[n] & 0x80)) {
+			*value = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+			return n + 1;
+		}
+	}
+	return 0;
+}
+
+// Reads a fixed width number, with an optional leading minus sign
+static inline bool flightLogParseNumber(const char* src, int width, int32_t* value)
+{
+	bool negative = src[0] == '-';
+	int32_t result = 0;
+	for (int i = negative ? 1 : 0; i < width; i++) {
+		if (src[i] < '0' || src[i] > '9') return false;
+		result = result * 10 + (src[i] - '0');
+	}
+	*value = negative ? -result : result;
+	return true;
+}
+
+// Writes a fixed width number the same way IGCFileRecorder does
+static inline void flightLogFormatNumber(char* dst, int width, int32_t value)
+{
+	if (value < 0) {
+		*dst++ = '-';
+		value = -value;
+		width--;
+	}
+	for (int i = width - 1; i >= 0; i--) {
+		dst[i] = '0' + value % 10;
+		value /= 10;
+	}
+}
+
+// Writes FLIGHT_LOG_IGC_LENGTH characters plus a terminating zero
+static inline void flightLogFormatIGC(const flight_log_fix* fix, char* line)
+{
+	const int32_t* f = fix->field;
+	int32_t seconds = f[kFixTime] / 10;
+	int32_t latitude = f[kFixLatitude] < 0 ? -f[kFixLatitude] : f[kFixLatitude];
+	int32_t longitude = f[kFixLongitude] < 0 ? -f[kFixLongitude] : f[kFixLongitude];
+	line[0] = 'B';
+	flightLogFormatNumber(line + 1, 2, seconds / 3600);
+	flightLogFormatNumber(line + 3, 2, (seconds / 60) % 60);
+	flightLogFormatNumber(line + 5, 2, seconds % 60);
+	flightLogFormatNumber(line + 7, 2, latitude / 60000);
+	flightLogFormatNumber(line + 9, 5, latitude % 60000);
+	line[14] = f[kFixLatitude] < 0 ? 'S' : 'N';
+	flightLogFormatNumber(line + 15, 3, longitude / 60000);
+	flightLogFormatNumber(line + 18, 5, longitude % 60000);
+	line[23] = f[kFixLongitude] < 0 ? 'W' : 'E';
+	line[24] = 'A';
+	flightLogFormatNumber(line + 25, 5, f[kFixBaroAltitude]);
+	flightLogFormatNumber(line + 30, 5, f[kFixGPSAltitude]);
+	flightLogFormatNumber(line + 35, 3, f[kFixAccuracy]);
+	flightLogFormatNumber(line + 38, 3, f[kFixVerticalAccuracy]);
+	flightLogFormatNumber(line + 41, 2, f[kFixSatellites]);
+	flightLogFormatNumber(line + 43, 4, f[kFixVario]);
+	flightLogFormatNumber(line + 47, 1, f[kFixTime] % 10);
+	line[FLIGHT_LOG_IGC_LENGTH] = 0;
+}
+
+/**
+ * Parses a B-record as written by IGCFileRecorder:
+ * B HHMMSS DDMMmmmN DDDMMmmmE A PPPPP GGGGG FXA VXA SIU VAT TDS
+ * Returns false for anything that could not be written back bit-exact.
+ */
+static inline bool flightLogParseIGC(const char* line, size_t length, flight_log_fix* fix)
+{
+	if (length != FLIGHT_LOG_IGC_LENGTH || line[0] != 'B' || line[24] != 'A') return false;
+	int32_t hours, minutes, seconds, tenths, degrees, milliminutes;
+	int32_t* f = fix->field;
+	if (!flightLogParseNumber(line + 1, 2, &hours) ||
+		!flightLogParseNumber(line + 3, 2, &minutes) ||
+		!flightLogParseNumber(line + 5, 2, &seconds) ||
+		!flightLogParseNumber(line + 47, 1, &tenths)) return false;
+	f[kFixTime] = ((hours * 60 + minutes) * 60 + seconds) * 10 + tenths;
+
+	if (!flightLogParseNumber(line + 7, 2, &degrees) ||
+		!flightLogParseNumber(line + 9, 5, &milliminutes)) return false;
+	if (line[14] != 'N' && line[14] != 'S') return false;
+	f[kFixLatitude] = (degrees * 60000 + milliminutes) * (line[14] == 'S' ? -1 : 1);
+
+	if (!flightLogParseNumber(line + 15, 3, &degrees) ||
+		!flightLogParseNumber(line + 18, 5, &milliminutes)) return false;
+	if (line[23] != 'E' && line[23] != 'W') return false;
+	f[kFixLongitude] = (degrees * 60000 + milliminutes) * (line[23] == 'W' ? -1 : 1);
+
+	// Altitudes below sea level are signed, -0012
+	if (!flightLogParseNumber(line + 25, 5, &f[kFixBaroAltitude]) ||
+		!flightLogParseNumber(line + 30, 5, &f[kFixGPSAltitude]) ||
+		!flightLogParseNumber(line + 35, 3, &f[kFixAccuracy]) ||
+		!flightLogParseNumber(line + 38, 3, &f[kFixVerticalAccuracy]) ||
+		!flightLogParseNumber(line + 41, 2, &f[kFixSatellites]) ||
+		!flightLogParseNumber(line + 43, 4, &f[kFixVario])) return false;
+
+	// Whatever parsed, like -0000 or a sign in the time, has to come back
+	// as the same text
+	char rebuilt[FLIGHT_LOG_IGC_LENGTH + 1];
+	flightLogFormatIGC(fix, rebuilt);
+	return memcmp(rebuilt, line, FLIGHT_LOG_IGC_LENGTH) == 0;
+}
+
+// Encodes a fix against the previous one, returns the bytes used
+static inline size_t flightLogEncode(const flight_log_fix* fix, const flight_log_fix* previous, uint8_t* dst)
+{
+	size_t n = 0;
+	for (int i = 0; i < kFixFieldCount; i++) {
+		n += flightLogPutVarint(dst + n, fix->field[i] - previous->field[i]);
+	}
+	return n;
+}
+
+// Decodes a fix on top of the previous one, returns the bytes used or 0
+static inline size_t flightLogDecode(const uint8_t* src, size_t size, flight_log_fix* fix)
+{
+	size_t n = 0;
+	for (int i = 0; i < kFixFieldCount; i++) {
+		int32_t delta;
+		size_t used = flightLogGetVarint(src + n, size - n, &delta);
+		if (used == 0) return 0;
+		fix->field[i] += delta;
+		n += used;
+	}
+	return n;
+}
+
+/**
+ * A block being filled, as FlightLogWriter and the host tools build it.
+ * data holds the block header, the payload and room for the crc.
+ */
+struct flight_log_block {
+	uint8_t data[FLIGHT_LOG_BLOCK_SIZE];
+	size_t payload;
+	uint8_t count;
+	flight_log_fix previous;
+};
+
+static inline void flightLogBlockClear(flight_log_block* block)
+{
+	block->payload = 0;
+	block->count = 0;
+}
+
+// Adds a fix, the first of a block against zero. Returns false when the
+// block is full, it is then sealed, written and cleared first.
+static inline bool flightLogBlockAdd(flight_log_block* block, const flight_log_fix* fix)
+{
+	flight_log_fix zero = {};
+	uint8_t record[FLIGHT_LOG_MAX_RECORD];
+	size_t size = flightLogEncode(fix, block->count ? &block->previous : &zero, record);
+	if (block->payload + size > FLIGHT_LOG_BLOCK_PAYLOAD || block->count == 0xFF) return false;
+	memcpy(block->data + FLIGHT_LOG_BLOCK_HEADER + block->payload, record, size);
+	block->payload += size;
+	block->count++;
+	block->previous = *fix;
+	return true;
+}
+
+// Writes the header and the crc of `sync` block, returns its size in data
+static inline size_t flightLogBlockSeal(flight_log_block* block, uint8_t sync = FLIGHT_LOG_BLOCK_SYNC)
+{
+	uint8_t* data = block->data;
+	data[0] = sync;
+	data[1] = block->count;
+	data[2] = block->payload & 0xFF;
+	data[3] = block->payload >> 8;
+	size_t size = FLIGHT_LOG_BLOCK_HEADER + block->payload;
+	uint16_t crc = flightLogCrc(data, size);
+	data[size++] = crc & 0xFF;
+	data[size++] = crc >> 8;
+	return size;
+}
+
+// A line as a text block in an empty `block`, returns its size in data or
+// 0 when it does not fit
+static inline size_t flightLogBlockText(flight_log_block* block, const char* line, size_t length)
+{
+	if (length > FLIGHT_LOG_BLOCK_PAYLOAD) return 0;
+	memcpy(block->data + FLIGHT_LOG_BLOCK_HEADER, line, length);
+	block->payload = length;
+	block->count = 1;
+	size_t size = flightLogBlockSeal(block, FLIGHT_LOG_TEXT_SYNC);
+	flightLogBlockClear(block);
+	return size;
+}
+
+#endif
@@ -0,0 +1,81 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include "FlightLogWriter.h"
+
+bool FlightLogWriter::open(const char* path, const String& igcHeader)
+{
+	if (!m_file.open(path, O_CREAT | O_WRITE | O_TRUNC)) return false;
+	flightLogBlockClear(&m_block);
+	m_bytesWritten = 0;
+	m_textFixes = 0;
+
+	uint16_t length = igcHeader.length();
+	uint8_t prefix[FLIGHT_LOG_HEADER_OVERHEAD - 2];
+	memcpy(prefix, FLIGHT_LOG_MAGIC, 4);
+	prefix[4] = FLIGHT_LOG_VERSION;
+	prefix[5] = length & 0xFF;
+	prefix[6] = length >> 8;
+	uint16_t crc = flightLogCrc(prefix, sizeof(prefix));
+	crc = flightLogCrc((const uint8_t*)igcHeader.c_str(), length, crc);
+	uint8_t suffix[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+
+	m_file.write(prefix, sizeof(prefix));
+	m_file.write(igcHeader.c_str(), length);
+	m_file.write(suffix, sizeof(suffix));
+	m_bytesWritten += FLIGHT_LOG_HEADER_OVERHEAD + length;
+	return true;
+}
+
+void FlightLogWriter::write(const String& sentance)
+{
+	if (!m_file.isOpen()) return;
+	flight_log_fix fix;
+	if (!flightLogParseIGC(sentance.c_str(), sentance.length(), &fix))
+	{
+		// A fix stored as text still exports the same, only bigger
+		if (sentance[0] == 'B') m_textFixes++;
+		writeText(sentance);
+		return;
+	}
+	if (!flightLogBlockAdd(&m_block, &fix))
+	{
+		writeBlock();
+		flightLogBlockAdd(&m_block, &fix);
+	}
+}
+
+void FlightLogWriter::writeBlock()
+{
+	if (m_block.count == 0) return;
+	size_t size = flightLogBlockSeal(&m_block);
+	m_file.write(m_block.data, size);
+	m_bytesWritten += size;
+	flightLogBlockClear(&m_block);
+}
+
+void FlightLogWriter::writeText(const String& line)
+{
+	// Keep the order of the lines
+	writeBlock();
+	size_t size = flightLogBlockText(&m_block, line.c_str(), line.length());
+	if (size == 0) return;
+	m_file.write(m_block.data, size);
+	m_bytesWritten += size;
+}
+
+void FlightLogWriter::sync()
+{
+	if (!m_file.isOpen()) return;
+	writeBlock();
+	m_file.sync();
+}
+
+void FlightLogWriter::close()
+{
+	if (!m_file.isOpen()) return;
+	writeBlock();
+	m_file.close();
+}
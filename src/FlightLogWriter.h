@@ -0,0 +1,54 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef FlightLogWriter_h
+#define FlightLogWriter_h
+
+#include <Arduino.h>
+#include "SdFat/SdFat.h"
+#include "FlightLogFormat.h"
+
+/**
+ * Writes the compact binary flight log described in FlightLogFormat.h.
+ * Lines are given as written to the IGC file, so tools/igcexport can
+ * rebuild it byte for byte.
+ *
+ * The file grows through the SD cache and the FAT like the plain IGC log,
+ * not by DMA into space reserved at takeoff as JournalLog does. Reserved
+ * clusters hold whatever was on the card, and after a power loss the file
+ * has its full size: the blocks carry no flight id, so stale blocks of an
+ * older flight would export as part of this one. A full cache block costs
+ * a blocking write every 50 fixes or so; flights that must not stall for
+ * the card log with JOURNAL.
+ */
+class FlightLogWriter
+{
+public:
+	FlightLogWriter() {};
+	bool open(const char* path, const String& igcHeader);
+	void write(const String& sentance);
+	void sync();
+	void close();
+	bool isOpen() {
+		return m_file.isOpen();
+	}
+	uint32_t bytesWritten() {
+		return m_bytesWritten;
+	}
+	// B-records that did not parse and went in text blocks
+	uint32_t textFixes() const {
+		return m_textFixes;
+	}
+private:
+	void writeBlock();
+	void writeText(const String& line);
+
+	SdFile m_file;
+	flight_log_block m_block {};
+	uint32_t m_bytesWritten { 0 };
+	uint32_t m_textFixes { 0 };
+};
+
+#endif
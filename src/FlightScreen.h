@@ -0,0 +1,46 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef FlightScreen_h
+#define FlightScreen_h
+
+#include "Units/Measurement.h"
+#include "Units/UnitLength.h"
+#include "Units/UnitSpeed.h"
+
+// The values of the flight screen as text, on the stack of updateLCD()
+struct flight_screen_text {
+	char speed[MEASUREMENT_TEXT_SIZE];
+	char climbRate[MEASUREMENT_TEXT_SIZE];
+	char altitude[MEASUREMENT_TEXT_SIZE];
+	char distance[MEASUREMENT_TEXT_SIZE];
+};
+
+// In metric or imperial units, no String. Distance in kilometers.
+inline void formatFlightScreen(flight_screen_text* text, double knots, double climbRate,
+	double altitude, double distance, bool metric)
+{
+	Measurement<UnitSpeed> speedValue(knots, UnitSpeed::knots());
+	Measurement<UnitSpeed> climbRateValue(climbRate, UnitSpeed::metersPerSecond());
+	Measurement<UnitLength> altitudeValue(altitude, UnitLength::meters());
+	Measurement<UnitLength> distanceValue(distance, UnitLength::kilometers());
+
+	if (metric)
+	{
+		speedValue.convertedTo(UnitSpeed::kilometersPerHour()).formatTo(text->speed, sizeof(text->speed));
+		climbRateValue.convertedTo(UnitSpeed::metersPerSecond(), 0.02).formatTo(text->climbRate, sizeof(text->climbRate));
+		altitudeValue.convertedTo(UnitLength::meters()).formatTo(text->altitude, sizeof(text->altitude));
+		distanceValue.formatTo(text->distance, sizeof(text->distance));
+	}
+	else
+	{
+		speedValue.convertedTo(UnitSpeed::milesPerHour()).formatTo(text->speed, sizeof(text->speed));
+		climbRateValue.convertedTo(UnitSpeed::feetPerMinute(), 25).formatTo(text->climbRate, sizeof(text->climbRate));
+		altitudeValue.convertedTo(UnitLength::feet()).formatTo(text->altitude, sizeof(text->altitude));
+		distanceValue.convertedTo(UnitLength::miles(), 0.25).formatTo(text->distance, sizeof(text->distance));
+	}
+}
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include <Arduino.h>
+#include "FlightStatistics.h"
+#include "Utils.h"
+
+// Climb over kLiftWindow to enter and leave a thermal, m/s
+#define LIFT_ENTER_CLIMB 0.3
+#define LIFT_EXIT_CLIMB 0.0
+// Altitude changes smaller than this do not count as gain, meters
+#define GAIN_DEAD_BAND 3.0
+
+void FlightStatistics::begin(double startTime)
+{
+	*this = FlightStatistics();
+	m_startTime = startTime;
+	m_lastUpdate = startTime;
+}
+
+float FlightStatistics::altitudeAgo(int seconds) const
+{
+	int index = m_head - 1 - seconds;
+	if (index < 0) index += kWindow + 1;
+	return m_altitudes[index];
+}
+
+void FlightStatistics::update(double now, double altitude, double climbRate, double knots, double latitude, double longitude)
+{
+	m_lastUpdate = now;
+	m_maxClimb = max(m_maxClimb, climbRate);
+	m_maxSink = min(m_maxSink, climbRate);
+	m_maxSpeed = max(m_maxSpeed, knots);
+
+	if (m_samples == 0)
+	{
+		m_gainReference = altitude;
+	}
+	else
+	{
+		if ((now - m_lastSample) < 1000) return;
+	}
+	double seconds = m_samples ? (now - m_lastSample) / 1000.0 : 0.0;
+	double climbed = m_samples ? altitude - altitudeAgo(0) : 0.0;
+	double travelled = m_samples ? distanceEarth(m_lastLatitude, m_lastLongitude, latitude, longitude) : 0.0;
+	m_lastSample = now;
+	m_lastLatitude = latitude;
+	m_lastLongitude = longitude;
+
+	m_altitudes[m_head] = altitude;
+	m_head = (m_head + 1) % (kWindow + 1);
+	if (m_samples <= kWindow) m_samples++;
+
+	m_distance += travelled;
+
+	// Gain only counts climbs past the dead band, so noise does not add up
+	if (altitude < m_gainReference)
+	{
+		m_gainReference = altitude;
+	}
+	else if (altitude - m_gainReference > GAIN_DEAD_BAND)
+	{
+		m_altitudeGain += altitude - m_gainReference;
+		m_gainReference = altitude;
+	}
+
+	if (m_samples > kWindow)
+	{
+		m_bestClimb = max(m_bestClimb, (altitude - altitudeAgo(kWindow)) / kWindow);
+	}
+	if (m_samples > kLiftWindow)
+	{
+		double lift = (altitude - altitudeAgo(kLiftWindow)) / kLiftWindow;
+		if (!m_inLift && lift > LIFT_ENTER_CLIMB)
+		{
+			m_inLift = true;
+			m_thermalCount++;
+		}
+		else if (m_inLift && lift < LIFT_EXIT_CLIMB)
+		{
+			m_inLift = false;
+		}
+	}
+
+	if (m_inLift)
+	{
+		m_liftTime += seconds;
+		m_liftGain += climbed;
+	}
+	else
+	{
+		m_glideDistance += travelled;
+		m_glideLoss -= climbed;
+	}
+}
@@ -0,0 +1,88 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef FlightStatistics_h
+#define FlightStatistics_h
+
+/**
+ * Flight statistics, updated on every fix in constant time and memory.
+ * Climb rates are in m/s, altitudes in meters, speeds in knots,
+ * distances in kilometers and times in seconds.
+ */
+class FlightStatistics
+{
+public:
+	FlightStatistics() {};
+	void begin(double startTime);
+	void update(double now, double altitude, double climbRate, double knots, double latitude, double longitude);
+
+	double maxClimb() const {
+		return m_maxClimb;
+	}
+	double maxSink() const {
+		return m_maxSink;
+	}
+	// Average climb while in lift
+	double averageClimb() const {
+		return m_liftTime > 0 ? m_liftGain / m_liftTime : 0.0;
+	}
+	// Best climb averaged over kWindow seconds
+	double bestClimb() const {
+		return m_bestClimb;
+	}
+	int thermalCount() const {
+		return m_thermalCount;
+	}
+	double liftTime() const {
+		return m_liftTime;
+	}
+	double maxSpeed() const {
+		return m_maxSpeed;
+	}
+	double altitudeGain() const {
+		return m_altitudeGain;
+	}
+	// Distance over altitude lost while not in lift, 0 if unknown
+	double glideRatio() const {
+		return m_glideLoss > 0 ? m_glideDistance * 1000.0 / m_glideLoss : 0.0;
+	}
+	double distance() const {
+		return m_distance;
+	}
+	double duration() const {
+		return (m_lastUpdate - m_startTime) / 1000.0;
+	}
+private:
+	// Altitude history, one sample per second
+	static const int kWindow = 30;
+	// Seconds used to decide if we are in lift
+	static const int kLiftWindow = 10;
+	float m_altitudes[kWindow + 1];
+	int m_head { 0 };
+	int m_samples { 0 };
+	float altitudeAgo(int seconds) const;
+
+	double m_startTime { 0 };
+	double m_lastUpdate { 0 };
+	double m_lastSample { 0 };
+	double m_lastLatitude { 0 };
+	double m_lastLongitude { 0 };
+	double m_gainReference { 0 };
+
+	double m_maxClimb { 0 };
+	double m_maxSink { 0 };
+	double m_bestClimb { 0 };
+	double m_maxSpeed { 0 };
+	double m_altitudeGain { 0 };
+	double m_distance { 0 };
+	bool m_inLift { false };
+	int m_thermalCount { 0 };
+	double m_liftTime { 0 };
+	double m_liftGain { 0 };
+	double m_glideDistance { 0 };
+	double m_glideLoss { 0 };
+};
+
+#endif
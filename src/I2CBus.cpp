@@ -0,0 +1,178 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include "I2CBus.h"
+
+I2CBus* I2CBus::s_buses[I2C_MAX_BUSES];
+int I2CBus::s_busCount = 0;
+
+void I2CBus::begin(i2c_pins pins, uint32_t rate, i2c_op_mode mode)
+{
+	m_rate = rate;
+	// Not immediate mode, so sendTransmission() and sendRequest() return at once
+	if (mode == I2C_OP_MODE_IMM) mode = I2C_OP_MODE_ISR;
+	m_wire.begin(I2C_MASTER, 0x00, pins, I2C_PULLUP_EXT, rate, mode);
+	// i2c_t3 callbacks take no arguments, one hook per bus
+	static void (*const hooks[I2C_MAX_BUSES])() = { masterDoneHook<0>, masterDoneHook<1> };
+	if (s_busCount < I2C_MAX_BUSES) {
+		s_buses[s_busCount] = this;
+		m_wire.onMasterDone(hooks[s_busCount++]);
+	}
+}
+
+void I2CBus::reserve(Device device, uint32_t at, uint32_t micros)
+{
+	noInterrupts();
+	for (int i = 0; i < m_slotCount; i++) {
+		if (m_slots[i].device == device) {
+			removeSlot(i);
+			break;
+		}
+	}
+	int index = m_slotCount;
+	while (index > 0 && (int32_t)(m_slots[index - 1].at - at) > 0) {
+		m_slots[index] = m_slots[index - 1];
+		index--;
+	}
+	m_slots[index] = { at, micros, (uint8_t)device };
+	m_slotCount++;
+	interrupts();
+}
+
+bool I2CBus::tryStart(Device device, size_t bytes)
+{
+	uint32_t now = micros();
+	uint32_t end = now + transferMicros(bytes);
+	noInterrupts();
+	for (int i = 0; i < m_slotCount; i++) {
+		const slot& s = m_slots[i];
+		if ((int32_t)(now - (s.at + s.micros)) > I2C_SLOT_TIMEOUT_US) {
+			removeSlot(i--);
+		} else if (s.device < device && (int32_t)(s.at - end) < 0) {
+			interrupts();
+			return false;
+		}
+	}
+	bool held = holdLocked(device);
+	interrupts();
+	return held;
+}
+
+void I2CBus::acquire(Device device)
+{
+	if (!hold(device)) {
+		m_stats[device].waits++;
+		while (!hold(device)) {}
+	}
+}
+
+void I2CBus::acquireAsync(Device device, Completion start, void* context)
+{
+	noInterrupts();
+	if (!holdLocked(device)) {
+		m_stats[device].waits++;
+		m_waiting = device;
+		m_waitingStart = start;
+		m_waitingContext = context;
+		interrupts();
+		return;
+	}
+	start(context, true);
+	interrupts();
+}
+
+bool I2CBus::hold(Device device)
+{
+	noInterrupts();
+	bool held = holdLocked(device);
+	interrupts();
+	return held;
+}
+
+// With interrupts off, also takes the device's slot once it is due. A slot
+// reserved ahead, for the next conversion, stays for the others to see.
+bool I2CBus::holdLocked(Device device)
+{
+	if (m_holder != kDeviceCount || !m_wire.done()) return false;
+	m_holder = device;
+	uint32_t now = micros();
+	for (int i = 0; i < m_slotCount; i++) {
+		if (m_slots[i].device == device && (int32_t)(m_slots[i].at - now) <= 0) {
+			removeSlot(i);
+			break;
+		}
+	}
+	return true;
+}
+
+// The waiting device's start runs before interrupts are back on. A timer
+// tick between the handoff and the start would find the bus held by its
+// own device, wait again and get a second start when this chain ends.
+void I2CBus::release()
+{
+	noInterrupts();
+	Completion start = m_waitingStart;
+	void* context = m_waitingContext;
+	m_holder = m_waiting;
+	m_waiting = kDeviceCount;
+	m_waitingStart = NULL;
+	if (start) start(context, true);
+	interrupts();
+}
+
+void I2CBus::sendAsync(Completion done, void* context)
+{
+	m_doneContext = context;
+	m_done = done;
+	m_wire.sendTransmission();
+}
+
+void I2CBus::requestAsync(uint8_t address, size_t bytes, Completion done, void* context)
+{
+	m_doneContext = context;
+	m_done = done;
+	m_wire.sendRequest(address, bytes, I2C_STOP);
+}
+
+void I2CBus::abort(Device device)
+{
+	noInterrupts();
+	bool running = m_holder == device && m_done;
+	interrupts();
+	// i2c_t3 only times a background transfer out in finish(), ending it
+	// runs the completion from the master done hook
+	if (running) m_wire.finish(1);
+}
+
+// Bus interrupt, blocking transfers have no completion
+void I2CBus::masterDone()
+{
+	Completion done = m_done;
+	if (!done) return;
+	m_done = NULL;
+	done(m_doneContext, m_wire.status() == I2C_WAITING);
+}
+
+void I2CBus::transferred(Device device, size_t bytes)
+{
+	device_stats& stats = m_stats[device];
+	stats.transfers++;
+	stats.bytes += bytes;
+	stats.busyMicros += transferMicros(bytes);
+}
+
+uint32_t I2CBus::transferMicros(size_t bytes) const
+{
+	// Nine clocks a byte with the acknowledge, about two for start and stop
+	return ((uint64_t)(bytes * 9 + 2) * 1000000 + m_rate - 1) / m_rate;
+}
+
+void I2CBus::removeSlot(int index)
+{
+	m_slotCount--;
+	for (int i = index; i < m_slotCount; i++) {
+		m_slots[i] = m_slots[i + 1];
+	}
+}
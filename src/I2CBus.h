@@ -0,0 +1,127 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef I2CBus_h
+#define I2CBus_h
+
+#include <Arduino.h>
+#include "i2c_t3.h"
+
+// The MS5611 and the display backpack both run at 400 kHz
+#define I2C_BUS_RATE 400000
+// 1 moves the display to Wire1, pins 29 and 30 under the Teensy 3.2, so it
+// never shares a bus with the barometer
+#define LCD_ON_WIRE1 0
+// A slot its device has not taken this long after it ended is dropped
+#define I2C_SLOT_TIMEOUT_US 20000
+// Wire and Wire1
+#define I2C_MAX_BUSES 2
+
+/**
+ * Shares an i2c_t3 bus between devices by priority.
+ *
+ * The barometer reserves a slot for its next transfers when it starts a
+ * conversion, they come at a fixed time after it. Lower priority devices
+ * start a transfer only when the bus is free and the transfer ends before
+ * the next slot of any device above them, so the display fills the gaps
+ * and the barometer does not wait for it.
+ *
+ * A device holds the bus for one transfer or a chain of them. Background
+ * transfers end in the bus interrupt, which calls the holder's completion;
+ * the holder starts the next transfer from there or releases the bus. A
+ * device asking for the bus from an interrupt while it is held is started
+ * on release.
+ */
+class I2CBus
+{
+public:
+	// Highest priority first
+	enum Device {
+		kBaro = 0,
+		kDisplay,
+		kDeviceCount
+	};
+	struct device_stats {
+		uint32_t transfers;
+		uint32_t bytes;
+		// Bus time, estimated from the bytes and the clock
+		uint32_t busyMicros;
+		// Transfers that found the bus busy and waited
+		uint32_t waits;
+	};
+	// Runs from the bus interrupt, `ok` false when the transfer failed
+	typedef void (*Completion)(void* context, bool ok);
+
+	I2CBus(i2c_t3& wire) : m_wire(wire) {};
+	// DMA mode moves long transfers by DMA, short ones still by interrupt
+	void begin(i2c_pins pins, uint32_t rate = I2C_BUS_RATE, i2c_op_mode mode = I2C_OP_MODE_ISR);
+	i2c_t3& wire() {
+		return m_wire;
+	}
+
+	// Reserves the bus from `at`, micros(), for a device's transfers
+	void reserve(Device device, uint32_t at, uint32_t micros);
+	// For lower priority devices, holds the bus when a transfer of `bytes`
+	// fits before the next slot above them
+	bool tryStart(Device device, size_t bytes);
+	// Holds the bus, waiting for a holder to release it
+	void acquire(Device device);
+	// From an interrupt: holds the bus and calls `start`, now or on release
+	void acquireAsync(Device device, Completion start, void* context);
+	void release();
+
+	// Times out a background transfer of `device` that never ended, its
+	// completion runs with `ok` false
+	void abort(Device device);
+
+	// Background transfers of the holder, after beginTransmission and write
+	void sendAsync(Completion done, void* context);
+	void requestAsync(uint8_t address, size_t bytes, Completion done, void* context);
+
+	// Counts a transfer of `bytes`, address bytes included
+	void transferred(Device device, size_t bytes);
+	// Bus time of `bytes`, with the start and stop
+	uint32_t transferMicros(size_t bytes) const;
+
+	const device_stats& stats(Device device) const {
+		return m_stats[device];
+	}
+	void resetStats() {
+		memset(m_stats, 0, sizeof(m_stats));
+	}
+private:
+	struct slot {
+		uint32_t at;
+		uint32_t micros;
+		uint8_t device;
+	};
+	bool hold(Device device);
+	bool holdLocked(Device device);
+	void removeSlot(int index);
+	void masterDone();
+	template <int N> static void masterDoneHook() {
+		s_buses[N]->masterDone();
+	}
+
+	static I2CBus* s_buses[I2C_MAX_BUSES];
+	static int s_busCount;
+
+	i2c_t3& m_wire;
+	uint32_t m_rate { I2C_BUS_RATE };
+	// One per device at most, in time order
+	slot m_slots[kDeviceCount];
+	int m_slotCount { 0 };
+	volatile uint8_t m_holder { kDeviceCount };
+	// Started on release
+	volatile uint8_t m_waiting { kDeviceCount };
+	Completion m_waitingStart { NULL };
+	void* m_waitingContext { NULL };
+	// Of the background transfer in flight
+	Completion volatile m_done { NULL };
+	void* m_doneContext { NULL };
+	device_stats m_stats[kDeviceCount] {};
+};
+
+#endif
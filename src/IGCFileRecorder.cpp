@@ -11,11 +11,62 @@
 #include "LiquidCrystal_I2C.h"
 #include "SimpleVario.h"
 #include "Utils.h"
-#include "Units/Measurement.h"
-#include "Units/UnitDuration.h"
 
-#define earthRadiusKm 6371.0
-#define deg2rad(DEG) (DEG * M_PI / 180)
+// User equivalent range error, turns a DOP into meters
+#define GPS_UERE_METERS 5.0
+// No fix from the GPS for this long and it is taken as lost
+#define GPS_TIMEOUT_MILLIS 2000
+// Manufacturer and logger id of the A-record
+#define IGC_MANUFACTURER "PEC"
+#define IGC_LOGGER_ID "002"
+// Flights go in FLIGHTS_FOLDER/YYYY/MM/
+#define FLIGHTS_FOLDER "/FLIGHTS"
+// Card bytes per fix: B-record with extensions and CRLF, the same in the
+// journal with its share of the block trailers, and a binary record
+#define IGC_BYTES_PER_FIX 50
+#define JOURNAL_BYTES_PER_FIX 64
+#define BINARY_BYTES_PER_FIX 12
+
+/**
+ * B-record extensions, declared once in the I-record and appended in this
+ * order to every fix. TAS is not declared since there is no airspeed sensor.
+ */
+struct igc_extension {
+	const char* code;
+	int width;
+};
+static const igc_extension kExtensions[] = {
+	{ "FXA", 3 },	// Horizontal fix accuracy, meters
+	{ "VXA", 3 },	// Vertical fix accuracy, meters
+	{ "SIU", 2 },	// Satellites in use
+	{ "VAT", 4 },	// Vario, signed decimeters per second
+	{ "TDS", 1 }	// Tenths of second of the fix
+};
+static const int kExtensionsCount = sizeof(kExtensions) / sizeof(igc_extension);
+// The widths of the extensions added up
+#define IGC_EXTENSIONS_LENGTH 13
+
+// Zero padded number into `width` chars of `dst`, clamped so it never
+// overflows its field. Written the way flightLogFormatNumber() reads it back.
+static void igcNumber(char* dst, long value, int width)
+{
+	if (value < 0) {
+		*dst++ = '-';
+		value = -value;
+		width--;
+	}
+	long limit = 1;
+	for (int i = 0; i < width; i++) {
+		limit *= 10;
+	}
+	if (value >= limit) {
+		value = limit - 1;
+	}
+	for (int i = width - 1; i >= 0; i--) {
+		dst[i] = '0' + value % 10;
+		value /= 10;
+	}
+}
 
 static void dateTimeCallback(uint16_t* date, uint16_t* time) 
 {
@@ -31,91 +82,235 @@ IGCFileRecorder::IGCFileRecorder()
 void IGCFileRecorder::update(SimpleGPS &gpsInfo, SimpleVario& vario)
 {
 	double now = millis();
-	if ((now - m_write_timer) < 1000) return;
-	m_write_timer = now;
-	if (!gpsInfo.fixed()) return;
-
-	queue_item item {
-		/* sentance */ gpsInfo.toIGC(vario.altitude()),
-		/* speed    */ (int)round(gpsInfo.knots())
-	};
-	m_queue.push(item);
-	if (m_queue.size() < m_bufferTime) return;
-	if (m_queue.size() > m_bufferTime) m_queue.shift();
-
-	auto speedSum = 0;
-	for (auto i = 0; i < m_bufferTime; i++)
+	bool newFix = gpsInfo.fixCount() != m_fixCount;
+	if (newFix)
 	{
-		speedSum += m_queue[i].speed;
+		m_fixCount = gpsInfo.fixCount();
+		m_fixTimer = now;
 	}
-	auto average = speedSum / m_bufferTime;
-
-	// end recording
-	if (average < m_minSpeed)
+	// A GPS gone quiet has no fix either
+	if (!gpsInfo.fixed() || (now - m_fixTimer) >= GPS_TIMEOUT_MILLIS)
 	{
-		if (m_recording == true)
+		// Without a fix only the baro can tell that we landed
+		if (m_recording && (now - m_sample_timer) >= 1000)
 		{
-			stopRecording();
+			m_sample_timer = now;
+			if (m_detector.update(vario.altitude(), vario.climbRate(), -1) == FlightDetector::kLanding)
+			{
+				stopRecording();
+			}
 		}
 		return;
 	}
+	// A record per fix the GPS sends, thinned evenly to the log rate, so no
+	// fix is written twice and the B-record times never repeat
+	if (!newFix) return;
+	int gpsRate = gpsInfo.updateRate();
+	m_fixCredit += min(m_logRate, gpsRate);
+	if (m_fixCredit < gpsRate) return;
+	m_fixCredit -= gpsRate;
+
+	char extensions[IGC_EXTENSIONS_LENGTH + 1];
+	createExtensions(extensions, gpsInfo, vario);
+	auto sentance = gpsInfo.toIGC(vario.altitude());
+	sentance += extensions;
 
-	// start recording
-	if (m_recording == false)
+	// Takeoff and landing are checked once a second, whatever the log rate
+	if ((now - m_sample_timer) >= 1000)
 	{
-		startRecording();
-		return;
+		m_sample_timer = now;
+		queue_item item {
+			/* sentance */ sentance,
+			/* speed    */ (int)round(gpsInfo.knots()),
+			/* latitude */ gpsInfo.latitude(),
+			/* longitude*/ gpsInfo.longitude()
+		};
+		m_queue.push(item);
+		if (m_recording) m_travelledDistance = distanceEarth(m_firstLatitude, m_firstLongitude, item.latitude, item.longitude);
+		if (m_queue.size() > m_detector.takeoffWindow()) m_queue.shift();
+
+		switch (m_detector.update(vario.altitude(), vario.climbRate(), gpsInfo.knots()))
+		{
+			case FlightDetector::kTakeoff:
+				startRecording();
+				return;
+			case FlightDetector::kLanding:
+				stopRecording();
+				return;
+			default:
+				break;
+		}
 	}
+	if (!m_recording) return;
 
-	SdFile igcFile;
-	igcFile.open(m_currentFile.c_str(), FILE_WRITE);
-	igcFile.println(item.sentance);
-	igcFile.close();
+	// The files stay open while flying, lines are buffered by the SD cache
+	writeLine(sentance);
 	m_lineCount++;
 	m_highestAltitude = max(m_highestAltitude, vario.altitude());
+	m_statistics.update(now, vario.altitude(), vario.climbRate(), gpsInfo.knots(), gpsInfo.latitude(), gpsInfo.longitude());
+	if ((now - m_sync_timer) >= m_syncInterval)
+	{
+		m_sync_timer = now;
+		if (m_logsIGC) m_file.sync();
+		m_binaryLog.sync();
+	}
+}
+
+void IGCFileRecorder::writeLine(const String& sentance)
+{
+	if (m_journal.isOpen()) m_journal.println(sentance);
+	else if (m_logsIGC && m_file.isOpen()) m_file.println(sentance);
+	if (m_logsBinary) m_binaryLog.write(sentance);
+}
 
+void IGCFileRecorder::writeEvent(const char* name)
+{
+	// Time of the last fix, HHMMSS UTC
+	auto time = m_queue.size() ? m_queue.last().sentance.substring(1, 7) : String("000000");
+	writeLine(String("LPEC") + name + ":" + time + " " + m_detector.reason());
+}
+
+void IGCFileRecorder::writeStatistics()
+{
+	// L-records, metric units
+	const FlightStatistics& s = m_statistics;
+	writeLine("LPECDURATION:" + totalTime());
+	writeLine("LPECMAXCLIMB:" + String(s.maxClimb(), 1) + "MS");
+	writeLine("LPECMAXSINK:" + String(s.maxSink(), 1) + "MS");
+	writeLine("LPECAVGCLIMB:" + String(s.averageClimb(), 1) + "MS");
+	writeLine("LPECBESTCLIMB30S:" + String(s.bestClimb(), 1) + "MS");
+	writeLine("LPECTHERMALS:" + String(s.thermalCount()));
+	writeLine("LPECLIFTTIME:" + readableDuration(s.liftTime()));
+	writeLine("LPECMAXSPEED:" + String(s.maxSpeed() * 1.852, 0) + "KMH");
+	writeLine("LPECGAIN:" + String(s.altitudeGain(), 0) + "M");
+	writeLine("LPECDISTANCE:" + String(s.distance(), 1) + "KM");
+	writeLine("LPECGLIDE:" + String(s.glideRatio(), 1));
 }
 
 String IGCFileRecorder::createHeader()
 {
 	String header;
-	header += String("APEC002 SimpleVario\r\n");
+	header += String("A" IGC_MANUFACTURER IGC_LOGGER_ID " SimpleVario\r\n");
 	header += String("HFDTE" + m_date + "\r\n");
 	header += String("HFPLTPILOT:" + m_pilotName + "\r\n");
-	header += String("HFGTYGLIDERTYPE:" + m_gliderType);
+	header += String("HFGTYGLIDERTYPE:" + m_gliderType + "\r\n");
+	header += createExtensionsHeader();
 	return header;
 }
 
+String IGCFileRecorder::createExtensionsHeader()
+{
+	// Extensions start right after the 35 bytes of the B-record
+	String record("I" + iString(kExtensionsCount));
+	int start = 36;
+	for (int i = 0; i < kExtensionsCount; i++)
+	{
+		int end = start + kExtensions[i].width - 1;
+		record += iString(start) + iString(end) + kExtensions[i].code;
+		start = end + 1;
+	}
+	return record;
+}
+
+void IGCFileRecorder::createExtensions(char* extensions, SimpleGPS& gpsInfo, SimpleVario& vario)
+{
+	long values[kExtensionsCount] = {
+		/* FXA */ lround(gpsInfo.horizontalAccuracy() * GPS_UERE_METERS),
+		/* VXA */ lround(gpsInfo.altitudeAccuracy() * GPS_UERE_METERS),
+		/* SIU */ gpsInfo.satellites(),
+		/* VAT */ lround(vario.climbRate() * 10.0),
+		/* TDS */ gpsInfo.tenths()
+	};
+	char* out = extensions;
+	for (int i = 0; i < kExtensionsCount; i++)
+	{
+		igcNumber(out, values[i], kExtensions[i].width);
+		out += kExtensions[i].width;
+	}
+	*out = '\0';
+}
+
+static char base36(int value)
+{
+	return value < 10 ? '0' + value : 'A' + value - 10;
+}
+
+// Two digits of the DDMMYY date at `index`
+static int dateField(const String& date, int index)
+{
+	if ((int)date.length() < index + 2) return 0;
+	return (date[index] - '0') * 10 + date[index + 1] - '0';
+}
+
+/**
+ * IGC short file name YMDCXXXF, without the extension, in the folder of the
+ * month. Year, month and day are one base 36 digit each, C is X for a
+ * manufacturer without a one letter code, XXX the logger id and F the flight
+ * of the day. Names are 8.3, so the card needs no long name entries, and
+ * the folders stay small however many flights are on it.
+ *
+ * The date is the UTC one of the HFDTE record, not the local clock. Returns
+ * an empty name when all 35 flights of the day are taken.
+ */
 String IGCFileRecorder::createFileName()
 {
-	return
-		 String(year()) + "-" +
-		iString(month()) + "-" +
-		iString(day()) + "_" + 
-		iString(hour()) + "." + 
-		iString(minute()) + "." + 
-		iString(second()) + ".igc"; 
+	int utcDay = dateField(m_date, 0);
+	int utcMonth = dateField(m_date, 2);
+	int utcYear = 2000 + dateField(m_date, 4);
+	String folder = String(FLIGHTS_FOLDER "/") + utcYear + "/" + iString(utcMonth);
+	SdFile dir;
+	if (!dir.open(folder.c_str(), O_READ) && !dir.mkdir(FatFile::cwd(), folder.c_str(), true))
+	{
+		// Better a flight in the root than no flight
+		folder = "";
+	}
+	FatFile* parent = dir.isOpen() ? &dir : FatFile::cwd();
+	String name = String(base36(utcYear % 10)) + base36(utcMonth) + base36(utcDay) + "X" IGC_LOGGER_ID;
+	char flight = '1';
+	while (true)
+	{
+		String file = name + flight;
+		if (!parent->exists((file + ".IGC").c_str()) && !parent->exists((file + ".SVL").c_str())) break;
+		// Appending to an earlier flight would spoil both
+		if (flight == 'Z') return String();
+		flight = flight == '9' ? 'A' : flight + 1;
+	}
+	return folder + "/" + name + flight;
+}
+
+double IGCFileRecorder::bytesPerHour()
+{
+	int bytes = m_logsJournal ? JOURNAL_BYTES_PER_FIX : m_logsIGC ? IGC_BYTES_PER_FIX : 0;
+	if (m_logsBinary) bytes += BINARY_BYTES_PER_FIX;
+	return 3600.0 * m_logRate * bytes;
 }
 
 String IGCFileRecorder::totalTime()
 {
-	Measurement<UnitDuration> totalTime(m_lineCount, UnitDuration::seconds());
-	auto hours = (int)totalTime.convertedTo(UnitDuration::hours()).value() % 60;
-	auto minutes = (int)totalTime.convertedTo(UnitDuration::minutes()).value() % 60;
-	auto seconds = (int)totalTime.value() % 60;
-	return iString(hours) + ":" + iString(minutes) + ":" +iString(seconds);
+	return readableDuration(m_statistics.duration());
 }
 
 void IGCFileRecorder::reset() {
 	m_lineCount = 0;
 	m_highestAltitude = 0;
 	m_currentFile = "";
-	m_lineCount = 0;
+	m_travelledDistance = 0;
+	m_statistics.begin(0);
 	m_showResults = false;
 }
 
 void IGCFileRecorder::stopRecording()
 {
+	writeEvent("LANDING");
+	writeStatistics();
+	if (m_binaryLog.textFixes())
+	{
+		// The binary log kept them, in text blocks
+		writeLine("LPECBINARYTEXTFIXES:" + String(m_binaryLog.textFixes()));
+	}
+	m_file.close();
+	m_journal.close();
+	m_binaryLog.close();
 	m_recording = false;
 	m_showResults = true;
 }
@@ -123,85 +318,50 @@ void IGCFileRecorder::stopRecording()
 void IGCFileRecorder::startRecording()
 {
 	m_recording = true;
-	m_currentFile = createFileName();
-	m_firstSentance = m_queue.first().sentance;
-
-	SdFile igcFile;
-	igcFile.open(m_currentFile.c_str(), FILE_WRITE);
-	igcFile.println(createHeader());
-	auto insert = false;
-	for (auto i = 0; i < m_bufferTime; i++)
+	// Without a name the flight is only shown, not logged
+	auto fileName = createFileName();
+	bool named = fileName.length() > 0;
+	m_currentFile = named ? fileName + ".IGC" : String();
+	m_firstLatitude = m_queue.first().latitude;
+	m_firstLongitude = m_queue.first().longitude;
+	m_travelledDistance = distanceEarth(m_firstLatitude, m_firstLongitude, m_queue.last().latitude, m_queue.last().longitude);
+
+	auto header = createHeader();
+	if (named && m_logsJournal)
 	{
-		auto item = m_queue[i];
-		if (insert == false && item.speed > 0)
-		{
-			insert = true;
-			if (i == 0) {
-				m_lineCount++;
-				igcFile.println(item.sentance);
-				continue;
-			}
-			m_lineCount++;
-			igcFile.println(m_queue[i-1].sentance);
-		}
-		if (insert)
+		uint32_t size = m_journalHours * 3600 * m_logRate * JOURNAL_BYTES_PER_FIX;
+		if (m_journal.open(m_currentFile.c_str(), size, now()))
 		{
-			m_lineCount++;
-			igcFile.println(item.sentance);
+			m_journal.println(header);
 		}
 	}
-	igcFile.close();
-}
-
-double IGCFileRecorder::travelledDistance() {
-
-	auto lat1 = convertToDecimal(m_firstSentance.substring(7, 7+8));
-	auto lon1 = convertToDecimal(m_firstSentance.substring(15, 15+9));
-
-	auto lat2 = convertToDecimal(m_queue.last().sentance.substring(7, 7+8));
-	auto lon2 = convertToDecimal(m_queue.last().sentance.substring(15, 15+9));
-
-	return distanceEarth(lat1, lon1, lat2, lon2);
-}
-
-double IGCFileRecorder::convertToDecimal(const String& point) {
-	if (point == "0") return 0.0;
-	double multiplier = ((point.indexOf("S") > -1) || (point.indexOf("W") > 1)) ? -1.0 : 1.0;
-	double degrees;
-	double minutes;
-	// Latitude, 8 chars: 3718157N
-    if (point.length() == 8) {
-    	// 37
-        degrees = point.substring(0, 0+2).toFloat();
-        // 18 + (157 / 1000)
-        minutes = point.substring(2, 2+2).toFloat() + (point.substring(4, 4+3).toFloat() / 1000);
-    } 
-    // Longitude: 12153538W
-    else {
-    	// 121
-        degrees = point.substring(0, 0+3).toFloat();
-        // 53 + (538 / 1000)
-        minutes = point.substring(3, 3+2).toFloat() + (point.substring(5, 5+3).toFloat() / 1000);
-    }
-    return (degrees + (minutes / 60)) * multiplier;
-}
-
-/**
- * Returns the distance between two points on the Earth.
- * Direct translation from http://en.wikipedia.org/wiki/Haversine_formula
- * @param lat1d Latitude of the first point in degrees
- * @param lon1d Longitude of the first point in degrees
- * @param lat2d Latitude of the second point in degrees
- * @param lon2d Longitude of the second point in degrees
- * @return The distance between the two points in kilometers
- */
-double IGCFileRecorder::distanceEarth(double lat1d, double lon1d, double lat2d, double lon2d) {
-	double lat1r = deg2rad(lat1d);
-	double lon1r = deg2rad(lon1d);
-	double lat2r = deg2rad(lat2d);
-	double lon2r = deg2rad(lon2d);
-	double u = sin((lat2r - lat1r)/2);
-	double v = sin((lon2r - lon1r)/2);
-	return 2.0 * earthRadiusKm * asin(sqrt(u * u + cos(lat1r) * cos(lat2r) * v * v));
+	// The plain IGC log grows through the SD cache, its full blocks are
+	// written while the loop waits. Only the journal, whose blocks tell a
+	// stale one from its own, goes to the card by DMA.
+	if (named && m_logsIGC && !m_journal.isOpen())
+	{
+		m_file.open(m_currentFile.c_str(), FILE_WRITE);
+		m_file.println(header);
+	}
+	if (named && m_logsBinary)
+	{
+		m_binaryLog.open((fileName + ".SVL").c_str(), header);
+	}
+	// Backfill the takeoff window, from one fix before the first that moved
+	int first = 0;
+	while (first < m_queue.size() && m_queue[first].speed == 0) first++;
+	// Nothing moved, the baro saw the takeoff
+	if (first == m_queue.size()) first = 0;
+	else if (first > 0) first--;
+	for (auto i = first; i < m_queue.size(); i++)
+	{
+		m_lineCount++;
+		writeLine(m_queue[i].sentance);
+	}
+	writeEvent("TAKEOFF");
+	// The queued fixes are one second apart, the flight started with the first
+	m_statistics.begin(millis() - 1000.0 * max(m_lineCount - 1, 0));
+	if (m_logsIGC) m_file.sync();
+	m_binaryLog.sync();
+	m_sync_timer = millis();
 }
-
@@ -8,6 +8,11 @@
 
 #include <Arduino.h>
 #include "SimpleArray.h"
+#include "SdFat/SdFat.h"
+#include "FlightLogWriter.h"
+#include "JournalLog.h"
+#include "FlightStatistics.h"
+#include "FlightDetector.h"
 
 class SimpleGPS;
 class LiquidCrystal_I2C;
@@ -29,13 +34,36 @@ public:
 	void setUtc(int utc) {
 		m_utc = utc;
 	}
+	// Number of B-records per second, 1 to 10
+	void setLogRate(int hz) {
+		m_logRate = constrain(hz, 1, 10);
+	}
+	int logRate() {
+		return m_logRate;
+	}
+	// Which of the IGC text and binary logs get written, at least one.
+	// A journaled IGC log replaces the plain one.
+	void setLogFormats(bool igc, bool binary, bool journal = false) {
+		m_logsIGC = igc || !binary || journal;
+		m_logsBinary = binary;
+		m_logsJournal = journal;
+	}
+	// Card space an hour of flight takes with the current rate and formats
+	double bytesPerHour();
+	// Seconds of takeoff and landing detection
+	void setDetectionWindows(int takeoffSeconds, int landingSeconds) {
+		m_detector.setWindows(takeoffSeconds, landingSeconds);
+	}
 	bool recording() {
 		return m_recording;
 	}
 	bool showResults() {
 		return m_showResults;
 	}
-	double travelledDistance();
+	// Straight line from the first fix of the flight to the last, in km
+	double travelledDistance() {
+		return m_travelledDistance;
+	}
 	int lineCount() {
 		return m_lineCount;
 	}
@@ -43,26 +71,53 @@ public:
 		return m_highestAltitude;
 	}
 	String totalTime();
+	const FlightStatistics& statistics() {
+		return m_statistics;
+	}
 	void reset();
 
 private:
 	String createHeader();
+	String createExtensionsHeader();
+	// IGC_EXTENSIONS_LENGTH chars and the terminator into `extensions`
+	void createExtensions(char* extensions, SimpleGPS& gpsInfo, SimpleVario& vario);
 	String createFileName();
+	void writeLine(const String& sentance);
+	void writeEvent(const char* name);
+	void writeStatistics();
 	void startRecording();
 	void stopRecording();
-	double convertToDecimal(const String& point);
-	double distanceEarth(double lat1d, double lon1d, double lat2d, double lon2d);
 	struct queue_item {
 		String sentance;
 		int speed;
+		double latitude;
+		double longitude;
 	};
 
-	String m_firstSentance {""};
+	// First fix of the flight, the distance is from it to the last one queued
+	double m_firstLatitude { 0.0 };
+	double m_firstLongitude { 0.0 };
+	double m_travelledDistance { 0.0 };
 
 	SimpleArray<queue_item> m_queue;
-	double m_write_timer { 0 };
-	double m_bufferTime { 10 };
-	double m_minSpeed { 5 };
+	SdFile m_file;
+	FlightLogWriter m_binaryLog;
+	JournalLog m_journal;
+	FlightStatistics m_statistics;
+	FlightDetector m_detector;
+	// Last fix seen from the GPS, and the log rate's share of its fixes
+	uint32_t m_fixCount { 0 };
+	double m_fixTimer { 0 };
+	int m_fixCredit { 0 };
+	double m_sample_timer { 0 };
+	double m_sync_timer { 0 };
+	double m_syncInterval { 10000 };
+	int m_logRate { 1 };
+	bool m_logsIGC { true };
+	bool m_logsBinary { false };
+	bool m_logsJournal { false };
+	// Journal space reserved at takeoff
+	double m_journalHours { 8 };
 	double m_highestAltitude {0.0};
 
 	bool m_recording { false };
@@ -0,0 +1,254 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include "JournalLog.h"
+#include "FlightLogFormat.h"
+
+static const char kHexDigits[] = "0123456789ABCDEF";
+
+static void putHex(uint8_t* dst, uint32_t value, int digits)
+{
+	for (int i = digits - 1; i >= 0; i--) {
+		dst[i] = kHexDigits[value & 0xF];
+		value >>= 4;
+	}
+}
+
+static bool getHex(const uint8_t* src, int digits, uint32_t* value)
+{
+	uint32_t result = 0;
+	for (int i = 0; i < digits; i++) {
+		uint8_t c = src[i];
+		if (c >= '0' && c <= '9') {
+			result = (result << 4) | (c - '0');
+		} else if (c >= 'A' && c <= 'F') {
+			result = (result << 4) | (c - 'A' + 10);
+		} else {
+			return false;
+		}
+	}
+	*value = result;
+	return true;
+}
+
+bool JournalLog::open(const char* path, uint32_t size, uint32_t flightId)
+{
+	size = (size + JOURNAL_BLOCK_SIZE - 1) & ~(uint32_t)(JOURNAL_BLOCK_SIZE - 1);
+	if (!m_file.createContiguous(path, size)) return false;
+	uint32_t lastBlock;
+	if (!m_file.contiguousRange(&m_firstBlock, &lastBlock)) {
+		m_file.remove();
+		return false;
+	}
+	// The last cluster may go past the end of the file
+	m_blockCount = m_file.fileSize() / JOURNAL_BLOCK_SIZE;
+	m_fill = 0;
+	m_pending = false;
+	m_used = 0;
+	m_sequence = 0;
+	m_droppedLines = 0;
+	m_failedBlocks = 0;
+	m_flightId = flightId;
+
+	SdFile marker;
+	if (!marker.open(JOURNAL_MARKER, O_CREAT | O_WRITE | O_TRUNC)) {
+		m_file.remove();
+		return false;
+	}
+	marker.println(path);
+	marker.println(String(flightId));
+	marker.close();
+	return true;
+}
+
+void JournalLog::println(const String& text)
+{
+	if (!m_file.isOpen()) return;
+	startBlock();
+	// One line at a time, a header comes as several
+	const char* line = text.c_str();
+	const char* end = line + text.length();
+	do {
+		const char* next = (const char*)memchr(line, '\n', end - line);
+		size_t length = (next ? next : end) - line;
+		if (length > 0 && line[length - 1] == '\r') length--;
+		appendLine(line, length);
+		line = next ? next + 1 : end;
+	} while (line < end);
+}
+
+void JournalLog::appendLine(const char* line, size_t length)
+{
+	size_t size = length + 2;
+	if (size > JOURNAL_BLOCK_SIZE - JOURNAL_TRAILER_SIZE) {
+		m_droppedLines++;
+		return;
+	}
+	if (m_used + size > JOURNAL_BLOCK_SIZE - JOURNAL_TRAILER_SIZE) {
+		writeBlock();
+	}
+	uint8_t* block = m_block[m_fill];
+	memcpy(block + m_used, line, length);
+	block[m_used + size - 2] = '\r';
+	block[m_used + size - 1] = '\n';
+	m_used += size;
+}
+
+// An IGC line of `size` bytes with its CRLF, "LSVJ" and spaces
+static void putFiller(uint8_t* dst, size_t size)
+{
+	memcpy(dst, "LSVJ", 4);
+	memset(dst + 4, ' ', size - 6);
+	dst[size - 2] = '\r';
+	dst[size - 1] = '\n';
+}
+
+void JournalLog::writeBlock()
+{
+	// Filler L-records up to the trailer, every line within the IGC limit
+	uint8_t* block = m_block[m_fill];
+	size_t left = JOURNAL_BLOCK_SIZE - m_used;
+	while (left > JOURNAL_LINE_SIZE) {
+		size_t size = min(left - JOURNAL_TRAILER_SIZE, (size_t)JOURNAL_LINE_SIZE);
+		putFiller(block + m_used, size);
+		m_used += size;
+		left -= size;
+	}
+	// L-record trailer, the last line, padded with spaces to the block end
+	uint8_t* trailer = block + m_used;
+	memcpy(trailer, "LSVJ", 4);
+	putHex(trailer + 4, m_sequence, 8);
+	putHex(trailer + 12, m_flightId, 8);
+	putHex(trailer + 20, flightLogCrc(block, m_used + 20), 4);
+	memset(trailer + 24, ' ', left - 26);
+	block[JOURNAL_BLOCK_SIZE - 2] = '\r';
+	block[JOURNAL_BLOCK_SIZE - 1] = '\n';
+
+	// Both buffers full, this is the only place that waits for the card
+	if (m_pending) {
+		startBlock(true);
+	}
+	// The other buffer gets filled next, its data has to be out
+	finishBlock();
+	m_pending = true;
+	m_fill ^= 1;
+	m_sequence++;
+	m_used = 0;
+	startBlock();
+}
+
+// The pending block is the one before m_sequence, in the other buffer
+void JournalLog::startBlock(bool wait)
+{
+	if (!m_pending) return;
+	FatVolume* volume = m_file.volume();
+	if (!wait && volume->isBusy()) return;
+	uint32_t sequence = m_sequence - 1;
+	const uint8_t* block = m_block[m_fill ^ 1];
+	// Past the allocation, or a command the card refused, through the file.
+	// The flight outlasting the allocation grows the file a cluster at a time.
+	if (sequence >= m_blockCount || !volume->writeBlockStart(m_firstBlock + sequence, block)) {
+		rewriteBlock(sequence, block);
+	}
+	m_pending = false;
+}
+
+// Waits for the block on its way out, one the card rejected is written again
+void JournalLog::finishBlock()
+{
+	if (!m_file.volume()->writeBlockFinish()) {
+		rewriteBlock(m_sequence - 1, m_block[m_fill ^ 1]);
+	}
+}
+
+void JournalLog::rewriteBlock(uint32_t sequence, const uint8_t* block)
+{
+	if (!m_file.seekSet(sequence * JOURNAL_BLOCK_SIZE) ||
+		m_file.write(block, JOURNAL_BLOCK_SIZE) != JOURNAL_BLOCK_SIZE) {
+		m_failedBlocks++;
+	}
+}
+
+void JournalLog::close()
+{
+	if (!m_file.isOpen()) return;
+	if (m_used > 0) {
+		writeBlock();
+	}
+	startBlock(true);
+	finishBlock();
+	m_file.truncate(m_sequence * JOURNAL_BLOCK_SIZE);
+	m_file.close();
+
+	SdFile marker;
+	if (marker.open(JOURNAL_MARKER, O_WRITE)) {
+		marker.remove();
+	}
+}
+
+bool JournalLog::validBlock(const uint8_t* block, uint32_t sequence, uint32_t flightId)
+{
+	if (block[JOURNAL_BLOCK_SIZE - 2] != '\r' || block[JOURNAL_BLOCK_SIZE - 1] != '\n') return false;
+	// The trailer is the last line of the block
+	int start = JOURNAL_BLOCK_SIZE - 3;
+	while (start > 0 && block[start - 1] != '\n') {
+		start--;
+	}
+	if (start > JOURNAL_BLOCK_SIZE - JOURNAL_TRAILER_SIZE) return false;
+	if (memcmp(block + start, "LSVJ", 4) != 0) return false;
+	uint32_t blockSequence, blockFlightId, crc;
+	if (!getHex(block + start + 4, 8, &blockSequence) ||
+		!getHex(block + start + 12, 8, &blockFlightId) ||
+		!getHex(block + start + 20, 4, &crc)) return false;
+	return blockSequence == sequence &&
+		blockFlightId == flightId &&
+		crc == flightLogCrc(block, start + 20);
+}
+
+bool JournalLog::recover()
+{
+	SdFile marker;
+	if (!marker.open(JOURNAL_MARKER, O_READ)) return false;
+	char path[64];
+	char id[16];
+	int16_t n = marker.fgets(path, sizeof(path));
+	int16_t m = marker.fgets(id, sizeof(id));
+	marker.close();
+	if (n > 0 && path[n - 1] == '\n') path[--n] = 0;
+	if (n > 0 && path[n - 1] == '\r') path[--n] = 0;
+	uint32_t flightId = strtoul(id, NULL, 10);
+
+	bool recovered = false;
+	SdFile file;
+	if (n > 0 && m > 0 && file.open(path, O_RDWR))
+	{
+		// Blocks are valid up to where the power went out, stale after that
+		uint8_t block[JOURNAL_BLOCK_SIZE];
+		uint32_t low = 0;
+		uint32_t high = file.fileSize() / JOURNAL_BLOCK_SIZE;
+		while (low < high) {
+			uint32_t middle = (low + high) / 2;
+			bool valid = file.seekSet(middle * JOURNAL_BLOCK_SIZE) &&
+				file.read(block, JOURNAL_BLOCK_SIZE) == JOURNAL_BLOCK_SIZE &&
+				validBlock(block, middle, flightId);
+			if (valid) {
+				low = middle + 1;
+			} else {
+				high = middle;
+			}
+		}
+		if (low > 0) {
+			recovered = file.truncate(low * JOURNAL_BLOCK_SIZE);
+			file.close();
+		} else {
+			// Nothing made it to the card
+			file.remove();
+		}
+	}
+	if (marker.open(JOURNAL_MARKER, O_WRITE)) {
+		marker.remove();
+	}
+	return recovered;
+}
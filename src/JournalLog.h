@@ -0,0 +1,83 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef JournalLog_h
+#define JournalLog_h
+
+#include <Arduino.h>
+#include "SdFat/SdFat.h"
+
+// Remembers the journal being written, gone after a clean close
+#define JOURNAL_MARKER "JOURNAL.TXT"
+#define JOURNAL_BLOCK_SIZE 512
+// "LSVJ" + sequence + flight id + crc + "\r\n"
+#define JOURNAL_TRAILER_SIZE 26
+// Longest line of the journal with its CRLF, the IGC record limit
+#define JOURNAL_LINE_SIZE 76
+
+/**
+ * Power loss tolerant IGC log.
+ *
+ * The file is allocated contiguous and full size when the flight starts and
+ * is then only ever written one whole 512 byte block at a time, so neither
+ * the FAT nor the directory entry change while flying. Each block ends with
+ * an IGC L-record holding its sequence number, the flight id and a crc,
+ * after short filler L-records up to it, and the file is a valid IGC file
+ * at all times.
+ *
+ * Blocks go straight to the card with two buffers: one is filled while the
+ * other is sent by DMA, and the card is left programming it. A full block
+ * waits in its buffer until the card is no longer busy, so the loop only
+ * stalls if the card stays busy for a whole block of lines. A block the
+ * card refuses or rejects is written again through the file.
+ *
+ * After a power loss, recover() finds the last valid block with a binary
+ * search, a few dozen block reads at most, and truncates the file there.
+ */
+class JournalLog
+{
+public:
+	JournalLog() {};
+	bool open(const char* path, uint32_t size, uint32_t flightId);
+	// Each line of `text` as its own line
+	void println(const String& text);
+	void close();
+	bool isOpen() {
+		return m_file.isOpen();
+	}
+	// Lines too long for a block, left out
+	uint32_t droppedLines() const {
+		return m_droppedLines;
+	}
+	// Blocks that did not make it to the card, even written again
+	uint32_t failedBlocks() const {
+		return m_failedBlocks;
+	}
+	// Returns true if an unterminated journal was found and repaired
+	static bool recover();
+private:
+	void appendLine(const char* line, size_t length);
+	void writeBlock();
+	void startBlock(bool wait = false);
+	void finishBlock();
+	void rewriteBlock(uint32_t sequence, const uint8_t* block);
+	static bool validBlock(const uint8_t* block, uint32_t sequence, uint32_t flightId);
+
+	SdFile m_file;
+	uint8_t m_block[2][JOURNAL_BLOCK_SIZE];
+	// Buffer being filled, the other one is pending or on its way out
+	uint8_t m_fill { 0 };
+	bool m_pending { false };
+	// Card blocks of the file, past the last one blocks go through the file
+	uint32_t m_firstBlock { 0 };
+	uint32_t m_blockCount { 0 };
+	size_t m_used { 0 };
+	uint32_t m_sequence { 0 };
+	uint32_t m_flightId { 0 };
+	uint32_t m_droppedLines { 0 };
+	uint32_t m_failedBlocks { 0 };
+};
+
+#endif
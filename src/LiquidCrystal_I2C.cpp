@@ -6,18 +6,17 @@
 
 #include <Arduino.h>
 
-#define printIIC(args)	Wire.write(args)
+#define printIIC(args)	wire().write(args)
 inline size_t LiquidCrystal_I2C::write(uint8_t value) {
-	send(value, Rs);
-	return 1;
+	return write(&value, 1);
 }
 
 #else
 #include "WProgram.h"
 
-#define printIIC(args)	Wire.send(args)
+#define printIIC(args)	wire().send(args)
 inline void LiquidCrystal_I2C::write(uint8_t value) {
-	send(value, Rs);
+	write(&value, 1);
 }
 
 #endif
@@ -46,9 +45,18 @@ inline void LiquidCrystal_I2C::write(uint8_t value) {
 LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows)
 {
   _Addr = lcd_Addr;
-  _cols = lcd_cols;
-  _rows = lcd_rows;
+  _cols = min(lcd_cols, (uint8_t)LCD_MAX_COLS);
+  _rows = min(lcd_rows, (uint8_t)LCD_MAX_ROWS);
   _backlightval = LCD_NOBACKLIGHT;
+  memset(_shown, ' ', sizeof(_shown));
+  memset(_frame, ' ', sizeof(_frame));
+  _cursorKnown = false;
+  _pendingLength = 0;
+  _pendingDone = false;
+  _pendingOk = false;
+  _bytesSent = 0;
+  _graphtype = 0;
+  _bus = NULL;
 }
 
 void LiquidCrystal_I2C::init(){
@@ -57,12 +65,14 @@ void LiquidCrystal_I2C::init(){
 
 void LiquidCrystal_I2C::init_priv()
 {
-	Wire.begin();
+	if (!_bus) Wire.begin();
 	_displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
 	begin(_cols, _rows);  
 }
 
 void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
+	_cols = min(cols, (uint8_t)LCD_MAX_COLS);
+	_rows = min(lines, (uint8_t)LCD_MAX_ROWS);
 	if (lines > 1) {
 		_displayfunction |= LCD_2LINE;
 	}
@@ -126,11 +136,19 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 void LiquidCrystal_I2C::clear(){
 	command(LCD_CLEARDISPLAY);// clear display, set cursor position to zero
 	delayMicroseconds(2000);  // this command takes a long time!
+	memset(_shown, ' ', sizeof(_shown));
+	memset(_frame, ' ', sizeof(_frame));
+	_col = 0;
+	_row = 0;
+	_cursorKnown = true;
 }
 
 void LiquidCrystal_I2C::home(){
 	command(LCD_RETURNHOME);  // set cursor position to zero
 	delayMicroseconds(2000);  // this command takes a long time!
+	_col = 0;
+	_row = 0;
+	_cursorKnown = true;
 }
 
 void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row){
@@ -139,6 +157,117 @@ void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row){
 		row = _numlines-1;    // we count rows starting w/0
 	}
 	command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+	_col = col;
+	_row = row;
+	_cursorKnown = true;
+}
+
+void LiquidCrystal_I2C::setText(uint8_t col, uint8_t row, const char *text, uint8_t length) {
+	if (row >= _rows || col >= _cols) return;
+	memcpy(&_frame[row][col], text, min(length, (uint8_t)(_cols - col)));
+}
+
+uint16_t LiquidCrystal_I2C::refresh() {
+	uint32_t start = _bytesSent;
+	finishAsync();
+	uint8_t row, col, length;
+	while (nextRun(row, col, length)) {
+		if (!_cursorKnown || _row != row || _col != col) {
+			setCursor(col, row);
+		}
+		write(&_frame[row][col], length);
+	}
+	return _bytesSent - start;
+}
+
+bool LiquidCrystal_I2C::update() {
+	if (_pendingLength) {
+		if (_bus ? !_pendingDone : !wire().done()) return false;
+		finishAsync();
+	}
+	uint8_t row, col, length;
+	if (!nextRun(row, col, length)) return true;
+	length = min(length, (uint8_t)LCD_ASYNC_CHARS);
+
+	// Cursor move and characters in one transfer, each after its Rs settles
+	uint8_t batch[LCD_BATCH_SIZE];
+	size_t size = 0;
+	if (!_cursorKnown || _row != row || _col != col) {
+		int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
+		batch[size++] = _backlightval;
+		size += encode(LCD_SETDDRAMADDR | (col + row_offsets[row]), 0, batch + size);
+	}
+	batch[size++] = Rs | _backlightval;
+	for (uint8_t i = 0; i < length; i++) {
+		size += encode(_frame[row][col + i], Rs, batch + size);
+	}
+	// Only in the gaps between barometer transfers
+	if (_bus && !_bus->tryStart(I2CBus::kDisplay, 1 + size)) return false;
+	memcpy(_pending, &_frame[row][col], length);
+	_pendingRow = row;
+	_pendingCol = col;
+	_pendingLength = length;
+
+	wire().beginTransmission(_Addr);
+	wire().write(batch, size);
+	if (_bus) {
+		_pendingDone = false;
+		_bus->sendAsync(asyncDone, this);
+	} else {
+		wire().sendTransmission();
+	}
+	sent(1 + size);
+	return false;
+}
+
+// First run of cells that differ from the display. Runs take in single
+// unchanged cells, a character costs no more than the cursor move and
+// saves a transfer.
+bool LiquidCrystal_I2C::nextRun(uint8_t &row, uint8_t &col, uint8_t &length) {
+	for (row = 0; row < _rows; row++) {
+		for (col = 0; col < _cols; col++) {
+			if (_frame[row][col] == _shown[row][col]) continue;
+			uint8_t end = col + 1;
+			while (end < _cols && (_frame[row][end] != _shown[row][end] ||
+				(end + 1 < _cols && _frame[row][end + 1] != _shown[row][end + 1]))) {
+				end++;
+			}
+			length = end - col;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Waits for the background transfer, if any, and takes in its cells
+void LiquidCrystal_I2C::finishAsync() {
+	if (!_pendingLength) return;
+	uint8_t length = _pendingLength;
+	_pendingLength = 0;
+	bool ok;
+	if (_bus) {
+		while (!_pendingDone) {}
+		ok = _pendingOk;
+	} else {
+		ok = wire().finish();
+	}
+	if (ok) {
+		memcpy(&_shown[_pendingRow][_pendingCol], _pending, length);
+		_row = _pendingRow;
+		_col = _pendingCol + length;
+		_cursorKnown = true;
+	} else {
+		// Unknown what the display got, the cells stay changed
+		_cursorKnown = false;
+	}
+}
+
+// Bus interrupt, the background transfer ended
+void LiquidCrystal_I2C::asyncDone(void *context, bool ok) {
+	LiquidCrystal_I2C *lcd = (LiquidCrystal_I2C *)context;
+	lcd->_pendingOk = ok;
+	lcd->_pendingDone = true;
+	lcd->_bus->release();
 }
 
 // Turn the display on/off (quickly)
@@ -206,11 +335,15 @@ void LiquidCrystal_I2C::noAutoscroll(void) {
 // Allows us to fill the first 8 CGRAM locations
 // with custom characters
 void LiquidCrystal_I2C::createChar(uint8_t location, uint8_t charmap[]) {
+	// A background transfer ending after this would leave the cursor known
+	finishAsync();
 	location &= 0x7; // we only have 8 locations 0-7
 	command(LCD_SETCGRAMADDR | (location << 3));
 	for (int i=0; i<8; i++) {
-		write(charmap[i]);
+		send(charmap[i], Rs);
 	}
+	// The address counter is in CGRAM now
+	_cursorKnown = false;
 }
 
 // Turn the (optional) backlight off/on
@@ -235,12 +368,84 @@ inline void LiquidCrystal_I2C::command(uint8_t value) {
 
 /************ low level data pushing commands **********/
 
-// write either command or data
+// write either command or data, one I2C transfer
 void LiquidCrystal_I2C::send(uint8_t value, uint8_t mode) {
-	uint8_t highnib=value&0xf0;
-	uint8_t lownib=(value<<4)&0xf0;
-       write4bits((highnib)|mode);
-	write4bits((lownib)|mode); 
+	uint8_t batch[LCD_BATCH_SIZE];
+	batch[0] = mode | _backlightval;
+	transmit(batch, 1 + encode(value, mode, batch + 1));
+}
+
+size_t LiquidCrystal_I2C::write(const uint8_t *buffer, size_t size) {
+	uint8_t batch[LCD_BATCH_SIZE];
+	// Worst case bytes for one character
+	size_t room = LCD_BATCH_SIZE - 4 - settleBytes();
+	size_t sent = 0;
+	while (sent < size) {
+		// Rs settles before the first enable pulse
+		batch[0] = Rs | _backlightval;
+		size_t length = 1;
+		while (sent < size && length <= room) {
+			length += encode(buffer[sent++], Rs, batch + length);
+		}
+		transmit(batch, length);
+	}
+	// What the display shows now, the cursor moves right to the end of the line
+	if (!tracksCursor()) {
+		_cursorKnown = false;
+		return size;
+	}
+	for (size_t i = 0; i < size && _cursorKnown; i++) {
+		if (_col >= _cols || _row >= _rows) {
+			_cursorKnown = false;
+		} else {
+			_shown[_row][_col] = _frame[_row][_col] = buffer[i];
+			_col++;
+		}
+	}
+	return size;
+}
+
+bool LiquidCrystal_I2C::tracksCursor() {
+	return _cursorKnown && (_displaymode & (LCD_ENTRYLEFT | LCD_ENTRYSHIFTINCREMENT)) == LCD_ENTRYLEFT;
+}
+
+// The expander latches each byte as the LCD acknowledges it, so En stays high
+// for a byte time on the bus and the settle time is counted in bytes too.
+// No delays needed, the data lines are ready before En falls.
+size_t LiquidCrystal_I2C::encode(uint8_t value, uint8_t mode, uint8_t *out) {
+	uint8_t high = (value & 0xf0) | mode | _backlightval;
+	uint8_t low = ((value << 4) & 0xf0) | mode | _backlightval;
+	size_t length = 0;
+	out[length++] = high | En;
+	out[length++] = high;
+	out[length++] = low | En;
+	out[length++] = low;
+	for (uint8_t i = settleBytes(); i > 0; i--) {
+		out[length++] = low;
+	}
+	return length;
+}
+
+void LiquidCrystal_I2C::transmit(const uint8_t *batch, size_t length) {
+	finishAsync();
+	if (_bus) _bus->acquire(I2CBus::kDisplay);
+	wire().beginTransmission(_Addr);
+	wire().write(batch, length);
+	wire().endTransmission();
+	if (_bus) _bus->release();
+	sent(1 + length);
+}
+
+void LiquidCrystal_I2C::sent(size_t bytes) {
+	_bytesSent += bytes;
+	if (_bus) _bus->transferred(I2CBus::kDisplay, bytes);
+}
+
+// Padding after a character so the next En falls LCD_SETTLE_US later, the
+// next character's first two bytes count. None at 400 kHz and below.
+uint8_t LiquidCrystal_I2C::settleBytes() {
+	uint32_t bytes = ((uint32_t)LCD_SETTLE_US * (wire().getClock() / 1000) + 8999) / 9000;
+	return bytes > 2 ? bytes - 2 : 0;
 }
 
 void LiquidCrystal_I2C::write4bits(uint8_t value) {
@@ -249,9 +454,13 @@ void LiquidCrystal_I2C::write4bits(uint8_t value) {
 }
 
 void LiquidCrystal_I2C::expanderWrite(uint8_t _data){                                        
-	Wire.beginTransmission(_Addr);
+	finishAsync();
+	if (_bus) _bus->acquire(I2CBus::kDisplay);
+	wire().beginTransmission(_Addr);
 	printIIC((int)(_data) | _backlightval);
-	Wire.endTransmission();   
+	wire().endTransmission();   
+	if (_bus) _bus->release();
+	sent(2);
 }
 
 void LiquidCrystal_I2C::pulseEnable(uint8_t _data){
@@ -299,6 +508,70 @@ void LiquidCrystal_I2C::printstr(const char c[]){
 	print(c);
 }
 
+// Glyphs of partly filled cells, the empty and full ones are in the ROM:
+// vertical 1 to 7 rows from the bottom, horizontal 1 to 4 columns from
+// the left, center adds 1 to 4 columns from the right
+uint8_t LiquidCrystal_I2C::init_bargraph(uint8_t graphtype){
+	uint8_t count;
+	switch (graphtype) {
+	case LCDI2C_VERTICAL_BAR_GRAPH: count = 7; break;
+	case LCDI2C_HORIZONTAL_BAR_GRAPH: count = 4; break;
+	case LCDI2C_CENTER_BAR_GRAPH: count = 8; break;
+	default: return 1;
+	}
+	if (graphtype == _graphtype) return 0;
+	uint8_t glyph[8];
+	for (uint8_t slot = 0; slot < count; slot++) {
+		for (uint8_t line = 0; line < 8; line++) {
+			if (graphtype == LCDI2C_VERTICAL_BAR_GRAPH) {
+				glyph[line] = line >= 7 - slot ? 0x1F : 0x00;
+			} else if (slot < 4) {
+				glyph[line] = (0x1F << (4 - slot)) & 0x1F;
+			} else {
+				glyph[line] = (1 << (slot - 3)) - 1;
+			}
+		}
+		createChar(slot, glyph);
+	}
+	_graphtype = graphtype;
+	return 0;
+}
+
+void LiquidCrystal_I2C::draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end){
+	if (_graphtype != LCDI2C_HORIZONTAL_BAR_GRAPH) return;
+	for (uint8_t i = 0; i < len; i++) {
+		graphCell(row, column + i, pixel_col_end - i * 5, 5, 0);
+	}
+}
+
+void LiquidCrystal_I2C::draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_row_end){
+	if (_graphtype != LCDI2C_VERTICAL_BAR_GRAPH) return;
+	for (uint8_t i = 0; i < len && i <= row; i++) {
+		graphCell(row - i, column, pixel_row_end - i * 8, 8, 0);
+	}
+}
+
+void LiquidCrystal_I2C::draw_center_graph(uint8_t row, uint8_t column, uint8_t len, int8_t pixels){
+	if (_graphtype != LCDI2C_CENTER_BAR_GRAPH) return;
+	uint8_t half = len / 2;
+	for (uint8_t i = 0; i < half; i++) {
+		graphCell(row, column + half + i, pixels - i * 5, 5, 0);
+		graphCell(row, column + half - 1 - i, -pixels - i * 5, 5, 4);
+	}
+}
+
+// Cell of a bar with `fill` of its `size` pixels on
+void LiquidCrystal_I2C::graphCell(uint8_t row, uint8_t col, int fill, uint8_t size, uint8_t firstGlyph){
+	if (row >= _rows || col >= _cols) return;
+	if (fill >= size) {
+		_frame[row][col] = LCD_FULL_BLOCK;
+	} else if (fill <= 0) {
+		_frame[row][col] = ' ';
+	} else {
+		_frame[row][col] = firstGlyph + fill - 1;
+	}
+}
+
 
 // unsupported API functions
 void LiquidCrystal_I2C::off(){}
@@ -306,9 +579,6 @@ void LiquidCrystal_I2C::on(){}
 void LiquidCrystal_I2C::setDelay (int cmdDelay,int charDelay) {}
 uint8_t LiquidCrystal_I2C::status(){return 0;}
 uint8_t LiquidCrystal_I2C::keypad (){return 0;}
-uint8_t LiquidCrystal_I2C::init_bargraph(uint8_t graphtype){return 0;}
-void LiquidCrystal_I2C::draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end){}
-void LiquidCrystal_I2C::draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_row_end){}
 void LiquidCrystal_I2C::setContrast(uint8_t new_val){}
 
 	
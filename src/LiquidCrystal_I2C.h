@@ -5,6 +5,7 @@
 #include <inttypes.h>
 #include "Print.h" 
 #include "i2c_t3.h"
+#include "Display.h"
 
 // commands
 #define LCD_CLEARDISPLAY 0x01
@@ -52,7 +53,20 @@
 #define Rw B00000010  // Read/Write bit
 #define Rs B00000001  // Register select bit
 
-class LiquidCrystal_I2C : public Print {
+// Expander bytes sent in one I2C transfer by the batched writes
+#define LCD_BATCH_SIZE 128
+// Time the controller needs after each character or command, in microseconds
+#define LCD_SETTLE_US 37
+// Largest display the shadow buffer covers
+#define LCD_MAX_COLS DISPLAY_MAX_COLS
+#define LCD_MAX_ROWS DISPLAY_MAX_ROWS
+// Characters per background transfer, bounds how long other devices wait
+#define LCD_ASYNC_CHARS 8
+
+// All pixels on, in the character ROM
+#define LCD_FULL_BLOCK 0xFF
+
+class LiquidCrystal_I2C : public Display {
 public:
   LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows);
   void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS );
@@ -83,8 +97,39 @@ public:
 #else
   virtual void write(uint8_t);
 #endif
+  // Whole strings, one I2C transfer for up to LCD_BATCH_SIZE expander bytes
+  virtual size_t write(const uint8_t *buffer, size_t size);
   void command(uint8_t);
   void init();
+  // Shared bus the display waits its turn on, plain Wire without one
+  void setBus(I2CBus *bus) { _bus = bus; }
+
+  // Shadow framebuffer: setText() changes the wanted text, refresh() sends
+  // only the cells that differ from what the display shows. Direct prints
+  // keep the shadow in step too.
+  void setText(uint8_t col, uint8_t row, const char *text, uint8_t length);
+  // Returns the I2C bytes sent
+  uint16_t refresh();
+  // Non-blocking refresh for the main loop: starts at most one background
+  // transfer of changed cells and returns. Cells changed again before they
+  // go out are sent once, with the newest text. True when up to date.
+  bool update();
+  uint8_t columns() { return _cols; }
+  uint8_t rows() { return _rows; }
+  // I2C bytes sent since power on, address bytes included
+  uint32_t bytesSent() { return _bytesSent; }
+
+  // Bar graphs draw in the shadow framebuffer like setText(), only the
+  // cells whose level changed go out. Each type loads its own glyphs in
+  // CGRAM, one type at a time.
+  uint8_t init_bargraph(uint8_t graphtype);
+  // Fills `len` cells from `column` with `pixel_col_end` pixel columns
+  void draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end);
+  // Fills `len` cells up from `row` with `pixel_row_end` pixel rows
+  void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_row_end);
+  // Fills `pixels` pixel columns from the middle of `len` cells, to the
+  // right when positive and to the left when negative
+  void draw_center_graph(uint8_t row, uint8_t column, uint8_t len, int8_t pixels);
 
 ////compatibility API function aliases
 void blink_on();						// alias for blink()
@@ -102,9 +147,6 @@ uint8_t keypad();
 void setDelay(int,int);
 void on();
 void off();
-uint8_t init_bargraph(uint8_t graphtype);
-void draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end);
-void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end);
 	 
 
 private:
@@ -113,6 +155,16 @@ private:
   void write4bits(uint8_t);
   void expanderWrite(uint8_t);
   void pulseEnable(uint8_t);
+  size_t encode(uint8_t value, uint8_t mode, uint8_t *out);
+  void transmit(const uint8_t *batch, size_t length);
+  uint8_t settleBytes();
+  bool tracksCursor();
+  bool nextRun(uint8_t &row, uint8_t &col, uint8_t &length);
+  void finishAsync();
+  void sent(size_t bytes);
+  static void asyncDone(void *context, bool ok);
+  void graphCell(uint8_t row, uint8_t col, int fill, uint8_t size, uint8_t firstGlyph);
+  i2c_t3 &wire() { return _bus ? _bus->wire() : Wire; }
   uint8_t _Addr;
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
@@ -121,6 +173,22 @@ private:
   uint8_t _cols;
   uint8_t _rows;
   uint8_t _backlightval;
+  // Text on the display and text wanted, with the cursor when known
+  uint8_t _shown[LCD_MAX_ROWS][LCD_MAX_COLS];
+  uint8_t _frame[LCD_MAX_ROWS][LCD_MAX_COLS];
+  uint8_t _col;
+  uint8_t _row;
+  bool _cursorKnown;
+  // Cells of the background transfer, shown once it succeeds
+  uint8_t _pending[LCD_ASYNC_CHARS];
+  uint8_t _pendingRow;
+  uint8_t _pendingCol;
+  uint8_t _pendingLength;
+  volatile bool _pendingDone;
+  volatile bool _pendingOk;
+  uint32_t _bytesSent;
+  uint8_t _graphtype;
+  I2CBus *_bus;
 };
 
 #endif
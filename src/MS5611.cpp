@@ -13,6 +13,14 @@ by Petr Gronat@2014
 #define PROM_REG_SIZE           0x02
 #define NBYTES_CONV             3
 #define NBYTES_PROM             2
+// Timer period, one conversion read and the next started per tick
+#define CONV_TIME_US            ((1+2*OSR)*1000)
+// Bus bytes of the slot after a conversion: ADC read command, 3 byte read
+// and the next conversion command, with the address bytes
+#define SLOT_BYTES              8
+// Sensor range [Pa], anything outside is a bad read
+#define P_MIN                   1000
+#define P_MAX                   120000
 
 // Temperature sampling period threshold [milliseconds]
 // Kindly read the comment bellow in getPressure() method
@@ -27,38 +35,168 @@ TODO:
 */
 
 #include "MS5611.h"
+
+MS5611* MS5611::s_sampler = NULL;
+
 MS5611::MS5611(){
     m_T      = 0;
     m_P      = 0;
+    m_errors = 0;
     m_lastTime   = T_THR;
+    m_bus    = NULL;
+    m_converting = kNone;
+    m_next   = kTemperature;
+    m_step   = kReadCommand;
+    m_sampleReady = false;
+    m_chainActive = false;
     for(uint8_t k=0; k<N_PROM_PARAMS; k++)
         m_C[k]=69;
 }
 
-void MS5611::begin(){
-    Wire.begin();
+void MS5611::begin(I2CBus &bus){
+    m_bus = &bus;
     reset();
     delay(100);
     readCalibration();
 }
 
 int32_t MS5611::getPressure(){
-    getTemperature();       //updates temperature m_dT and m_T
-    uint32_t D1 = getRawPressure();
+    if (getTemperature() == MS5611_ERROR)   //updates temperature m_dT and m_T
+        return MS5611_ERROR;
+    return compensate(getRawPressure());
+}
+
+void MS5611::startSampling(){
+    s_sampler = this;
+    m_timer.begin(tick, CONV_TIME_US);
+}
+
+bool MS5611::update(){
+    if (!m_sampleReady)
+        return false;
+    m_sampleReady = false;
+    return true;
+}
+
+// Timer interrupt: the conversion started last tick is ready. The bus is
+// reserved for the next tick, the display keeps out of it
+void MS5611::tick(){
+    MS5611* baro = s_sampler;
+    if (baro->m_chainActive) {
+        // A whole period and the last slot has not ended, a transfer hung
+        baro->m_bus->abort(I2CBus::kBaro);
+        if (baro->m_chainActive)
+            baro->endChain(false);
+    }
+    baro->m_bus->reserve(I2CBus::kBaro, micros() + CONV_TIME_US,
+        baro->m_bus->transferMicros(SLOT_BYTES));
+    baro->m_bus->acquireAsync(I2CBus::kBaro, start, baro);
+}
+
+// Holding the bus, from the timer or when the display releases it
+void MS5611::start(void* context, bool ok){
+    MS5611* baro = (MS5611*)context;
+    baro->m_chainActive = true;
+    if (baro->m_converting == kNone) {
+        // After a failure nothing to read, only a conversion to start
+        baro->m_next = kTemperature;
+        baro->m_step = kConvertCommand;
+        baro->sendAsync(CMD_CONV_D2_BASE+OSR*CONV_REG_SIZE);
+    } else {
+        baro->m_step = kReadCommand;
+        baro->sendAsync(CMD_ADC_READ);
+    }
+}
+
+// Bus interrupt: each transfer of the slot starts the next one
+void MS5611::step(void* context, bool ok){
+    MS5611* baro = (MS5611*)context;
+    i2c_t3& wire = baro->m_bus->wire();
+    switch (baro->m_step) {
+        case kReadCommand:
+            if (!ok) return baro->endChain(false);
+            baro->m_step = kRead;
+            baro->m_bus->requestAsync(ADD_MS5611, NBYTES_CONV, step, baro);
+            break;
+        case kRead: {
+            baro->m_bus->transferred(I2CBus::kBaro, 1 + NBYTES_CONV);
+            if (!ok || wire.available() != NBYTES_CONV) return baro->endChain(false);
+            uint32_t data = 0;
+            for (int8_t k=NBYTES_CONV-1; k>=0; k--)
+                data |= ( (uint32_t) wire.read() << (8*k) );
+            if (baro->m_converting == kTemperature) {
+                // A pressure needs a good temperature, start over without one
+                if (!baro->compensateTemperature(data)) return baro->endChain(false);
+                baro->m_next = kPressure;
+            } else {
+                if (baro->compensate(data) != MS5611_ERROR)
+                    baro->m_sampleReady = true;
+                baro->m_next = kTemperature;
+            }
+            baro->m_step = kConvertCommand;
+            baro->sendAsync(baro->m_next == kPressure ?
+                CMD_CONV_D1_BASE+OSR*CONV_REG_SIZE : CMD_CONV_D2_BASE+OSR*CONV_REG_SIZE);
+            break;
+        }
+        case kConvertCommand:
+            baro->endChain(ok);
+            break;
+    }
+}
 
+void MS5611::sendAsync(uint8_t cmd){
+    i2c_t3& wire = m_bus->wire();
+    wire.beginTransmission(ADD_MS5611);
+    wire.write(cmd);
+    m_bus->transferred(I2CBus::kBaro, 2);
+    m_bus->sendAsync(step, this);
+}
+
+// Without a conversion running, the next tick starts one
+void MS5611::endChain(bool ok){
+    if (!ok) m_errors++;
+    m_converting = ok ? m_next : kNone;
+    m_chainActive = false;
+    m_bus->release();
+}
+
+// Updates m_dT and m_T, false for a failed read
+bool MS5611::compensateTemperature(uint32_t D2){
+    if (D2 == 0)
+        return false;
+    m_dT = D2-((uint32_t)m_C[5-1] * 256);
+    // Below, 'dT' and '_C[6-1]'' must be casted in order to prevent overflow
+    // A bitwise division can not be dobe since it is unpredictible for signed integers
+    m_T = 2000 + ((int64_t)m_dT * m_C[6-1])/8388608;
+    return true;
+}
+
+// Updates m_P, MS5611_ERROR for a failed read or a pressure out of range
+int32_t MS5611::compensate(uint32_t D1){
+    if (D1 == 0) {
+        m_errors++;
+        return MS5611_ERROR;
+    }
     int64_t OFF  = (int64_t)m_C[2-1]*65536
                  + (int64_t)m_C[4-1]*m_dT/128;
 
     int64_t SENS = (int64_t)m_C[1-1]*32768
                  + (int64_t)m_C[3-1]*m_dT/256;
-    m_P = (D1*SENS/2097152 - OFF)/32768;
+    int32_t P = (D1*SENS/2097152 - OFF)/32768;
+    if (P < P_MIN || P > P_MAX) {
+        m_errors++;
+        return MS5611_ERROR;
+    }
+    m_P = P;
     return m_P;
 }
 
 uint32_t MS5611::getRawPressure(){
-    sendCommand(CMD_CONV_D1_BASE+OSR*CONV_REG_SIZE);    //read sensor, prepare a data
+    if (!sendCommand(CMD_CONV_D1_BASE+OSR*CONV_REG_SIZE))  //read sensor, prepare a data
+        return 0;
     delay(1+2*OSR);                                     //wait at least 8.33us for full oversampling
-    sendCommand(CMD_ADC_READ);                          //get ready for reading the data
+    if (!sendCommand(CMD_ADC_READ))                     //get ready for reading the data
+        return 0;
     return readnBytes(NBYTES_CONV);                     //reading the data
 }
 
@@ -70,19 +208,19 @@ int32_t MS5611::getTemperature(){
     //  return m_T;
     //_lastTime = millis();
     //****************
-    uint32_t D2;
-    D2  = getRawTemperature();
-    m_dT = D2-((uint32_t)m_C[5-1] * 256);         //update '_dT'
-    // Below, 'dT' and '_C[6-1]'' must be casted in order to prevent overflow
-    // A bitwise division can not be dobe since it is unpredictible for signed integers
-    m_T = 2000 + ((int64_t)m_dT * m_C[6-1])/8388608;
+    if (!compensateTemperature(getRawTemperature())) {
+        m_errors++;
+        return MS5611_ERROR;
+    }
     return m_T;
 }
 
 uint32_t MS5611::getRawTemperature(){
-    sendCommand(CMD_CONV_D2_BASE+OSR*CONV_REG_SIZE);        //read sensor, prepare a data
+    if (!sendCommand(CMD_CONV_D2_BASE+OSR*CONV_REG_SIZE))   //read sensor, prepare a data
+        return 0;
     delay(1+2*OSR);                                         //wait at least 8.33us
-    sendCommand(CMD_ADC_READ);                              //get ready for reading the data
+    if (!sendCommand(CMD_ADC_READ))                         //get ready for reading the data
+        return 0;
     return readnBytes(NBYTES_CONV);                         //reading the data
 }
 
@@ -99,31 +237,34 @@ void MS5611::getCalibration(uint16_t *C){
     return;
 }
 
-void MS5611::sendCommand(uint8_t cmd){
-    Wire.beginTransmission(ADD_MS5611);
-    Wire.write(cmd);
-    Wire.endTransmission();
+bool MS5611::sendCommand(uint8_t cmd){
+    i2c_t3& wire = m_bus->wire();
+    m_bus->acquire(I2CBus::kBaro);                      //waits out a display transfer, if any
+    wire.beginTransmission(ADD_MS5611);
+    wire.write(cmd);
+    bool sent = wire.endTransmission() == 0;            //NAK, timeout or lost arbitration
+    m_bus->release();
+    m_bus->transferred(I2CBus::kBaro, 2);
+    return sent;
 }
 
 uint32_t MS5611::readnBytes(uint8_t nBytes){
     if (0<nBytes & nBytes<5){
-        Wire.beginTransmission(ADD_MS5611);
-        Wire.requestFrom((uint8_t)ADD_MS5611, nBytes);
-            uint32_t data = 0;
-            if(Wire.available()!=nBytes){
-                Wire.endTransmission();
-                return 0.0;
-            }
+        i2c_t3& wire = m_bus->wire();
+        m_bus->acquire(I2CBus::kBaro);
+        wire.requestFrom((uint8_t)ADD_MS5611, nBytes);  //a read on its own, no write before
+        m_bus->transferred(I2CBus::kBaro, 1 + nBytes);
+        uint32_t data = 0;
+        if(wire.available()==nBytes){
             for (int8_t k=nBytes-1; k>=0; k--)
-                data |= ( (uint32_t) Wire.read() << (8*k) );    // concantenate bytes
-        Wire.endTransmission();
+                data |= ( (uint32_t) wire.read() << (8*k) );    // concantenate bytes
+        }
+        m_bus->release();
         return data;
     }                                               // too many bytes or
-    return 0.0;                                    // no byte required
+    return 0;                                      // no byte required
 }
 
 void MS5611::reset(){
-    Wire.beginTransmission(ADD_MS5611);
-    Wire.write(CMD_RESET);
-    Wire.endTransmission();
+    sendCommand(CMD_RESET);
 }
@@ -10,7 +10,9 @@ by Petr Gronat@2014
 
 // Include Arduino libraries
 #include <Arduino.h>
+#include <IntervalTimer.h>
 #include "i2c_t3.h"
+#include "I2CBus.h"
 
 #define N_PROM_PARAMS 6
 
@@ -18,22 +20,63 @@ by Petr Gronat@2014
 // address of the device MS5611
 #define ADD_MS5611 0x77 	// can be 0x76 if CSB pin is connected to GND
 
+// Returned by getTemperature() and getPressure() for a failed sample
+#define MS5611_ERROR INT32_MIN
+
 class MS5611{
 	public:
 		MS5611();		//constructor
-			void 		begin();
+			void 		begin(I2CBus &bus);
+			// Samples from a timer from now on, the blocking reads below
+			// are for before
+			void 		startSampling();
+			// True when the timer sampled a new pressure
+			bool 		update();
+			int32_t 	pressure() const { return m_P; }
+			// Samples dropped: failed or hung transfers, unfinished conversions and
+			// pressures out of the sensor range
+			uint32_t 	errors() const { return m_errors; }
 			uint32_t 	getRawTemperature();
 			int32_t 	getTemperature();
 			uint32_t 	getRawPressure();
 			int32_t 	getPressure();
 			void 		readCalibration();
 			void 		getCalibration(uint16_t *);
-			void 		sendCommand(uint8_t);
+			bool 		sendCommand(uint8_t);
+			// 0 on a failed read, never the value of a finished conversion
 			uint32_t 	readnBytes(uint8_t);
 	private:
 			void 		reset();
+			bool 		compensateTemperature(uint32_t);
+			int32_t 	compensate(uint32_t);
+			static void tick();
+			static void start(void*, bool);
+			static void step(void*, bool);
+			void 		sendAsync(uint8_t);
+			void 		endChain(bool);
+		enum Conversion {
+			kNone,
+			kTemperature,
+			kPressure
+		};
+		// Transfers of a slot: read command, read, next conversion
+		enum Step {
+			kReadCommand,
+			kRead,
+			kConvertCommand
+		};
+		static MS5611* s_sampler;
+		I2CBus* 	m_bus;
+		IntervalTimer m_timer;
+		volatile Conversion m_converting;
+		Conversion 	m_next;
+		volatile Step m_step;
+		volatile bool m_sampleReady;
+		// Holding the bus for a slot's transfers
+		volatile bool m_chainActive;
 		//variables
-		int32_t 	m_P;
+		volatile int32_t m_P;
+		volatile uint32_t m_errors;
 		int32_t  	m_T;
 		int32_t 	m_dT;
 		uint16_t 	m_C[N_PROM_PARAMS];
@@ -0,0 +1,310 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#include "OledDisplay.h"
+
+// Control bytes: the rest are commands, one command follows, pixels follow
+#define OLED_COMMANDS 0x00
+#define OLED_COMMAND 0x80
+#define OLED_DATA 0x40
+
+// Page addressing, column 0 on the left and row 0 at the top
+static const uint8_t kSSD1306Init[] = {
+	0xAE,		// off
+	0xD5, 0x80,	// clock
+	0xA8, 0x3F,	// 64 rows
+	0xD3, 0x00,	// no offset
+	0x40,		// start line 0
+	0x8D, 0x14,	// charge pump on
+	0x20, 0x02,	// page addressing
+	0xA1,		// columns right to left
+	0xC8,		// rows bottom to top
+	0xDA, 0x12,	// alternative rows
+	0x81, 0xCF,	// contrast
+	0xD9, 0xF1,	// precharge
+	0xDB, 0x40,	// Vcomh
+	0xA4,		// show the RAM
+	0xA6,		// not inverted
+	0xAF		// on
+};
+
+// The SH1106 only has page addressing, its pump is on by default
+static const uint8_t kSH1106Init[] = {
+	0xAE,
+	0xD5, 0x80,
+	0xA8, 0x3F,
+	0xD3, 0x00,
+	0x40,
+	0xAD, 0x8B,	// DC-DC on
+	0xA1,
+	0xC8,
+	0xDA, 0x12,
+	0x81, 0xCF,
+	0xD9, 0x22,
+	0xDB, 0x40,
+	0xA4,
+	0xA6,
+	0xAF
+};
+
+OledDisplay::OledDisplay(uint8_t address, uint8_t cols, uint8_t rows, Controller controller)
+{
+	m_address = address;
+	m_controller = controller;
+	m_frame.setGrid(min(cols, (uint8_t)DISPLAY_MAX_COLS), min(rows, (uint8_t)DISPLAY_MAX_ROWS));
+	memset(m_text, ' ', sizeof(m_text));
+}
+
+void OledDisplay::begin(uint8_t cols, uint8_t rows, uint8_t charsize)
+{
+	m_frame.setGrid(min(cols, (uint8_t)DISPLAY_MAX_COLS), min(rows, (uint8_t)DISPLAY_MAX_ROWS));
+	if (m_controller == kSH1106) {
+		command(kSH1106Init, sizeof(kSH1106Init));
+	} else {
+		command(kSSD1306Init, sizeof(kSSD1306Init));
+	}
+	clear();
+	refresh();
+}
+
+void OledDisplay::clear()
+{
+	m_frame.clear();
+	memset(m_text, ' ', sizeof(m_text));
+	m_col = 0;
+	m_row = 0;
+}
+
+void OledDisplay::backlight()
+{
+	static const uint8_t on[] = { 0xAF };
+	command(on, sizeof(on));
+}
+
+void OledDisplay::setCursor(uint8_t col, uint8_t row)
+{
+	m_col = col;
+	m_row = row;
+}
+
+size_t OledDisplay::write(uint8_t value)
+{
+	return write(&value, 1);
+}
+
+size_t OledDisplay::write(const uint8_t* buffer, size_t size)
+{
+	drawText(m_col, m_row, buffer, size);
+	m_col += size;
+	refresh();
+	return size;
+}
+
+void OledDisplay::setText(uint8_t col, uint8_t row, const char* text, uint8_t length)
+{
+	drawText(col, row, (const uint8_t*)text, length);
+}
+
+void OledDisplay::drawText(uint8_t col, uint8_t row, const uint8_t* text, size_t length)
+{
+	if (row >= m_frame.rows()) return;
+	for (size_t i = 0; i < length && col + i < m_frame.columns(); i++) {
+		// Same character, same pixels
+		if (m_text[row][col + i] == text[i]) continue;
+		m_text[row][col + i] = text[i];
+		m_frame.drawChar(col + i, row, text[i]);
+	}
+}
+
+// The cells hold a bar now, any text drawn over them is new
+void OledDisplay::forgetText(uint8_t col, uint8_t row, uint8_t length)
+{
+	if (row >= m_frame.rows()) return;
+	for (uint8_t i = 0; i < length && col + i < m_frame.columns(); i++) {
+		m_text[row][col + i] = 0;
+	}
+}
+
+uint16_t OledDisplay::refresh()
+{
+	uint32_t start = m_bytesSent;
+	finishAsync();
+	uint8_t batch[OLED_PAGE_HEADER + OLED_WIDTH];
+	for (uint8_t page = 0; page < OLED_PAGES; page++) {
+		if (!(m_frame.dirtyPages() & (1 << page))) continue;
+		size_t size = encodePage(page, batch);
+		if (m_bus) m_bus->acquire(I2CBus::kDisplay);
+		wire().beginTransmission(m_address);
+		wire().write(batch, size);
+		if (wire().endTransmission() == 0) m_frame.markClean(page);
+		if (m_bus) m_bus->release();
+		sent(1 + size);
+	}
+	return m_bytesSent - start;
+}
+
+bool OledDisplay::update()
+{
+	if (m_pendingPage >= 0) {
+		if (m_bus ? !m_pendingDone : !wire().done()) return false;
+		finishAsync();
+	}
+	uint8_t dirty = m_frame.dirtyPages();
+	if (!dirty) return true;
+	uint8_t page = 0;
+	while (!(dirty & (1 << page))) page++;
+
+	uint8_t batch[OLED_PAGE_HEADER + OLED_WIDTH];
+	size_t size = encodePage(page, batch);
+	// Only in the gaps between barometer transfers
+	if (m_bus && !m_bus->tryStart(I2CBus::kDisplay, 1 + size)) return false;
+	// Drawing from here on marks the page again
+	m_frame.markClean(page);
+	m_pendingPage = page;
+
+	wire().beginTransmission(m_address);
+	wire().write(batch, size);
+	if (m_bus) {
+		m_pendingDone = false;
+		m_bus->sendAsync(asyncDone, this);
+	} else {
+		wire().sendTransmission();
+	}
+	sent(1 + size);
+	return false;
+}
+
+// Page address and the page's 128 columns, one transfer
+size_t OledDisplay::encodePage(uint8_t page, uint8_t* out)
+{
+	uint8_t column = m_controller == kSH1106 ? SH1106_COLUMN_OFFSET : 0;
+	size_t size = 0;
+	out[size++] = OLED_COMMAND;
+	out[size++] = 0xB0 | page;
+	out[size++] = OLED_COMMAND;
+	out[size++] = column & 0x0F;
+	out[size++] = OLED_COMMAND;
+	out[size++] = 0x10 | (column >> 4);
+	out[size++] = OLED_DATA;
+	memcpy(out + size, m_frame.page(page), OLED_WIDTH);
+	return size + OLED_WIDTH;
+}
+
+void OledDisplay::command(const uint8_t* commands, size_t length)
+{
+	finishAsync();
+	if (m_bus) m_bus->acquire(I2CBus::kDisplay);
+	wire().beginTransmission(m_address);
+	wire().write((uint8_t)OLED_COMMANDS);
+	wire().write(commands, length);
+	wire().endTransmission();
+	if (m_bus) m_bus->release();
+	sent(2 + length);
+}
+
+// Waits for the background transfer, if any
+void OledDisplay::finishAsync()
+{
+	if (m_pendingPage < 0) return;
+	uint8_t page = m_pendingPage;
+	m_pendingPage = -1;
+	bool ok;
+	if (m_bus) {
+		while (!m_pendingDone) {}
+		ok = m_pendingOk;
+	} else {
+		ok = wire().finish();
+	}
+	// Unknown what the display got, the page goes again
+	if (!ok) m_frame.markDirty(page);
+}
+
+// Bus interrupt, the background transfer ended
+void OledDisplay::asyncDone(void* context, bool ok)
+{
+	OledDisplay* oled = (OledDisplay*)context;
+	oled->m_pendingOk = ok;
+	oled->m_pendingDone = true;
+	oled->m_bus->release();
+}
+
+void OledDisplay::sent(size_t bytes)
+{
+	m_bytesSent += bytes;
+	if (m_bus) m_bus->transferred(I2CBus::kDisplay, bytes);
+}
+
+uint8_t OledDisplay::init_bargraph(uint8_t graphtype)
+{
+	switch (graphtype) {
+		case LCDI2C_VERTICAL_BAR_GRAPH:
+		case LCDI2C_HORIZONTAL_BAR_GRAPH:
+		case LCDI2C_CENTER_BAR_GRAPH:
+			m_graphtype = graphtype;
+			return 0;
+		default:
+			return 1;
+	}
+}
+
+// Bars are drawn a pixel at a time, each to its final state, so an
+// unchanged bar marks no page
+void OledDisplay::draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_col_end)
+{
+	if (m_graphtype != LCDI2C_HORIZONTAL_BAR_GRAPH || row >= m_frame.rows()) return;
+	int width = m_frame.cellWidth();
+	int height = m_frame.cellHeight();
+	int x0 = column * width;
+	int top = row * height;
+	int fill = pixel_col_end * width / 5;
+	// A pixel clear above and below, the cells' text goes
+	for (int x = 0; x < len * width; x++) {
+		for (int y = 0; y < height; y++) {
+			m_frame.fillRect(x0 + x, top + y, 1, 1, x < fill && y > 0 && y < height - 1);
+		}
+	}
+	forgetText(column, row, len);
+}
+
+void OledDisplay::draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_row_end)
+{
+	if (m_graphtype != LCDI2C_VERTICAL_BAR_GRAPH || row >= m_frame.rows()) return;
+	int width = m_frame.cellWidth();
+	int height = m_frame.cellHeight();
+	len = min(len, (uint8_t)(row + 1));
+	int bottom = (row + 1) * height;
+	int fill = pixel_row_end * height / 8;
+	// A pixel clear either side
+	for (int y = 1; y <= len * height; y++) {
+		for (int x = 0; x < width; x++) {
+			m_frame.fillRect(column * width + x, bottom - y, 1, 1, y <= fill && x > 0 && x < width - 1);
+		}
+	}
+	for (uint8_t i = 0; i < len; i++) {
+		forgetText(column, row - i, 1);
+	}
+}
+
+void OledDisplay::draw_center_graph(uint8_t row, uint8_t column, uint8_t len, int8_t pixels)
+{
+	if (m_graphtype != LCDI2C_CENTER_BAR_GRAPH || row >= m_frame.rows()) return;
+	int width = m_frame.cellWidth();
+	int height = m_frame.cellHeight();
+	int x0 = column * width;
+	int mid = x0 + len / 2 * width;
+	int fill = pixels * width / 5;
+	int top = row * height;
+	// Half a cell high, with a tick across the cell at zero
+	int barTop = top + height / 4;
+	int barHeight = max(height / 2, 1);
+	for (int x = x0; x < x0 + len / 2 * 2 * width; x++) {
+		bool on = fill > 0 ? x >= mid && x < mid + fill : x < mid && x >= mid + fill;
+		for (int y = top; y < top + height; y++) {
+			bool bar = on && y >= barTop && y < barTop + barHeight;
+			m_frame.fillRect(x, y, 1, 1, x == mid || bar);
+		}
+	}
+	forgetText(column, row, len);
+}
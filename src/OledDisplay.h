@@ -0,0 +1,99 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef OledDisplay_h
+#define OledDisplay_h
+
+#include <Arduino.h>
+#include "i2c_t3.h"
+#include "Display.h"
+#include "OledFrame.h"
+
+#define OLED_ADDRESS 0x3C
+// The SH1106 has 132 columns of RAM, the panel shows them from the third
+#define SH1106_COLUMN_OFFSET 2
+// Page address commands and the data control byte before the pixels
+#define OLED_PAGE_HEADER 7
+
+/**
+ * 128x64 SSD1306 or SH1106 OLED on I2C, drop-in for LiquidCrystal_I2C.
+ *
+ * Text and bars are drawn in an OledFrame and only its dirty pages go out,
+ * a page of 128 bytes per transfer. update() sends one page in the
+ * background when it fits between the barometer's slots; with the bus in
+ * DMA mode i2c_t3 moves the page by DMA.
+ */
+class OledDisplay : public Display
+{
+public:
+	enum Controller {
+		kSSD1306 = 0,
+		kSH1106
+	};
+
+	OledDisplay(uint8_t address, uint8_t cols, uint8_t rows, Controller controller = kSSD1306);
+	virtual void begin(uint8_t cols, uint8_t rows, uint8_t charsize = 0);
+	// Sent by the next refresh() or update()
+	virtual void clear();
+	// No backlight, turns the panel on
+	virtual void backlight();
+	virtual void setCursor(uint8_t col, uint8_t row);
+	virtual void setBus(I2CBus* bus) {
+		m_bus = bus;
+	}
+	virtual size_t write(uint8_t value);
+	virtual size_t write(const uint8_t* buffer, size_t size);
+	using Print::write;
+
+	virtual void setText(uint8_t col, uint8_t row, const char* text, uint8_t length);
+	virtual uint16_t refresh();
+	virtual bool update();
+	virtual uint8_t columns() {
+		return m_frame.columns();
+	}
+	virtual uint8_t rows() {
+		return m_frame.rows();
+	}
+	virtual uint32_t bytesSent() {
+		return m_bytesSent;
+	}
+
+	virtual uint8_t init_bargraph(uint8_t graphtype);
+	virtual void draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_col_end);
+	virtual void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_row_end);
+	virtual void draw_center_graph(uint8_t row, uint8_t column, uint8_t len, int8_t pixels);
+
+	const OledFrame& frame() const {
+		return m_frame;
+	}
+private:
+	void drawText(uint8_t col, uint8_t row, const uint8_t* text, size_t length);
+	void forgetText(uint8_t col, uint8_t row, uint8_t length);
+	void command(const uint8_t* commands, size_t length);
+	size_t encodePage(uint8_t page, uint8_t* out);
+	void finishAsync();
+	void sent(size_t bytes);
+	static void asyncDone(void* context, bool ok);
+	i2c_t3& wire() {
+		return m_bus ? m_bus->wire() : Wire;
+	}
+
+	OledFrame m_frame;
+	uint8_t m_address;
+	Controller m_controller;
+	// Characters in the frame, 0 where a bar was drawn over them
+	uint8_t m_text[DISPLAY_MAX_ROWS][DISPLAY_MAX_COLS];
+	uint8_t m_col { 0 };
+	uint8_t m_row { 0 };
+	uint8_t m_graphtype { 0 };
+	// Page of the background transfer, dirty again if it fails
+	int8_t m_pendingPage { -1 };
+	volatile bool m_pendingDone { false };
+	volatile bool m_pendingOk { false };
+	uint32_t m_bytesSent { 0 };
+	I2CBus* m_bus { NULL };
+};
+
+#endif
@@ -0,0 +1,85 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ */
+
+#ifndef OledFrame_h
+#define OledFrame_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define OLED_WIDTH 128
+#define OLED_HEIGHT 64
+// Eight pixel rows a page, one byte a column, the controller's RAM layout
+#define OLED_PAGES (OLED_HEIGHT / 8)
+// 5x7 font in 6x8 pixels with the spacing
+#define OLED_GLYPH_WIDTH 6
+#define OLED_GLYPH_HEIGHT 8
+
+/**
+ * Framebuffer of a 128x64 SSD1306 or SH1106, laid out like their RAM so a
+ * page goes to the controller as it is.
+ *
+ * Text is drawn in a grid of character cells, the font scaled up to fill
+ * them. Every change that turns a pixel on or off marks its page dirty,
+ * redrawing the same text or bar marks nothing. No Arduino code, the host
+ * tools draw screens with it too.
+ */
+class OledFrame
+{
+public:
+	OledFrame() {
+		setGrid(OLED_WIDTH / OLED_GLYPH_WIDTH, OLED_PAGES);
+		clear();
+	}
+	// Cells as large as the screen allows, the font scaled by whole steps
+	void setGrid(uint8_t cols, uint8_t rows);
+	uint8_t columns() const {
+		return m_cols;
+	}
+	uint8_t rows() const {
+		return m_rows;
+	}
+	uint8_t cellWidth() const {
+		return m_cellWidth;
+	}
+	uint8_t cellHeight() const {
+		return m_cellHeight;
+	}
+
+	// All pixels off, every page dirty
+	void clear();
+	// Printable ASCII, anything else is blank
+	void drawChar(uint8_t col, uint8_t row, uint8_t c);
+	void fillRect(int x, int y, int width, int height, bool on);
+	bool pixel(int x, int y) const;
+
+	// Bit n for page n
+	uint8_t dirtyPages() const {
+		return m_dirty;
+	}
+	void markClean(uint8_t page) {
+		m_dirty &= ~(1 << page);
+	}
+	void markDirty(uint8_t page) {
+		m_dirty |= 1 << page;
+	}
+	const uint8_t* page(uint8_t page) const {
+		return m_buffer[page];
+	}
+private:
+	void setPixel(int x, int y, bool on);
+
+	uint8_t m_buffer[OLED_PAGES][OLED_WIDTH];
+	uint8_t m_dirty { 0 };
+	uint8_t m_cols { 0 };
+	uint8_t m_rows { 0 };
+	uint8_t m_cellWidth { 0 };
+	uint8_t m_cellHeight { 0 };
+	uint8_t m_scaleX { 1 };
+	uint8_t m_scaleY { 1 };
+};
+
+#endif
@@ -24,10 +24,12 @@
 #ifndef BlockDriver_h
 #define BlockDriver_h
 #include "FatLib/BaseBlockDriver.h"
+#if ENABLE_ARDUINO_FEATURES
 #include "SdCard/SdSpiCard.h"
+#endif  // ENABLE_ARDUINO_FEATURES
 //-----------------------------------------------------------------------------
-/** typedef for BlockDriver */
-#if ENABLE_EXTENDED_TRANSFER_CLASS || ENABLE_SDIO_CLASS
+/** typedef for BlockDriver, host builds have no SD card driver */
+#if ENABLE_EXTENDED_TRANSFER_CLASS || ENABLE_SDIO_CLASS || !ENABLE_ARDUINO_FEATURES
 typedef BaseBlockDriver BlockDriver;
 #else  // ENABLE_EXTENDED_TRANSFER_CLASS || ENABLE_SDIO_CLASS
 typedef SdSpiCard BlockDriver;
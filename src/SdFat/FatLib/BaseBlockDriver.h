@@ -49,6 +49,32 @@ class BaseBlockDriver {
    * the value false is returned for failure.
    */    
   virtual bool writeBlock(uint32_t block, const uint8_t* src) = 0;
+  /**
+   * Start writing a 512 byte block.  Drivers without asynchronous writes
+   * write the block before returning.
+   *
+   * \param[in] block Logical block to be written.
+   * \param[in] src Data, left untouched until writeBlockBusy() is false.
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  virtual bool writeBlockStart(uint32_t block, const uint8_t* src) {
+    return writeBlock(block, src);
+  }
+  /** \return true while the data of writeBlockStart() is being sent. */
+  virtual bool writeBlockBusy() {
+    return false;
+  }
+  /** Wait for the data of writeBlockStart() to be sent.
+   * \return The value true is returned if the card accepted the block.
+   */
+  virtual bool writeBlockFinish() {
+    return true;
+  }
+  /** \return true while the card is programming a written block. */
+  virtual bool isBusy() {
+    return false;
+  }
 #if USE_MULTI_BLOCK_IO
   /**
    * Read multiple 512 byte blocks from an SD card.
@@ -31,6 +31,72 @@ bool FatFile::addCluster() {
   return m_vol->allocateCluster(m_curCluster, &m_curCluster);
 }
 //------------------------------------------------------------------------------
+// Move m_curCluster to the next cluster of the chain, the one at cluster
+// index index in the file.  Returns 1, 0 at end of chain or -1 for error.
+int8_t FatFile::nextCluster(uint32_t index) {
+  uint32_t next;
+  int8_t fg;
+#if FILE_EXTENT_CACHE_SIZE
+  if (extentFind(index, &next) == index) {
+    m_curCluster = next;
+    return 1;
+  }
+#endif  // FILE_EXTENT_CACHE_SIZE
+  fg = m_vol->fatGet(m_curCluster, &next);
+  if (fg == 1) {
+    m_curCluster = next;
+    extentPut(index, next);
+  }
+  return fg;
+}
+#if FILE_EXTENT_CACHE_SIZE
+//------------------------------------------------------------------------------
+// Nearest known cluster at or before cluster index index in the file.
+// Returns its index, zero and the first cluster if none is known.
+uint32_t FatFile::extentFind(uint32_t index, uint32_t* cluster) {
+  uint32_t found = 0;
+  *cluster = isRoot32() ? m_vol->rootDirStart() : m_firstCluster;
+  for (uint8_t i = 0; i < FILE_EXTENT_CACHE_SIZE; i++) {
+    extent_t* e = &m_extent[i];
+    if (e->count == 0 || e->index > index) {
+      continue;
+    }
+    uint32_t last = e->index + e->count - 1;
+    if (last > index) {
+      last = index;
+    }
+    if (last > found) {
+      found = last;
+      *cluster = e->cluster + last - e->index;
+    }
+  }
+  return found;
+}
+//------------------------------------------------------------------------------
+// Remember clusters of the chain, replacing the shortest run if needed.
+void FatFile::extentPut(uint32_t index, uint32_t cluster, uint32_t count) {
+  extent_t* shortest = m_extent;
+  for (uint8_t i = 0; i < FILE_EXTENT_CACHE_SIZE; i++) {
+    extent_t* e = &m_extent[i];
+    if (e->count) {
+      if (index >= e->index && index < e->index + e->count) {
+        return;
+      }
+      if (index == e->index + e->count && cluster == e->cluster + e->count) {
+        e->count += count;
+        return;
+      }
+    }
+    if (e->count < shortest->count) {
+      shortest = e;
+    }
+  }
+  shortest->index = index;
+  shortest->cluster = cluster;
+  shortest->count = count;
+}
+#endif  // FILE_EXTENT_CACHE_SIZE
+//------------------------------------------------------------------------------
 // Add a cluster to a directory file and zero the cluster.
 // Return with first block of cluster in the cache.
 bool FatFile::addDirCluster() {
@@ -51,7 +117,7 @@ bool FatFile::addDirCluster() {
     goto fail;
   }
   block = m_vol->clusterFirstBlock(m_curCluster);
-  pc = m_vol->cacheFetchData(block, FatCache::CACHE_RESERVE_FOR_WRITE);
+  pc = m_vol->cacheFetchDir(block, FatCache::CACHE_RESERVE_FOR_WRITE);
   if (!pc) {
     DBG_FAIL_MACRO;
     goto fail;
@@ -76,7 +142,7 @@ fail:
 // return pointer to cached entry or null for failure
 dir_t* FatFile::cacheDirEntry(uint8_t action) {
   cache_t* pc;
-  pc = m_vol->cacheFetchData(m_dirBlock, action);
+  pc = m_vol->cacheFetchDir(m_dirBlock, action);
   if (!pc) {
     DBG_FAIL_MACRO;
     goto fail;
@@ -147,6 +213,7 @@ bool FatFile::createContiguous(FatFile* dirFile,
     goto fail;
   }
   m_fileSize = size;
+  extentPut(0, m_firstCluster, count);
 
   // insure sync() will update dir entry
   m_flags |= F_FILE_DIR_DIRTY;
@@ -345,7 +412,7 @@ bool FatFile::mkdir(FatFile* parent, fname_t* fname) {
 
   // cache block for '.'  and '..'
   block = m_vol->clusterFirstBlock(m_firstCluster);
-  pc = m_vol->cacheFetchData(block, FatCache::CACHE_FOR_WRITE);
+  pc = m_vol->cacheFetchDir(block, FatCache::CACHE_FOR_WRITE);
   if (!pc) {
     DBG_FAIL_MACRO;
     goto fail;
@@ -734,7 +801,7 @@ int FatFile::read(void* buf, size_t nbyte) {
           m_curCluster = isRoot32() ? m_vol->rootDirStart() : m_firstCluster;
         } else {
           // get next cluster from FAT
-          fg = m_vol->fatGet(m_curCluster, &m_curCluster);
+          fg = nextCluster(m_curPosition >> (m_vol->clusterSizeShift() + 9));
           if (fg < 0) {
             DBG_FAIL_MACRO;
             goto fail;
@@ -750,7 +817,7 @@ int FatFile::read(void* buf, size_t nbyte) {
       }
       block = m_vol->clusterFirstBlock(m_curCluster) + blockOfCluster;
     }
-    if (offset != 0 || toRead < 512 || block == m_vol->cacheBlockNumber()) {
+    if (offset != 0 || toRead < 512 || m_vol->cacheFind(block)) {
       // amount to be read from current block
       n = 512 - offset;
       if (n > toRead) {
@@ -774,13 +841,10 @@ int FatFile::read(void* buf, size_t nbyte) {
         }
       }
       n = 512*nb;
-      if (block <= m_vol->cacheBlockNumber()
-          && block < (m_vol->cacheBlockNumber() + nb)) {
-        // flush cache if a block is in the cache
-        if (!m_vol->cacheSyncData()) {
-          DBG_FAIL_MACRO;
-          goto fail;
-        }
+      // flush cache if a block is in the cache
+      if (!m_vol->cacheSyncBlocks(block, nb)) {
+        DBG_FAIL_MACRO;
+        goto fail;
       }
       if (!m_vol->readBlocks(block, dst, nb)) {
         DBG_FAIL_MACRO;
@@ -956,7 +1020,7 @@ bool FatFile::rename(FatFile* dirFile, const char* newPath) {
     }
     // store new dot dot
     block = m_vol->clusterFirstBlock(m_firstCluster);
-    pc = m_vol->cacheFetchData(block, FatCache::CACHE_FOR_WRITE);
+    pc = m_vol->cacheFetchDir(block, FatCache::CACHE_FOR_WRITE);
     if (!pc) {
       DBG_FAIL_MACRO;
       goto fail;
@@ -1131,12 +1195,21 @@ bool FatFile::seekSet(uint32_t pos) {
   if (nNew < nCur || m_curPosition == 0) {
     // must follow chain from first cluster
     m_curCluster = isRoot32() ? m_vol->rootDirStart() : m_firstCluster;
-  } else {
-    // advance from curPosition
-    nNew -= nCur;
+    nCur = 0;
   }
-  while (nNew--) {
-    if (m_vol->fatGet(m_curCluster, &m_curCluster) <= 0) {
+#if FILE_EXTENT_CACHE_SIZE
+  {
+    // start from a known cluster nearer than the current one
+    uint32_t cluster;
+    uint32_t index = extentFind(nNew, &cluster);
+    if (index > nCur) {
+      m_curCluster = cluster;
+      nCur = index;
+    }
+  }
+#endif  // FILE_EXTENT_CACHE_SIZE
+  while (nCur < nNew) {
+    if (nextCluster(++nCur) <= 0) {
       DBG_FAIL_MACRO;
       goto fail;
     }
@@ -1331,6 +1404,8 @@ bool FatFile::truncate(uint32_t length) {
     }
   }
   m_fileSize = length;
+  // freed clusters may be in a run
+  extentClear();
 
   // need to update directory entry
   m_flags |= F_FILE_DIR_DIRTY;
@@ -1377,7 +1452,8 @@ int FatFile::write(const void* buf, size_t nbyte) {
     if (blockOfCluster == 0 && blockOffset == 0) {
       // start of new cluster
       if (m_curCluster != 0) {
-        int8_t fg = m_vol->fatGet(m_curCluster, &m_curCluster);
+        uint32_t index = m_curPosition >> (m_vol->clusterSizeShift() + 9);
+        int8_t fg = nextCluster(index);
         if (fg < 0) {
           DBG_FAIL_MACRO;
           goto fail;
@@ -1388,6 +1464,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
             DBG_FAIL_MACRO;
             goto fail;
           }
+          extentPut(index, m_curCluster);
         }
       } else {
         if (m_firstCluster == 0) {
@@ -1444,11 +1521,8 @@ int FatFile::write(const void* buf, size_t nbyte) {
         nBlock = maxBlocks;
       }
       n = 512*nBlock;
-      if (block <= m_vol->cacheBlockNumber()
-          && block < (m_vol->cacheBlockNumber() + nBlock)) {
-        // invalidate cache if block is in cache
-        m_vol->cacheInvalidate();
-      }
+      // invalidate cache if block is in cache
+      m_vol->cacheInvalidateBlocks(block, nBlock);
       if (!m_vol->writeBlocks(block, src, nBlock)) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -1457,9 +1531,7 @@ int FatFile::write(const void* buf, size_t nbyte) {
     } else {
       // use single block write command
       n = 512;
-      if (m_vol->cacheBlockNumber() == block) {
-        m_vol->cacheInvalidate();
-      }
+      m_vol->cacheInvalidateBlocks(block, 1);
       if (!m_vol->writeBlock(block, src)) {
         DBG_FAIL_MACRO;
         goto fail;
@@ -962,6 +962,9 @@ class FatFile {
   dir_t* cacheDirEntry(uint8_t action);
   static uint8_t lfnChecksum(uint8_t* name);
   bool lfnUniqueSfn(fname_t* fname);
+#if USE_DIR_INDEX
+  int8_t lfnIndex();
+#endif  // USE_DIR_INDEX
   bool openCluster(FatFile* file);
   static bool parsePathName(const char* str, fname_t* fname, const char** ptr);
   bool mkdir(FatFile* parent, fname_t* fname);
@@ -997,5 +1000,27 @@ class FatFile {
   uint32_t   m_dirBlock;         // block for this files directory entry
   uint32_t   m_fileSize;         // file size in bytes
   uint32_t   m_firstCluster;     // first cluster of file
+#if FILE_EXTENT_CACHE_SIZE
+  // Run of contiguous clusters in the chain.
+  struct extent_t {
+    uint32_t index;              // cluster index in file of the first one
+    uint32_t cluster;            // first cluster of the run
+    uint32_t count;              // clusters in the run, zero if unused
+  };
+  extent_t   m_extent[FILE_EXTENT_CACHE_SIZE];
+  void extentClear() {
+    memset(m_extent, 0, sizeof(m_extent));
+  }
+  uint32_t extentFind(uint32_t index, uint32_t* cluster);
+  void extentPut(uint32_t index, uint32_t cluster, uint32_t count = 1);
+#else  // FILE_EXTENT_CACHE_SIZE
+  void extentClear() {}
+  void extentPut(uint32_t index, uint32_t cluster, uint32_t count = 1) {
+    (void)index;
+    (void)cluster;
+    (void)count;
+  }
+#endif  // FILE_EXTENT_CACHE_SIZE
+  int8_t nextCluster(uint32_t index);
 };
 #endif  // FatFile_h
@@ -113,6 +113,47 @@ static void lfnPutName(ldir_t *ldir, const char* name, size_t n) {
     lfnPutChar(ldir, i, c);
   }
 }
+#if USE_DIR_INDEX
+//------------------------------------------------------------------------------
+// Case-insensitive name hash, any match is checked against the entries.
+static uint16_t lfnHashChar(uint16_t hash, uint16_t c, size_t k) {
+  if (c < 0X100) {
+    c = static_cast<uint8_t>(lfnToLower(c));
+  }
+  return hash + (c + 1)*(2*k + 1)*40503U;
+}
+//------------------------------------------------------------------------------
+static uint16_t lfnHashEntry(uint16_t hash, ldir_t* ldir) {
+  size_t k = 13*((ldir->ord & 0X1F) - 1);
+  for (uint8_t i = 0; i < 13; i++, k++) {
+    uint16_t c = lfnGetChar(ldir, i);
+    if (c == 0) {
+      break;
+    }
+    hash = lfnHashChar(hash, c, k);
+  }
+  return hash;
+}
+//------------------------------------------------------------------------------
+// Hash of a short name as NAME.EXT, for entries without a long name.
+static uint16_t lfnHash83(const uint8_t* name) {
+  uint16_t hash = 0;
+  size_t k = 0;
+  for (uint8_t i = 0; i < 11; i++) {
+    if (i == 8 && name[8] != ' ') {
+      hash = lfnHashChar(hash, '.', k++);
+    }
+    if (name[i] != ' ') {
+      hash = lfnHashChar(hash, name[i], k++);
+    }
+  }
+  return hash;
+}
+//------------------------------------------------------------------------------
+static uint16_t lfnHashSfn(const uint8_t* sfn) {
+  return Bernstein(0, reinterpret_cast<const char*>(sfn), 11);
+}
+#endif  // USE_DIR_INDEX
 //==============================================================================
 bool FatFile::getName(char* name, size_t size) {
   FatFile dirFile;
@@ -297,6 +338,17 @@ bool FatFile::open(FatFile* dirFile, fname_t* fname, uint8_t oflag) {
   dir_t* dir;
   ldir_t* ldir;
   size_t len = fname->len;
+#if USE_DIR_INDEX
+  FatVolume* vol = dirFile->m_vol;
+  int8_t slot = -1;
+  int16_t candidate = -1;
+  int32_t lastIndex = -1;
+  uint16_t nameHash = 0;
+  uint16_t sfnHash = 0;
+  bool sfnMatch = !(fname->flags & FNAME_FLAG_LOST_CHARS);
+  bool skipReadOk = true;
+  bool indexStale = false;
+#endif  // USE_DIR_INDEX
 
   if (!dirFile->isDir() || isOpen()) {
     DBG_FAIL_MACRO;
@@ -305,10 +357,40 @@ bool FatFile::open(FatFile* dirFile, fname_t* fname, uint8_t oflag) {
   // Number of directory entries needed.
   freeNeed = fname->flags & FNAME_FLAG_NEED_LFN ? 1 + (len + 12)/13 : 1;
 
+#if USE_DIR_INDEX
+  slot = dirFile->lfnIndex();
+  if (slot >= 0) {
+    for (size_t k = 0; k < len; k++) {
+      nameHash = lfnHashChar(nameHash, static_cast<uint8_t>(fname->lfn[k]), k);
+    }
+    sfnHash = lfnHashSfn(fname->sfn);
+  }
+#endif  // USE_DIR_INDEX
   dirFile->rewind();
   while (1) {
     curIndex = dirFile->m_curPosition/32;
+#if USE_DIR_INDEX
+    // With an index only the entries of names with the same hash are read.
+    if (slot >= 0 && curIndex > lastIndex) {
+      candidate = vol->dirIndexFind(slot, nameHash, sfnHash, sfnMatch,
+                                    candidate + 1);
+      if (candidate < 0) {
+        goto indexCreate;
+      }
+      lastIndex = vol->m_dirIndexEntry[candidate].index;
+      curIndex = lastIndex - vol->m_dirIndexEntry[candidate].lfnOrd;
+      if (!dirFile->seekSet(32UL*curIndex)) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      lfnOrd = 0;
+      skipReadOk = false;
+    }
+    dir = dirFile->readDirCache(skipReadOk);
+    skipReadOk = true;
+#else  // USE_DIR_INDEX
     dir = dirFile->readDirCache(true);
+#endif  // USE_DIR_INDEX
     if (!dir) {
       if (dirFile->getError()) {
         DBG_FAIL_MACRO;
@@ -387,6 +469,21 @@ bool FatFile::open(FatFile* dirFile, fname_t* fname, uint8_t oflag) {
     }
   }
 
+#if USE_DIR_INDEX
+indexCreate:
+  // Not found, the index has the free entries.
+  fnameFound = !sfnMatch && vol->dirIndexHasSfn(slot, sfnHash);
+  if ((oflag & O_CREAT) && (oflag & O_WRITE)) {
+    freeIndex = vol->dirIndexFree(slot, freeNeed, &freeFound);
+    curIndex = freeIndex + freeFound;
+    if (!dirFile->seekSet(32UL*curIndex)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  goto create;
+#endif  // USE_DIR_INDEX
+
 found:
   // Don't open if create only.
   if (oflag & O_EXCL) {
@@ -435,6 +532,9 @@ create:
       goto fail;
     }
   }
+#if USE_DIR_INDEX
+  indexStale = slot >= 0;
+#endif  // USE_DIR_INDEX
   if (!dirFile->seekSet(32UL*freeIndex)) {
     DBG_FAIL_MACRO;
     goto fail;
@@ -482,6 +582,12 @@ create:
 
   // Force write of entry to device.
   dirFile->m_vol->cacheDirty();
+#if USE_DIR_INDEX
+  if (slot >= 0) {
+    vol->dirIndexAdd(slot, nameHash, lfnHashSfn(fname->sfn), curIndex, lfnOrd);
+    indexStale = false;
+  }
+#endif  // USE_DIR_INDEX
 
 open:
   // open entry in cache.
@@ -492,6 +598,12 @@ open:
   return true;
 
 fail:
+#if USE_DIR_INDEX
+  // A failed create may have left part of its entries.
+  if (indexStale) {
+    vol->dirIndexDrop(dirFile->m_firstCluster);
+  }
+#endif  // USE_DIR_INDEX
   return false;
 }
 //------------------------------------------------------------------------------
@@ -560,9 +672,13 @@ bool FatFile::remove() {
     goto fail;
   }
   // Free any clusters.
-  if (m_firstCluster && !m_vol->freeChain(m_firstCluster)) {
-    DBG_FAIL_MACRO;
-    goto fail;
+  if (m_firstCluster) {
+    // May be a directory from rmdir().
+    m_vol->dirIndexDrop(m_firstCluster);
+    if (!m_vol->freeChain(m_firstCluster)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
   }
   // Cache directory entry.
   dir = cacheDirEntry(FatCache::CACHE_FOR_WRITE);
@@ -574,6 +690,7 @@ bool FatFile::remove() {
 
   // Mark entry deleted.
   dir->name[0] = DIR_NAME_DELETED;
+  m_vol->dirIndexRemove(m_dirCluster, m_dirIndex);
 
   // Set this file closed.
   m_attr = FILE_ATTR_CLOSED;
@@ -624,12 +741,101 @@ bool FatFile::remove() {
 fail:
   return false;
 }
+#if USE_DIR_INDEX
+//------------------------------------------------------------------------------
+/**
+ * Index this directory on first use.
+ *
+ * \return The index slot or -1 if the directory is too big to index.
+ */
+int8_t FatFile::lfnIndex() {
+  FatVolume* vol = m_vol;
+  uint8_t slot;
+  uint8_t lfnOrd = 0;
+  uint8_t ord = 0;
+  uint8_t chksum = 0;
+  uint16_t hash = 0;
+  uint16_t deleted = 0;
+  uint16_t curIndex;
+  dir_t* dir;
+  int8_t found = vol->dirIndexSlot(m_firstCluster);
+
+  if (found >= 0) {
+    return vol->m_dirIndexDir[found].state == FatVolume::DIR_INDEX_VALID ?
+           found : -1;
+  }
+  slot = vol->dirIndexNew(m_firstCluster);
+  rewind();
+  while (1) {
+    curIndex = m_curPosition/32;
+    dir = readDirCache(true);
+    if (!dir) {
+      if (getError()) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      break;
+    }
+    if (dir->name[0] == DIR_NAME_FREE) {
+      break;
+    }
+    if (dir->name[0] == DIR_NAME_DELETED) {
+      deleted++;
+      lfnOrd = 0;
+      continue;
+    }
+    if (deleted) {
+      vol->dirIndexHoleAdd(slot, curIndex - deleted, deleted);
+      deleted = 0;
+    }
+    if (dir->name[0] == '.') {
+      lfnOrd = 0;
+    } else if (DIR_IS_LONG_NAME(dir)) {
+      ldir_t *ldir = reinterpret_cast<ldir_t*>(dir);
+      if (ldir->ord & LDIR_ORD_LAST_LONG_ENTRY) {
+        lfnOrd = ord = ldir->ord & 0X1F;
+        chksum = ldir->chksum;
+        hash = 0;
+      } else if (!lfnOrd || ldir->ord != --ord || chksum != ldir->chksum) {
+        lfnOrd = 0;
+        continue;
+      }
+      hash = lfnHashEntry(hash, ldir);
+    } else if (DIR_IS_FILE_OR_SUBDIR(dir)) {
+      if (lfnOrd && (ord != 1 || lfnChecksum(dir->name) != chksum)) {
+        lfnOrd = 0;
+      }
+      if (!lfnOrd) {
+        hash = lfnHash83(dir->name);
+      }
+      if (!vol->dirIndexAdd(slot, hash, lfnHashSfn(dir->name),
+                            curIndex, lfnOrd)) {
+        return -1;
+      }
+      lfnOrd = 0;
+    } else {
+      lfnOrd = 0;
+    }
+  }
+  // Deleted entries at the end join the free end.
+  vol->m_dirIndexDir[slot].end = curIndex - deleted;
+  vol->m_dirIndexDir[slot].state = FatVolume::DIR_INDEX_VALID;
+  return slot;
+
+fail:
+  vol->dirIndexClear(slot);
+  return -1;
+}
+#endif  // USE_DIR_INDEX
 //------------------------------------------------------------------------------
 bool FatFile::lfnUniqueSfn(fname_t* fname) {
   const uint8_t FIRST_HASH_SEQ = 2;  // min value is 2
   uint8_t pos = fname->seqPos;;
   dir_t *dir;
   uint16_t hex;
+#if USE_DIR_INDEX
+  int8_t slot = lfnIndex();
+#endif  // USE_DIR_INDEX
 
   DBG_HALT_IF(!(fname->flags & FNAME_FLAG_LOST_CHARS));
   DBG_HALT_IF(fname->sfn[pos] != '~' && fname->sfn[pos + 1] != '1');
@@ -651,6 +857,15 @@ bool FatFile::lfnUniqueSfn(fname_t* fname) {
       }
     }
     fname->sfn[pos] = '~';
+#if USE_DIR_INDEX
+    if (slot >= 0) {
+      // A hash match may be another name, then just try the next one.
+      if (!m_vol->dirIndexHasSfn(slot, lfnHashSfn(fname->sfn))) {
+        goto done;
+      }
+      continue;
+    }
+#endif  // USE_DIR_INDEX
     rewind();
     while (1) {
       dir = readDirCache(true);
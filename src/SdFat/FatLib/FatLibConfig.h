@@ -66,6 +66,15 @@
 #endif  // __arm__
 #endif  // USE_SEPARATE_FAT_CACHE
 //------------------------------------------------------------------------------
+/**
+ * FAT_CACHE_BLOCKS is the number of 512 byte blocks cached by a volume,
+ * shared by data, FAT and directory blocks.  The default matches the data
+ * block plus the USE_SEPARATE_FAT_CACHE block.
+ */
+#ifndef FAT_CACHE_BLOCKS
+#define FAT_CACHE_BLOCKS (1 + USE_SEPARATE_FAT_CACHE)
+#endif  // FAT_CACHE_BLOCKS
+//------------------------------------------------------------------------------
 /**
  * Set USE_MULTI_BLOCK_IO non-zero to use multi-block SD read/write.
  *
@@ -88,6 +97,38 @@
 #define MAINTAIN_FREE_CLUSTER_COUNT 0
 #endif  // MAINTAIN_FREE_CLUSTER_COUNT
 //------------------------------------------------------------------------------
+/**
+ * Set USE_FREE_CLUSTER_MAP nonzero to keep a count of free clusters for
+ * each group of clusters in RAM.  Groups with no free cluster are skipped
+ * by the allocator.  Uses 2*FREE_CLUSTER_MAP_SIZE bytes of RAM.
+ */
+#ifndef USE_FREE_CLUSTER_MAP
+#define USE_FREE_CLUSTER_MAP 0
+#endif  // USE_FREE_CLUSTER_MAP
+#ifndef FREE_CLUSTER_MAP_SIZE
+#define FREE_CLUSTER_MAP_SIZE 1024
+#endif  // FREE_CLUSTER_MAP_SIZE
+//------------------------------------------------------------------------------
+/**
+ * Set USE_DIR_INDEX nonzero to keep name hashes and free entries of recently
+ * used directories in RAM for long file name open and create.  Uses about
+ * 8*DIR_INDEX_SIZE bytes of RAM.
+ */
+#ifndef USE_DIR_INDEX
+#define USE_DIR_INDEX 0
+#endif  // USE_DIR_INDEX
+#ifndef DIR_INDEX_SIZE
+#define DIR_INDEX_SIZE 256
+#endif  // DIR_INDEX_SIZE
+//------------------------------------------------------------------------------
+/**
+ * FILE_EXTENT_CACHE_SIZE is the number of runs of contiguous clusters kept
+ * by each open file for seekSet() and cluster changes.  Zero disables.
+ */
+#ifndef FILE_EXTENT_CACHE_SIZE
+#define FILE_EXTENT_CACHE_SIZE 0
+#endif  // FILE_EXTENT_CACHE_SIZE
+//------------------------------------------------------------------------------
 /**
  * Set DESTRUCTOR_CLOSES_FILE non-zero to close a file in its destructor.
  *
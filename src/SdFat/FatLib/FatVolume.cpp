@@ -65,6 +65,90 @@ fail:
   return false;
 }
 //------------------------------------------------------------------------------
+cache_t* FatVolume::cacheFetch(uint32_t lbn, uint8_t options, bool data) {
+  FatCache* pc = cacheFind(lbn);
+  if (pc) {
+    m_cacheHits++;
+  } else {
+    m_cacheMisses++;
+    // Least recently used block, a FAT fetch keeps the current data block.
+    for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+      FatCache* c = &m_cache[i];
+      if (!data && c == m_cacheCurrent && FAT_CACHE_BLOCKS > 1) {
+        continue;
+      }
+      if (!pc || c->lastUse() < pc->lastUse()) {
+        pc = c;
+      }
+    }
+    // Blocks that go before a dirty FAT or directory block are written first.
+    if (pc->isDirty() && pc->syncOrder() &&
+        !cacheSyncOrder(pc->syncOrder() - 1)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  pc->touch(++m_cacheTick);
+  if (data) {
+    m_cacheCurrent = pc;
+  }
+  return pc->read(lbn, options);
+
+fail:
+  return 0;
+}
+//------------------------------------------------------------------------------
+FatCache* FatVolume::cacheFind(uint32_t lbn) {
+  for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+    if (m_cache[i].lbn() == lbn) {
+      return &m_cache[i];
+    }
+  }
+  return 0;
+}
+//------------------------------------------------------------------------------
+// Write dirty blocks in order, data then FAT then directory, up to order.
+bool FatVolume::cacheSyncOrder(uint8_t order) {
+  for (uint8_t o = 0; o <= order; o++) {
+    for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+      if (m_cache[i].isDirty() && m_cache[i].syncOrder() == o &&
+          !m_cache[i].sync()) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+    }
+  }
+  return true;
+
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Write cached blocks before a multi-block read of the same range.
+bool FatVolume::cacheSyncBlocks(uint32_t lbn, size_t count) {
+  for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+    uint32_t cached = m_cache[i].lbn();
+    if (cached >= lbn && cached - lbn < count && !m_cache[i].sync()) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+  }
+  return true;
+
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+// Drop cached blocks that a direct write replaces.
+void FatVolume::cacheInvalidateBlocks(uint32_t lbn, size_t count) {
+  for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+    uint32_t cached = m_cache[i].lbn();
+    if (cached >= lbn && cached - lbn < count) {
+      m_cache[i].invalidate();
+    }
+  }
+}
+//------------------------------------------------------------------------------
 bool FatVolume::allocateCluster(uint32_t current, uint32_t* next) {
   uint32_t find = current ? current : m_allocSearchStart;
   uint32_t start = find;
@@ -74,6 +158,16 @@ bool FatVolume::allocateCluster(uint32_t current, uint32_t* next) {
     if (find > m_lastCluster) {
       find = 2;
     }
+    uint32_t full = freeMapFullUntil(find);
+    if (full) {
+      // No free cluster in this group, go to the next one.
+      if (start >= find && start <= full) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      find = full;
+      continue;
+    }
     uint32_t f;
     int8_t fg = fatGet(find, &f);
     if (fg < 0) {
@@ -130,6 +224,17 @@ bool FatVolume::allocContiguous(uint32_t count, uint32_t* firstCluster) {
     if (endCluster > m_lastCluster) {
       bgnCluster = endCluster = 2;
     }
+    uint32_t full = freeMapFullUntil(endCluster);
+    if (full) {
+      // No free cluster in this group, start again after it.
+      if (startCluster >= endCluster && startCluster <= full) {
+        DBG_FAIL_MACRO;
+        goto fail;
+      }
+      bgnCluster = endCluster = full + 1;
+      setStart = false;
+      continue;
+    }
     uint32_t f;
     int8_t fg = fatGet(endCluster, &f);
     if (fg < 0) {
@@ -270,6 +375,7 @@ bool FatVolume::fatPut(uint32_t cluster, uint32_t value) {
       DBG_FAIL_MACRO;
       goto fail;
     }
+    freeMapPut(cluster, pc->fat32[cluster & 0X7F] & FAT32MASK, value);
     pc->fat32[cluster & 0X7F] = value;
     return true;
   }
@@ -281,6 +387,7 @@ bool FatVolume::fatPut(uint32_t cluster, uint32_t value) {
       DBG_FAIL_MACRO;
       goto fail;
     }
+    freeMapPut(cluster, pc->fat16[cluster & 0XFF], value);
     pc->fat16[cluster & 0XFF] = value;
     return true;
   }
@@ -358,10 +465,28 @@ fail:
 //------------------------------------------------------------------------------
 int32_t FatVolume::freeClusterCount() {
 #if MAINTAIN_FREE_CLUSTER_COUNT
-  if (m_freeClusterCount >= 0) {
+  // A count that no longer fits the volume is rebuilt from the FAT.
+  if (m_freeClusterCount >= 0 &&
+      (uint32_t)m_freeClusterCount <= clusterCount()) {
     return m_freeClusterCount;
   }
 #endif  // MAINTAIN_FREE_CLUSTER_COUNT
+#if USE_FREE_CLUSTER_MAP
+  // Sum of the groups when the map covers the whole volume.
+  if (m_freeMapGroups &&
+      ((uint32_t)m_freeMapGroups << m_freeMapShift) > m_lastCluster) {
+    uint32_t free = 0;
+    for (uint16_t group = 0; group < m_freeMapGroups; group++) {
+      if (m_freeMap[group] == FREE_MAP_UNKNOWN && freeMapCount(group) < 0) {
+        DBG_FAIL_MACRO;
+        return -1;
+      }
+      free += m_freeMap[group];
+    }
+    setFreeClusterCount(free);
+    return free;
+  }
+#endif  // USE_FREE_CLUSTER_MAP
   uint32_t free = 0;
   uint32_t lba;
   uint32_t todo = m_lastCluster + 1;
@@ -418,6 +543,293 @@ fail:
   return -1;
 }
 //------------------------------------------------------------------------------
+#if MAINTAIN_FREE_CLUSTER_COUNT
+// Take the free cluster count and next free hint of a valid FSINFO block.
+bool FatVolume::fsInfoInit(uint32_t block) {
+  fat32_fsinfo_t* fsi;
+  cache_t* pc = cacheFetchData(block, FatCache::CACHE_FOR_READ);
+  if (!pc) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  fsi = &pc->fsinfo;
+  if (fsi->leadSignature != FSINFO_LEAD_SIG ||
+      fsi->structSignature != FSINFO_STRUCT_SIG) {
+    // Not an error, the count is found the slow way.
+    return true;
+  }
+  m_fsInfoBlock = block;
+  // 0XFFFFFFFF is unknown, a count above the clusters is stale or damaged.
+  if (fsi->freeCount != 0XFFFFFFFF && fsi->freeCount <= clusterCount()) {
+    m_freeClusterCount = fsi->freeCount;
+  }
+  if (fsi->nextFree >= 2 && fsi->nextFree <= m_lastCluster) {
+    m_allocSearchStart = fsi->nextFree - 1;
+  }
+  return true;
+
+fail:
+  return false;
+}
+//------------------------------------------------------------------------------
+bool FatVolume::fsInfoSync() {
+  fat32_fsinfo_t* fsi;
+  cache_t* pc;
+  if (!m_fsInfoDirty || !m_fsInfoBlock || m_freeClusterCount < 0) {
+    return true;
+  }
+  pc = cacheFetchData(m_fsInfoBlock, FatCache::CACHE_FOR_READ);
+  if (!pc) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  fsi = &pc->fsinfo;
+  fsi->freeCount = m_freeClusterCount;
+  fsi->nextFree = m_allocSearchStart + 1;
+  cacheDirty();
+  if (!cacheSyncData()) {
+    DBG_FAIL_MACRO;
+    goto fail;
+  }
+  m_fsInfoDirty = false;
+  return true;
+
+fail:
+  return false;
+}
+#endif  // MAINTAIN_FREE_CLUSTER_COUNT
+//------------------------------------------------------------------------------
+#if USE_FREE_CLUSTER_MAP
+void FatVolume::freeMapInit() {
+  // Smallest groups that fit the map, but no more than a uint16_t count.
+  m_freeMapShift = 7;
+  while (m_freeMapShift < 15 &&
+         (m_lastCluster >> m_freeMapShift) >= FREE_CLUSTER_MAP_SIZE) {
+    m_freeMapShift++;
+  }
+  uint32_t groups = (m_lastCluster >> m_freeMapShift) + 1;
+  m_freeMapGroups = groups < FREE_CLUSTER_MAP_SIZE ?
+                    groups : FREE_CLUSTER_MAP_SIZE;
+  // fatPut can't track FAT12 entries.
+  if (fatType() == 12) {
+    m_freeMapGroups = 0;
+  }
+  memset(m_freeMap, 0XFF, sizeof(m_freeMap));
+}
+//------------------------------------------------------------------------------
+// Count free clusters in a group - return -1 error, else the count.
+int32_t FatVolume::freeMapCount(uint32_t group) {
+  uint32_t first = group << m_freeMapShift;
+  uint32_t last = first + (1UL << m_freeMapShift) - 1;
+  uint16_t free = 0;
+  if (first < 2) {
+    first = 2;
+  }
+  if (last > m_lastCluster) {
+    last = m_lastCluster;
+  }
+  for (uint32_t cluster = first; cluster <= last; cluster++) {
+    uint32_t f;
+    int8_t fg = fatGet(cluster, &f);
+    if (fg < 0) {
+      DBG_FAIL_MACRO;
+      return -1;
+    }
+    if (fg && f == 0) {
+      free++;
+    }
+  }
+  m_freeMap[group] = free;
+  return free;
+}
+//------------------------------------------------------------------------------
+// Last cluster of the group if it has no free cluster, else zero.
+uint32_t FatVolume::freeMapFullUntil(uint32_t cluster) {
+  uint32_t group = cluster >> m_freeMapShift;
+  if (group >= m_freeMapGroups) {
+    return 0;
+  }
+  // Let the caller's own scan report read errors.
+  if (m_freeMap[group] == FREE_MAP_UNKNOWN && freeMapCount(group) < 0) {
+    return 0;
+  }
+  if (m_freeMap[group]) {
+    return 0;
+  }
+  uint32_t last = ((group + 1) << m_freeMapShift) - 1;
+  return last < m_lastCluster ? last : m_lastCluster;
+}
+#endif  // USE_FREE_CLUSTER_MAP
+#if USE_DIR_INDEX
+//------------------------------------------------------------------------------
+void FatVolume::dirIndexInit() {
+  m_dirIndexTick = 0;
+  m_dirIndexCount = 0;
+  memset(m_dirIndexDir, 0, sizeof(m_dirIndexDir));
+  memset(m_dirIndexHole, 0, sizeof(m_dirIndexHole));
+}
+//------------------------------------------------------------------------------
+// Slot of a directory in any state, -1 if it has none.
+int8_t FatVolume::dirIndexSlot(uint32_t cluster) {
+  for (uint8_t i = 0; i < DIR_INDEX_DIRS; i++) {
+    dir_index_dir_t* dir = &m_dirIndexDir[i];
+    if (dir->state != DIR_INDEX_EMPTY && dir->cluster == cluster) {
+      dir->lastUse = ++m_dirIndexTick;
+      return i;
+    }
+  }
+  return -1;
+}
+//------------------------------------------------------------------------------
+// Empty slot for a directory, replacing the least recently used one.
+uint8_t FatVolume::dirIndexNew(uint32_t cluster) {
+  uint8_t slot = 0;
+  for (uint8_t i = 1; i < DIR_INDEX_DIRS; i++) {
+    if (m_dirIndexDir[i].lastUse < m_dirIndexDir[slot].lastUse) {
+      slot = i;
+    }
+  }
+  dirIndexClear(slot);
+  m_dirIndexDir[slot].cluster = cluster;
+  m_dirIndexDir[slot].lastUse = ++m_dirIndexTick;
+  return slot;
+}
+//------------------------------------------------------------------------------
+void FatVolume::dirIndexClear(uint8_t slot) {
+  for (uint16_t i = 0; i < m_dirIndexCount;) {
+    if (m_dirIndexEntry[i].slot == slot) {
+      m_dirIndexEntry[i] = m_dirIndexEntry[--m_dirIndexCount];
+    } else {
+      i++;
+    }
+  }
+  for (uint8_t i = 0; i < DIR_INDEX_HOLES; i++) {
+    if (m_dirIndexHole[i].slot == slot) {
+      m_dirIndexHole[i].count = 0;
+    }
+  }
+  m_dirIndexDir[slot].state = DIR_INDEX_EMPTY;
+  m_dirIndexDir[slot].lastUse = 0;
+}
+//------------------------------------------------------------------------------
+void FatVolume::dirIndexDrop(uint32_t cluster) {
+  int8_t slot = dirIndexSlot(cluster);
+  if (slot >= 0) {
+    dirIndexClear(slot);
+  }
+}
+//------------------------------------------------------------------------------
+bool FatVolume::dirIndexAdd(uint8_t slot, uint16_t nameHash, uint16_t sfnHash,
+                            uint16_t index, uint8_t lfnOrd) {
+  dir_index_dir_t* dir = &m_dirIndexDir[slot];
+  dir_index_entry_t* entry;
+  uint16_t first = index - lfnOrd;
+  // Make room by dropping other directories, least recently used first.
+  while (m_dirIndexCount >= DIR_INDEX_SIZE) {
+    int8_t victim = -1;
+    for (uint8_t i = 0; i < DIR_INDEX_DIRS; i++) {
+      if (i != slot && m_dirIndexDir[i].state == DIR_INDEX_VALID &&
+          (victim < 0 ||
+           m_dirIndexDir[i].lastUse < m_dirIndexDir[victim].lastUse)) {
+        victim = i;
+      }
+    }
+    if (victim < 0) {
+      // Directory alone is too big, remember so it is not read again.
+      dirIndexClear(slot);
+      dir->state = DIR_INDEX_TOO_BIG;
+      dir->lastUse = ++m_dirIndexTick;
+      return false;
+    }
+    dirIndexClear(victim);
+  }
+  entry = &m_dirIndexEntry[m_dirIndexCount++];
+  entry->nameHash = nameHash;
+  entry->sfnHash = sfnHash;
+  entry->index = index;
+  entry->lfnOrd = lfnOrd;
+  entry->slot = slot;
+  // Entries came from the front of a hole or from the free end.
+  for (uint8_t i = 0; i < DIR_INDEX_HOLES; i++) {
+    dir_index_hole_t* hole = &m_dirIndexHole[i];
+    if (hole->count && hole->slot == slot && hole->index == first) {
+      hole->index += lfnOrd + 1;
+      hole->count = hole->count > lfnOrd + 1 ? hole->count - lfnOrd - 1 : 0;
+    }
+  }
+  if (index >= dir->end) {
+    dir->end = index + 1;
+  }
+  return true;
+}
+//------------------------------------------------------------------------------
+void FatVolume::dirIndexHoleAdd(uint8_t slot, uint16_t index, uint16_t count) {
+  for (uint8_t i = 0; i < DIR_INDEX_HOLES; i++) {
+    dir_index_hole_t* hole = &m_dirIndexHole[i];
+    if (!hole->count) {
+      hole->index = index;
+      hole->count = count < 0XFF ? count : 0XFF;
+      hole->slot = slot;
+      return;
+    }
+  }
+  // No room, the entries are only reused after a new scan.
+}
+//------------------------------------------------------------------------------
+// Next entry from position from with the name hash, or the short name hash
+// if sfn is true.  Returns -1 if there is none.
+int16_t FatVolume::dirIndexFind(uint8_t slot, uint16_t nameHash,
+                                uint16_t sfnHash, bool sfn, int16_t from) {
+  for (int16_t i = from; i < m_dirIndexCount; i++) {
+    dir_index_entry_t* entry = &m_dirIndexEntry[i];
+    if (entry->slot == slot && (entry->nameHash == nameHash ||
+                                (sfn && entry->sfnHash == sfnHash))) {
+      return i;
+    }
+  }
+  return -1;
+}
+//------------------------------------------------------------------------------
+bool FatVolume::dirIndexHasSfn(uint8_t slot, uint16_t sfnHash) {
+  for (uint16_t i = 0; i < m_dirIndexCount; i++) {
+    if (m_dirIndexEntry[i].slot == slot &&
+        m_dirIndexEntry[i].sfnHash == sfnHash) {
+      return true;
+    }
+  }
+  return false;
+}
+//------------------------------------------------------------------------------
+// First of need free entries.  found is need for a hole, else zero and the
+// entries start at the free end, which may have to grow.
+uint16_t FatVolume::dirIndexFree(uint8_t slot, uint8_t need, uint8_t* found) {
+  for (uint8_t i = 0; i < DIR_INDEX_HOLES; i++) {
+    dir_index_hole_t* hole = &m_dirIndexHole[i];
+    if (hole->count >= need && hole->slot == slot) {
+      *found = need;
+      return hole->index;
+    }
+  }
+  *found = 0;
+  return m_dirIndexDir[slot].end;
+}
+//------------------------------------------------------------------------------
+void FatVolume::dirIndexRemove(uint32_t cluster, uint16_t index) {
+  int8_t slot = dirIndexSlot(cluster);
+  if (slot < 0 || m_dirIndexDir[slot].state != DIR_INDEX_VALID) {
+    return;
+  }
+  for (uint16_t i = 0; i < m_dirIndexCount; i++) {
+    dir_index_entry_t* entry = &m_dirIndexEntry[i];
+    if (entry->slot == slot && entry->index == index) {
+      dirIndexHoleAdd(slot, index - entry->lfnOrd, entry->lfnOrd + 1);
+      *entry = m_dirIndexEntry[--m_dirIndexCount];
+      return;
+    }
+  }
+}
+#endif  // USE_DIR_INDEX
+//------------------------------------------------------------------------------
 bool FatVolume::init(uint8_t part) {
   uint32_t clusterCount;
   uint32_t totalBlocks;
@@ -427,10 +839,14 @@ bool FatVolume::init(uint8_t part) {
   uint8_t tmp;
   m_fatType = 0;
   m_allocSearchStart = 1;
-  m_cache.init(this);
-#if USE_SEPARATE_FAT_CACHE
-  m_fatCache.init(this);
-#endif  // USE_SEPARATE_FAT_CACHE
+  for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+    m_cache[i].init(this);
+  }
+  m_cacheCurrent = m_cache;
+  m_cacheTick = 0;
+  m_cacheHits = 0;
+  m_cacheMisses = 0;
+  dirIndexInit();
   // if part == 0 assume super floppy with FAT boot sector in block zero
   // if part > 0 assume mbr volume with partition table
   if (part) {
@@ -499,6 +915,10 @@ bool FatVolume::init(uint8_t part) {
 
   // Indicate unknown number of free clusters.
   setFreeClusterCount(-1);
+#if MAINTAIN_FREE_CLUSTER_COUNT
+  m_fsInfoBlock = 0;
+  m_fsInfoDirty = false;
+#endif  // MAINTAIN_FREE_CLUSTER_COUNT
   // FAT type is determined by cluster count
   if (clusterCount < 4085) {
     m_fatType = 12;
@@ -511,7 +931,15 @@ bool FatVolume::init(uint8_t part) {
   } else {
     m_rootDirStart = fbs->fat32RootCluster;
     m_fatType = 32;
+#if MAINTAIN_FREE_CLUSTER_COUNT
+    if (fbs->fat32FSInfo &&
+        !fsInfoInit(volumeStartBlock + fbs->fat32FSInfo)) {
+      DBG_FAIL_MACRO;
+      goto fail;
+    }
+#endif  // MAINTAIN_FREE_CLUSTER_COUNT
   }
+  freeMapInit();
   return true;
 
 fail:
@@ -94,9 +94,11 @@ class FatCache {
   static const uint8_t CACHE_STATUS_DIRTY = 1;
   /** Cashed block is FAT entry and must be mirrored in second FAT. */
   static const uint8_t CACHE_STATUS_MIRROR_FAT = 2;
+  /** Cached block is a directory block, written after FAT blocks. */
+  static const uint8_t CACHE_STATUS_DIR = 8;
   /** Cache block status bits */
   static const uint8_t CACHE_STATUS_MASK
-    = CACHE_STATUS_DIRTY | CACHE_STATUS_MIRROR_FAT;
+    = CACHE_STATUS_DIRTY | CACHE_STATUS_MIRROR_FAT | CACHE_STATUS_DIR;
   /** Sync existing block but do not read new block. */
   static const uint8_t CACHE_OPTION_NO_READ = 4;
   /** Cache block for read. */
@@ -110,9 +112,11 @@ class FatCache {
   cache_t* block() {
     return &m_block;
   }
-  /** Set current block dirty. */
-  void dirty() {
-    m_status |= CACHE_STATUS_DIRTY;
+  /** Set current block dirty.
+   * \param[in] status Extra status bits for the block.
+   */
+  void dirty(uint8_t status = 0) {
+    m_status |= CACHE_STATUS_DIRTY | (status & CACHE_STATUS_MASK);
   }
   /** Initialize the cache.
    * \param[in] vol FatVolume that owns this FatCache.
@@ -125,6 +129,7 @@ class FatCache {
   void invalidate() {
     m_status = 0;
     m_lbn = 0XFFFFFFFF;
+    m_lastUse = 0;
   }
   /** \return dirty status */
   bool isDirty() {
@@ -134,6 +139,21 @@ class FatCache {
   uint32_t lbn() {
     return m_lbn;
   }
+  /** \return Volume use count of the last fetch, zero if invalid. */
+  uint32_t lastUse() {
+    return m_lastUse;
+  }
+  /** Record a fetch of the block.
+   * \param[in] tick Volume use count.
+   */
+  void touch(uint32_t tick) {
+    m_lastUse = tick;
+  }
+  /** \return Write order of the block, 0 data, 1 FAT, 2 directory. */
+  uint8_t syncOrder() {
+    return m_status & CACHE_STATUS_MIRROR_FAT ? 1 :
+           m_status & CACHE_STATUS_DIR ? 2 : 0;
+  }
   /** Read a block into the cache.
    * \param[in] lbn Block to read.
    * \param[in] option mode for cached block.
@@ -148,6 +168,7 @@ class FatCache {
   uint8_t m_status;
   FatVolume* m_vol;
   uint32_t m_lbn;
+  uint32_t m_lastUse;
   cache_t m_block;
 };
 //==============================================================================
@@ -176,8 +197,18 @@ class FatVolume {
     if (!cacheSync()) {
       return 0;
     }
-    m_cache.invalidate();
-    return m_cache.block();
+    for (uint8_t i = 0; i < FAT_CACHE_BLOCKS; i++) {
+      m_cache[i].invalidate();
+    }
+    return m_cacheCurrent->block();
+  }
+  /** \return Number of block fetches found in the cache. */
+  uint32_t cacheHitCount() const {
+    return m_cacheHits;
+  }
+  /** \return Number of block fetches that replaced a cached block. */
+  uint32_t cacheMissCount() const {
+    return m_cacheMisses;
   }
   /** \return The total number of clusters in the volume. */
   uint32_t clusterCount() const {
@@ -228,6 +259,10 @@ class FatVolume {
    * the value false is returned for failure.
    */
   bool init(uint8_t part);
+  /** \return true while the card is programming a written block. */
+  bool isBusy() {
+    return m_blockDev->isBusy();
+  }
   /** \return The number of entries in the root directory for FAT16 volumes. */
   uint16_t rootDirEntryCount() const {
     return m_rootDirEntryCount;
@@ -246,6 +281,27 @@ class FatVolume {
    * \return true for success else false.
    */
   bool wipe(print_t* pr = 0);
+  /** Start writing a whole block of a file straight to the card, for
+   * streaming into a contiguous file.  See FatFile::contiguousRange().
+   *
+   * \param[in] block Logical block to be written.
+   * \param[in] src Data, left untouched until writeBlockBusy() is false.
+   * \return true for success or false for failure.
+   */
+  bool writeBlockStart(uint32_t block, const uint8_t* src) {
+    cacheInvalidateBlocks(block, 1);
+    return m_blockDev->writeBlockStart(block, src);
+  }
+  /** \return true while the data of writeBlockStart() is being sent. */
+  bool writeBlockBusy() {
+    return m_blockDev->writeBlockBusy();
+  }
+  /** Wait for the data of writeBlockStart() to be sent.
+   * \return true if the card accepted the block else false.
+   */
+  bool writeBlockFinish() {
+    return m_blockDev->writeBlockFinish();
+  }
   /** Debug access to FAT table
    *
    * \param[in] n cluster number.
@@ -295,14 +351,20 @@ class FatVolume {
 #endif  // USE_MULTI_BLOCK_IO
 #if MAINTAIN_FREE_CLUSTER_COUNT
   int32_t  m_freeClusterCount;     // Count of free clusters in volume.
+  uint32_t m_fsInfoBlock;          // FAT32 FSINFO block, zero if none.
+  bool     m_fsInfoDirty;          // Count changed since FSINFO was written.
   void setFreeClusterCount(int32_t value) {
     m_freeClusterCount = value;
+    m_fsInfoDirty = true;
   }
   void updateFreeClusterCount(int32_t change) {
     if (m_freeClusterCount >= 0) {
       m_freeClusterCount += change;
+      m_fsInfoDirty = true;
     }
   }
+  bool fsInfoInit(uint32_t block);
+  bool fsInfoSync();
 #else  // MAINTAIN_FREE_CLUSTER_COUNT
   void setFreeClusterCount(int32_t value) {
     (void)value;
@@ -310,45 +372,133 @@ class FatVolume {
   void updateFreeClusterCount(int32_t change) {
     (void)change;
   }
+  bool fsInfoSync() {
+    return true;
+  }
 #endif  // MAINTAIN_FREE_CLUSTER_COUNT
+#if USE_FREE_CLUSTER_MAP
+  static const uint16_t FREE_MAP_UNKNOWN = 0XFFFF;
+  uint8_t  m_freeMapShift;         // Cluster number to group shift.
+  uint16_t m_freeMapGroups;        // Groups in the map, zero for FAT12.
+  uint16_t m_freeMap[FREE_CLUSTER_MAP_SIZE];  // Free clusters in each group.
+  void freeMapInit();
+  int32_t freeMapCount(uint32_t group);
+  uint32_t freeMapFullUntil(uint32_t cluster);
+  void freeMapPut(uint32_t cluster, uint32_t oldValue, uint32_t value) {
+    uint32_t group = cluster >> m_freeMapShift;
+    if (group >= m_freeMapGroups || m_freeMap[group] == FREE_MAP_UNKNOWN) {
+      return;
+    }
+    if (oldValue == 0 && value != 0) {
+      m_freeMap[group]--;
+    } else if (oldValue != 0 && value == 0) {
+      m_freeMap[group]++;
+    }
+  }
+#else  // USE_FREE_CLUSTER_MAP
+  void freeMapInit() {}
+  uint32_t freeMapFullUntil(uint32_t cluster) {
+    (void)cluster;
+    return 0;
+  }
+  void freeMapPut(uint32_t cluster, uint32_t oldValue, uint32_t value) {
+    (void)cluster;
+    (void)oldValue;
+    (void)value;
+  }
+#endif  // USE_FREE_CLUSTER_MAP
+#if USE_DIR_INDEX
+  static const uint8_t DIR_INDEX_DIRS = 4;
+  static const uint8_t DIR_INDEX_HOLES = 8;
+  static const uint8_t DIR_INDEX_EMPTY = 0;
+  static const uint8_t DIR_INDEX_VALID = 1;
+  static const uint8_t DIR_INDEX_TOO_BIG = 2;
+  struct dir_index_dir_t {
+    uint32_t cluster;    // First cluster, zero for the FAT16 root.
+    uint32_t lastUse;    // For least recently used replacement.
+    uint16_t end;        // Entries from here on are free.
+    uint8_t  state;
+  };
+  struct dir_index_entry_t {
+    uint16_t nameHash;   // Lower case long name, or NAME.EXT without one.
+    uint16_t sfnHash;    // The 11 byte short name.
+    uint16_t index;      // Short name entry in the directory.
+    uint8_t  lfnOrd;     // Long name entries in front of it.
+    uint8_t  slot;       // Directory in m_dirIndexDir.
+  };
+  struct dir_index_hole_t {
+    uint16_t index;      // First deleted entry of the run.
+    uint8_t  count;      // Zero if the hole is unused.
+    uint8_t  slot;
+  };
+  uint32_t m_dirIndexTick;         // Directory lookups.
+  uint16_t m_dirIndexCount;        // Entries used in m_dirIndexEntry.
+  dir_index_dir_t m_dirIndexDir[DIR_INDEX_DIRS];
+  dir_index_hole_t m_dirIndexHole[DIR_INDEX_HOLES];
+  dir_index_entry_t m_dirIndexEntry[DIR_INDEX_SIZE];
+  void dirIndexInit();
+  int8_t dirIndexSlot(uint32_t cluster);
+  uint8_t dirIndexNew(uint32_t cluster);
+  void dirIndexClear(uint8_t slot);
+  void dirIndexDrop(uint32_t cluster);
+  bool dirIndexAdd(uint8_t slot, uint16_t nameHash, uint16_t sfnHash,
+                   uint16_t index, uint8_t lfnOrd);
+  void dirIndexHoleAdd(uint8_t slot, uint16_t index, uint16_t count);
+  int16_t dirIndexFind(uint8_t slot, uint16_t nameHash, uint16_t sfnHash,
+                       bool sfn, int16_t from);
+  bool dirIndexHasSfn(uint8_t slot, uint16_t sfnHash);
+  uint16_t dirIndexFree(uint8_t slot, uint8_t need, uint8_t* found);
+  void dirIndexRemove(uint32_t cluster, uint16_t index);
+#else  // USE_DIR_INDEX
+  void dirIndexInit() {}
+  void dirIndexDrop(uint32_t cluster) {
+    (void)cluster;
+  }
+  void dirIndexRemove(uint32_t cluster, uint16_t index) {
+    (void)cluster;
+    (void)index;
+  }
+#endif  // USE_DIR_INDEX
 
 // block caches
-  FatCache m_cache;
-#if USE_SEPARATE_FAT_CACHE
-  FatCache m_fatCache;
+  FatCache m_cache[FAT_CACHE_BLOCKS];
+  FatCache* m_cacheCurrent;        // Last data block fetched.
+  uint32_t m_cacheTick;            // Fetch count for LRU replacement.
+  uint32_t m_cacheHits;            // Fetches found in the cache.
+  uint32_t m_cacheMisses;          // Fetches that replaced a block.
+  cache_t* cacheFetch(uint32_t blockNumber, uint8_t options, bool data);
+  FatCache* cacheFind(uint32_t blockNumber);
+  bool cacheSyncOrder(uint8_t order);
+  bool cacheSyncBlocks(uint32_t blockNumber, size_t count);
+  void cacheInvalidateBlocks(uint32_t blockNumber, size_t count);
   cache_t* cacheFetchFat(uint32_t blockNumber, uint8_t options) {
-    return m_fatCache.read(blockNumber,
-                           options | FatCache::CACHE_STATUS_MIRROR_FAT);
+    return cacheFetch(blockNumber,
+                      options | FatCache::CACHE_STATUS_MIRROR_FAT, false);
   }
-  bool cacheSync() {
-    return m_cache.sync() && m_fatCache.sync() && syncBlocks();
+  cache_t* cacheFetchData(uint32_t blockNumber, uint8_t options) {
+    return cacheFetch(blockNumber, options, true);
   }
-#else  //
-  cache_t* cacheFetchFat(uint32_t blockNumber, uint8_t options) {
-    return cacheFetchData(blockNumber,
-                          options | FatCache::CACHE_STATUS_MIRROR_FAT);
+  cache_t* cacheFetchDir(uint32_t blockNumber, uint8_t options) {
+    return cacheFetch(blockNumber,
+                      options | FatCache::CACHE_STATUS_DIR, true);
   }
+  // Write data blocks, then FAT blocks, then directory blocks, then the
+  // FAT32 free cluster count.
   bool cacheSync() {
-    return m_cache.sync() && syncBlocks();
-  }
-#endif  // USE_SEPARATE_FAT_CACHE
-  cache_t* cacheFetchData(uint32_t blockNumber, uint8_t options) {
-    return m_cache.read(blockNumber, options);
-  }
-  void cacheInvalidate() {
-    m_cache.invalidate();
+    return cacheSyncOrder(2) && fsInfoSync() && syncBlocks();
   }
   bool cacheSyncData() {
-    return m_cache.sync();
+    return m_cacheCurrent->sync();
   }
   cache_t *cacheAddress() {
-    return m_cache.block();
+    return m_cacheCurrent->block();
   }
   uint32_t cacheBlockNumber() {
-    return m_cache.lbn();
+    return m_cacheCurrent->lbn();
   }
+  // Only used after changing a directory entry.
   void cacheDirty() {
-    m_cache.dirty();
+    m_cacheCurrent->dirty(FatCache::CACHE_STATUS_DIR);
   }
 //------------------------------------------------------------------------------
   bool allocateCluster(uint32_t current, uint32_t* next);
@@ -24,6 +24,26 @@
 #define SD_CS_DBG(m)
 // #define SD_CS_DBG(m) Serial.println(F(m));
 //==============================================================================
+#if USE_SD_LATENCY_STATS
+// Times the rest of the enclosing function into an SdLatency histogram.
+class SdLatencyTimer {
+ public:
+  SdLatencyTimer(SdLatency* latency, uint8_t op)
+    : m_latency(latency), m_op(op), m_start(curTimeUS()) {}
+  ~SdLatencyTimer() {
+    m_latency->record(m_op, curTimeUS() - m_start);
+  }
+
+ private:
+  SdLatency* m_latency;
+  uint8_t m_op;
+  uint32_t m_start;
+};
+#define SD_LATENCY(op) SdLatencyTimer latencyTimer(&m_latency, op)
+#else  // USE_SD_LATENCY_STATS
+#define SD_LATENCY(op)
+#endif  // USE_SD_LATENCY_STATS
+//==============================================================================
 #if USE_SD_CRC
 // CRC functions
 //------------------------------------------------------------------------------
@@ -118,6 +138,7 @@ bool SdSpiCard::begin(SdSpiDriver* spi, uint8_t csPin, SPISettings settings) {
   m_spiActive = false;
   m_errorCode = SD_CARD_ERROR_NONE;
   m_type = 0;
+  m_asyncState = ASYNC_IDLE;
   m_spiDriver = spi;
   uint16_t t0 = curTimeMS();
   uint32_t arg;
@@ -198,6 +219,9 @@ fail:
 //------------------------------------------------------------------------------
 // send command and return error code.  Return zero for OK
 uint8_t SdSpiCard::cardCommand(uint8_t cmd, uint32_t arg) {
+  // the data of writeBlockStart() holds the bus
+  while (writeBlockBusy()) {}
+  SD_LATENCY(SD_OP_COMMAND);
   // select card
   if (!m_spiActive) {
     spiStart();
@@ -250,6 +274,7 @@ uint32_t SdSpiCard::cardSize() {
 }
 //------------------------------------------------------------------------------
 bool SdSpiCard::erase(uint32_t firstBlock, uint32_t lastBlock) {
+  SD_LATENCY(SD_OP_ERASE);
   csd_t csd;
   if (!readCSD(&csd)) {
     goto fail;
@@ -293,6 +318,7 @@ bool SdSpiCard::eraseSingleBlockEnable() {
 //------------------------------------------------------------------------------
 bool SdSpiCard::isBusy() {
   bool rtn = true;
+  while (writeBlockBusy()) {}
   bool spiActive = m_spiActive;
   if (!spiActive) {
     spiStart();
@@ -358,6 +384,7 @@ bool SdSpiCard::readData(uint8_t *dst) {
 }
 //------------------------------------------------------------------------------
 bool SdSpiCard::readData(uint8_t* dst, size_t count) {
+  SD_LATENCY(SD_OP_READ_DATA);
 #if USE_SD_CRC
   uint16_t crc;
 #endif  // USE_SD_CRC
@@ -500,6 +527,7 @@ fail:
 //------------------------------------------------------------------------------
 // wait for card to go not busy
 bool SdSpiCard::waitNotBusy(uint16_t timeoutMS) {
+  SD_LATENCY(SD_OP_BUSY);
   uint16_t t0 = curTimeMS();
 #if WDT_YIELD_TIME_MICROS
   // Call isTimedOut first to insure yield is called.
@@ -551,6 +579,67 @@ bool SdSpiCard::writeBlock(uint32_t blockNumber, const uint8_t* src) {
   spiStop();
   return true;
 
+fail:
+  spiStop();
+  return false;
+}
+//------------------------------------------------------------------------------
+bool SdSpiCard::writeBlockBusy() {
+  if (m_asyncState != ASYNC_SENDING) {
+    return false;
+  }
+  if (!m_spiDriver->sendDone()) {
+    return true;
+  }
+  // data is out, finish like writeBlock() without waiting for programming
+  bool accepted = writeDataEnd(m_asyncCrc);
+#if USE_SD_LATENCY_STATS
+  m_latency.record(SD_OP_WRITE_DATA, curTimeUS() - m_asyncStart);
+#endif  // USE_SD_LATENCY_STATS
+  if (accepted) {
+    m_asyncState = ASYNC_IDLE;
+  } else {
+    error(SD_CARD_ERROR_WRITE);
+    m_asyncState = ASYNC_FAILED;
+  }
+  // deselect the card and end the transaction either way, like writeBlock()
+  spiStop();
+  return false;
+}
+//------------------------------------------------------------------------------
+bool SdSpiCard::writeBlockFinish() {
+  while (writeBlockBusy()) {}
+  bool rtn = m_asyncState == ASYNC_IDLE;
+  m_asyncState = ASYNC_IDLE;
+  return rtn;
+}
+//------------------------------------------------------------------------------
+bool SdSpiCard::writeBlockStart(uint32_t blockNumber, const uint8_t* src) {
+  SD_TRACE("WA", blockNumber);
+  if (!writeBlockFinish()) {
+    return false;
+  }
+  // use address if not SDHC card
+  if (type() != SD_CARD_TYPE_SDHC) {
+    blockNumber <<= 9;
+  }
+  if (cardCommand(CMD24, blockNumber)) {
+    error(SD_CARD_ERROR_CMD24);
+    goto fail;
+  }
+#if USE_SD_CRC
+  m_asyncCrc = CRC_CCITT(src, 512);
+#else  // USE_SD_CRC
+  m_asyncCrc = 0XFFFF;
+#endif  // USE_SD_CRC
+#if USE_SD_LATENCY_STATS
+  m_asyncStart = curTimeUS();
+#endif  // USE_SD_LATENCY_STATS
+  spiSend(DATA_START_BLOCK);
+  m_spiDriver->sendAsync(src, 512);
+  m_asyncState = ASYNC_SENDING;
+  return true;
+
 fail:
   spiStop();
   return false;
@@ -590,6 +679,7 @@ fail:
 //------------------------------------------------------------------------------
 // send one block of data for write block or write multiple blocks
 bool SdSpiCard::writeData(uint8_t token, const uint8_t* src) {
+  SD_LATENCY(SD_OP_WRITE_DATA);
 #if USE_SD_CRC
   uint16_t crc = CRC_CCITT(src, 512);
 #else  // USE_SD_CRC
@@ -597,6 +687,11 @@ bool SdSpiCard::writeData(uint8_t token, const uint8_t* src) {
 #endif  // USE_SD_CRC
   spiSend(token);
   spiSend(src, 512);
+  return writeDataEnd(crc);
+}
+//------------------------------------------------------------------------------
+// send the crc of a data block and check the data response
+bool SdSpiCard::writeDataEnd(uint16_t crc) {
   spiSend(crc >> 8);
   spiSend(crc & 0XFF);
 
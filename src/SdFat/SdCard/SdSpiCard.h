@@ -24,11 +24,96 @@
  * \brief SdSpiCard class for V2 SD/SDHC cards
  */
 #include <stddef.h>
+#include <string.h>
 #include "../SysCall.h"
 #include "SdInfo.h"
 #include "../FatLib/BaseBlockDriver.h"
 #include "../SpiDriver/SdSpiDriver.h"
 //==============================================================================
+/** Card operations timed by SdSpiCard. */
+enum SdLatencyOp {
+  /** Command up to its R1 response, busy wait included. */
+  SD_OP_COMMAND = 0,
+  /** Wait for the data token and transfer of a read. */
+  SD_OP_READ_DATA,
+  /** Transfer of a written block up to its data response. */
+  SD_OP_WRITE_DATA,
+  /** Wait for the card to finish programming. */
+  SD_OP_BUSY,
+  /** Whole erase of a block range. */
+  SD_OP_ERASE,
+  /** Number of timed operations. */
+  SD_OP_COUNT
+};
+/** Histogram buckets, the first is under 32 us and each next one doubles. */
+const uint8_t SD_LATENCY_BUCKETS = 16;
+/** Operations taking at least this many microseconds count as stalls. */
+const uint32_t SD_LATENCY_STALL_US = 100000;
+/**
+ * \class SdLatency
+ * \brief Fixed size latency histograms of SD card operations.
+ */
+class SdLatency {
+ public:
+  SdLatency() {
+    reset();
+  }
+  /** \return Times \a op was timed. */
+  uint32_t count(uint8_t op) const {
+    return m_count[op];
+  }
+  /** \return Times \a op took bucket \a b, see bucketLimit(). */
+  uint32_t histogram(uint8_t op, uint8_t b) const {
+    return m_histogram[op][b];
+  }
+  /** \return Longest \a op in microseconds. */
+  uint32_t maxMicros(uint8_t op) const {
+    return m_max[op];
+  }
+  /** \return Times \a op took SD_LATENCY_STALL_US or more. */
+  uint32_t stallCount(uint8_t op) const {
+    return m_stalls[op];
+  }
+  /** \return Microseconds spent in \a op. */
+  uint64_t totalMicros(uint8_t op) const {
+    return m_total[op];
+  }
+  /** \return First microsecond count past bucket \a b, zero for the last. */
+  static uint32_t bucketLimit(uint8_t b) {
+    return b + 1 < SD_LATENCY_BUCKETS ? 32UL << b : 0;
+  }
+  /** Add an operation.
+   * \param[in] op The SdLatencyOp.
+   * \param[in] us Its duration in microseconds.
+   */
+  void record(uint8_t op, uint32_t us) {
+    uint8_t b = 0;
+    for (uint32_t n = us >> 5; n && b < SD_LATENCY_BUCKETS - 1; n >>= 1) {
+      b++;
+    }
+    m_histogram[op][b]++;
+    m_count[op]++;
+    m_total[op] += us;
+    if (us > m_max[op]) {
+      m_max[op] = us;
+    }
+    if (us >= SD_LATENCY_STALL_US) {
+      m_stalls[op]++;
+    }
+  }
+  /** Clear all counts. */
+  void reset() {
+    memset(this, 0, sizeof(SdLatency));
+  }
+
+ private:
+  uint32_t m_histogram[SD_OP_COUNT][SD_LATENCY_BUCKETS];
+  uint32_t m_count[SD_OP_COUNT];
+  uint32_t m_max[SD_OP_COUNT];
+  uint32_t m_stalls[SD_OP_COUNT];
+  uint64_t m_total[SD_OP_COUNT];
+};
+//==============================================================================
 /**
  * \class SdSpiCard
  * \brief Raw access to SD and SDHC flash memory cards via SPI protocol.
@@ -40,7 +125,8 @@ class SdSpiCard {
 #endif  // ENABLE_EXTENDED_TRANSFER_CLASS || ENABLE_SDIO_CLASS
  public:
   /** Construct an instance of SdSpiCard. */
-  SdSpiCard() : m_errorCode(SD_CARD_ERROR_INIT_NOT_CALLED), m_type(0) {}
+  SdSpiCard() : m_errorCode(SD_CARD_ERROR_INIT_NOT_CALLED), m_type(0),
+    m_asyncState(ASYNC_IDLE) {}
   /** Initialize the SD card.
    * \param[in] spi SPI driver for card.
    * \param[in] csPin card chip select pin.
@@ -98,6 +184,12 @@ class SdSpiCard {
    * \return true if busy else false.
    */
   bool isBusy();
+#if USE_SD_LATENCY_STATS || defined(DOXYGEN)
+  /** \return Latency histograms of the card operations. */
+  SdLatency* latency() {
+    return &m_latency;
+  }
+#endif  // USE_SD_LATENCY_STATS
   /**
    * Read a 512 byte block from an SD card.
    *
@@ -194,6 +286,30 @@ class SdSpiCard {
    * the value false is returned for failure.
    */
   bool writeBlock(uint32_t lba, const uint8_t* src);
+  /**
+   * Start writing a 512 byte block.  The data goes out by DMA, when
+   * USE_SD_ASYNC_WRITE is nonzero, while the caller carries on.  The card
+   * is left programming the block, isBusy() tells when it is done and any
+   * later command waits for it.
+   *
+   * \param[in] lba Logical block to be written.
+   * \param[in] src Pointer to the data, left untouched until
+   *            writeBlockBusy() returns false.
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool writeBlockStart(uint32_t lba, const uint8_t* src);
+  /** Poll the block started by writeBlockStart().
+   *
+   * \return true while its data is being sent.
+   */
+  bool writeBlockBusy();
+  /** Wait for the block started by writeBlockStart() to be sent.
+   *
+   * \return The value true is returned if the card accepted the block
+   * and the value false is returned for failure.
+   */
+  bool writeBlockFinish();
   /**
    * Write multiple 512 byte blocks to an SD card.
    *
@@ -262,6 +378,7 @@ class SdSpiCard {
 
   bool waitNotBusy(uint16_t timeoutMS);
   bool writeData(uint8_t token, const uint8_t* src);
+  bool writeDataEnd(uint16_t crc);
 
   //---------------------------------------------------------------------------
   // functions defined in SdSpiDriver.h
@@ -294,6 +411,16 @@ class SdSpiCard {
   bool    m_spiActive;
   uint8_t m_status;
   uint8_t m_type;
+  // writeBlockStart() state
+  static const uint8_t ASYNC_IDLE = 0;
+  static const uint8_t ASYNC_SENDING = 1;
+  static const uint8_t ASYNC_FAILED = 2;
+  uint8_t m_asyncState;
+  uint16_t m_asyncCrc;
+#if USE_SD_LATENCY_STATS
+  uint32_t m_asyncStart;
+  SdLatency m_latency;
+#endif  // USE_SD_LATENCY_STATS
 };
 //==============================================================================
 /**
@@ -337,6 +464,17 @@ class SdSpiCardEX : public SdSpiCard {
    * the value false is returned for failure.
    */
   bool writeBlock(uint32_t block, const uint8_t* src);
+  /**
+   * Start writing a 512 byte block, see SdSpiCard::writeBlockStart().
+   *
+   * \param[in] block Logical block to be written.
+   * \param[in] src Pointer to the data to be written.
+   * \return The value true is returned for success and
+   * the value false is returned for failure.
+   */
+  bool writeBlockStart(uint32_t block, const uint8_t* src) {
+    return syncBlocks() && SdSpiCard::writeBlockStart(block, src);
+  }
   /**
    * Read multiple 512 byte blocks from an SD card.
    *
@@ -76,8 +76,46 @@
  * Set MAINTAIN_FREE_CLUSTER_COUNT nonzero to keep the count of free clusters
  * updated.  This will increase the speed of the freeClusterCount() call
  * after the first call.  Extra flash will be required.
+ *
+ * On FAT32 the count starts from the FSINFO block and is written back to it
+ * by sync, so the first call needs no FAT scan either.
+ */
+#define MAINTAIN_FREE_CLUSTER_COUNT 1
+//------------------------------------------------------------------------------
+/**
+ * Set USE_FREE_CLUSTER_MAP nonzero to keep a count of free clusters for
+ * each group of clusters in RAM.  Groups are counted the first time the
+ * allocator reaches them, then groups with no free cluster are skipped
+ * without reading the FAT.  FREE_CLUSTER_MAP_SIZE is the number of groups,
+ * two bytes each, and sets how many clusters are in a group.
+ */
+#define USE_FREE_CLUSTER_MAP 1
+#define FREE_CLUSTER_MAP_SIZE 1024
+//------------------------------------------------------------------------------
+/**
+ * Set USE_DIR_INDEX nonzero to index directories in RAM for long file name
+ * open and create.  A directory is read once, after that open only reads
+ * the entries whose name hash matches and create goes straight to free
+ * entries.  The DIR_INDEX_SIZE eight byte entries are shared by the last
+ * four directories used.  A bigger directory is searched as before.
+ */
+#define USE_DIR_INDEX 1
+#define DIR_INDEX_SIZE 256
+//------------------------------------------------------------------------------
+/**
+ * FILE_EXTENT_CACHE_SIZE is the number of runs of contiguous clusters each
+ * open file remembers as it follows its cluster chain.  Seeks and appends
+ * inside a known run take no FAT reads.  Twelve bytes per run and file,
+ * zero disables.
  */
-#define MAINTAIN_FREE_CLUSTER_COUNT 0
+#define FILE_EXTENT_CACHE_SIZE 4
+//------------------------------------------------------------------------------
+/**
+ * Set USE_SD_LATENCY_STATS nonzero to keep latency histograms of the
+ * SdSpiCard commands, data transfers, busy waits and erases.  About 400
+ * bytes of RAM, see SdSpiCard::latency().
+ */
+#define USE_SD_LATENCY_STATS 1
 //------------------------------------------------------------------------------
 /**
  * To enable SD card CRC checking set USE_SD_CRC nonzero.
@@ -146,6 +184,16 @@
 #define USE_SEPARATE_FAT_CACHE 0
 #endif  // __arm__
 //------------------------------------------------------------------------------
+/**
+ * FAT_CACHE_BLOCKS is the number of 512 byte blocks cached by a volume.
+ * Data, FAT and directory blocks share them with least recently used
+ * replacement.  Dirty blocks are written data first, then FAT, then
+ * directory, so a file never points at data that is not on the card.
+ */
+#ifndef FAT_CACHE_BLOCKS
+#define FAT_CACHE_BLOCKS 4
+#endif  // FAT_CACHE_BLOCKS
+//------------------------------------------------------------------------------
 /**
  * Set USE_MULTI_BLOCK_IO nonzero to use multi-block SD read/write.
  *
@@ -181,6 +229,20 @@
 #define SD_HAS_CUSTOM_SPI 0
 #endif  // SD_HAS_CUSTOM_SPI
 //------------------------------------------------------------------------------
+/**
+ * Set USE_SD_ASYNC_WRITE nonzero to send the data of
+ * SdSpiCard::writeBlockStart() by DMA while the caller carries on.  Only the
+ * custom Teensy 3.x SPI driver has DMA, elsewhere writeBlockStart() sends
+ * the data before it returns.
+ */
+#if SD_HAS_CUSTOM_SPI && !USE_STANDARD_SPI_LIBRARY\
+  && (defined(__MK20DX128__) || defined(__MK20DX256__)\
+  || defined(__MK64FX512__) || defined(__MK66FX1M0__))
+#define USE_SD_ASYNC_WRITE 1
+#else  // USE_SD_ASYNC_WRITE
+#define USE_SD_ASYNC_WRITE 0
+#endif  // USE_SD_ASYNC_WRITE
+//------------------------------------------------------------------------------
 /**
  * Check if API to select HW SPI port is needed.
  */
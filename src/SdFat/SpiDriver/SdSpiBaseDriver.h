@@ -62,6 +62,18 @@ class SdSpiBaseDriver {
   * \param[in] n Number of bytes to send.
   */
   virtual void send(const uint8_t* buf, size_t n) = 0;
+  /** Start sending multiple bytes, sent before return without DMA.
+  *
+  * \param[in] buf Buffer for data to be sent.
+  * \param[in] n Number of bytes to send.
+  */
+  virtual void sendAsync(const uint8_t* buf, size_t n) {
+    send(buf, n);
+  }
+  /** \return true once the bytes of sendAsync() are out. */
+  virtual bool sendDone() {
+    return true;
+  }
   /** Set CS low. */
   virtual void select() = 0;
   /** Save SPI settings.
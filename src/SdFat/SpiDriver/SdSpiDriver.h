@@ -93,6 +93,18 @@ class SdSpiLibDriver {
       SPI.transfer(buf[i]);
     }
   }
+  /** Send multiple bytes, no DMA so they are out before return.
+   *
+   * \param[in] buf Buffer for data to be sent.
+   * \param[in] n Number of bytes to send.
+   */
+  void sendAsync(const uint8_t* buf, size_t n) {
+    send(buf, n);
+  }
+  /** \return true, sendAsync() is synchronous. */
+  bool sendDone() {
+    return true;
+  }
   /** Set CS low. */
   void select() {
     digitalWrite(m_csPin, LOW);
@@ -157,6 +169,30 @@ class SdSpiAltDriver {
    * \param[in] n Number of bytes to send.
    */
   void send(const uint8_t* buf, size_t n);
+#if USE_SD_ASYNC_WRITE
+  /** Start sending multiple bytes by DMA.
+   *
+   * \param[in] buf Buffer for data to be sent, left untouched until
+   *            sendDone() returns true.
+   * \param[in] n Number of bytes to send.
+   */
+  void sendAsync(const uint8_t* buf, size_t n);
+  /** \return true once the bytes of sendAsync() are out. */
+  bool sendDone();
+#else  // USE_SD_ASYNC_WRITE
+  /** Send multiple bytes, no DMA so they are out before return.
+   *
+   * \param[in] buf Buffer for data to be sent.
+   * \param[in] n Number of bytes to send.
+   */
+  void sendAsync(const uint8_t* buf, size_t n) {
+    send(buf, n);
+  }
+  /** \return true, sendAsync() is synchronous. */
+  bool sendDone() {
+    return true;
+  }
+#endif  // USE_SD_ASYNC_WRITE
   /** Set CS low. */
   void select() {
      digitalWrite(m_csPin, LOW);
@@ -21,6 +21,9 @@
 #if defined(__arm__) && defined(CORE_TEENSY)
 // SPI definitions
 #include "kinetis.h"
+#if USE_SD_ASYNC_WRITE
+#include "DMAChannel.h"
+#endif  // USE_SD_ASYNC_WRITE
 
 //------------------------------------------------------------------------------
 void SdSpiAltDriver::activate() {
@@ -183,6 +186,53 @@ void SdSpiAltDriver::send(const uint8_t* buf , size_t n) {
   }
 #endif  // SPI_USE_8BIT_FRAME
 }
+#if USE_SD_ASYNC_WRITE
+//------------------------------------------------------------------------------
+// Channels are allocated on first use, received bytes are dropped in rxByte.
+static DMAChannel* dmaTx = 0;
+static DMAChannel* dmaRx = 0;
+static uint8_t rxByte;
+//------------------------------------------------------------------------------
+/** SPI start sending multiple bytes by DMA */
+void SdSpiAltDriver::sendAsync(const uint8_t* buf, size_t n) {
+  if (!dmaTx) {
+    dmaTx = new DMAChannel();
+    dmaRx = new DMAChannel();
+  }
+  // empty both FIFOs, clear flags, 8-bit frames from CTAR0
+  SPI0_MCR = SPI_MCR_MSTR | SPI_MCR_CLR_RXF | SPI_MCR_CLR_TXF |
+             SPI_MCR_PCSIS(0x1F);
+  SPI0_SR = 0XFF0F0000;
+  dmaRx->source((volatile uint8_t&)SPI0_POPR);
+  dmaRx->destination(rxByte);
+  dmaRx->transferCount(n);
+  dmaRx->triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_RX);
+  dmaRx->disableOnCompletion();
+  dmaTx->sourceBuffer(buf, n);
+  dmaTx->destination((volatile uint8_t&)SPI0_PUSHR);
+  dmaTx->triggerAtHardwareEvent(DMAMUX_SOURCE_SPI0_TX);
+  dmaTx->disableOnCompletion();
+  dmaRx->enable();
+  dmaTx->enable();
+  SPI0_RSER = SPI_RSER_RFDF_RE | SPI_RSER_RFDF_DIRS |
+              SPI_RSER_TFFF_RE | SPI_RSER_TFFF_DIRS;
+}
+//------------------------------------------------------------------------------
+/** SPI check for the end of sendAsync() */
+bool SdSpiAltDriver::sendDone() {
+  // the last byte is sent once the last byte is received
+  if (!dmaRx->complete()) {
+    return false;
+  }
+  SPI0_RSER = 0;
+  dmaRx->clearComplete();
+  dmaTx->clearComplete();
+  dmaRx->disable();
+  dmaTx->disable();
+  SPI0_SR = 0XFF0F0000;
+  return true;
+}
+#endif  // USE_SD_ASYNC_WRITE
 #else  // KINETISK
 //==============================================================================
 // Use standard SPI library if not KINETISK
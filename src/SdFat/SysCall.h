@@ -46,6 +46,10 @@
 inline uint16_t curTimeMS() {
   return millis();
 }
+/** \return the time in microseconds. */
+inline uint32_t curTimeUS() {
+  return micros();
+}
 //-----------------------------------------------------------------------------
 /**
  * \class SysCall
@@ -2,6 +2,7 @@
 #include "Settings.h"
 #include "SdFat/SdFat.h"
 #include "Utils.h"
+#include "FlightLogFormat.h"
 
 #define KEY_UNIT_SYSTEM     "UNIT_SYSTEM"
 #define KEY_CLIMB_THRESHOLD "CLIMB_THRESHOLD"
@@ -12,6 +13,98 @@
 #define KEY_PILOT_NAME      "PILOT_NAME"
 #define KEY_GLIDER_TYPE     "GLIDER_TYPE"
 #define KEY_SOUND_OFF       "SOUND_OFF"
+#define KEY_LOG_RATE_HZ     "LOG_RATE_HZ"
+#define KEY_LOG_FORMAT      "LOG_FORMAT"
+#define KEY_TAKEOFF_SECONDS "TAKEOFF_SECONDS"
+#define KEY_LANDING_SECONDS "LANDING_SECONDS"
+
+#define SETTINGS_FILE "SETTINGS.TXT"
+// Parsed values of SETTINGS_FILE, used while the text file is unchanged
+#define SETTINGS_CACHE "SETTINGS.BIN"
+#define SETTINGS_CACHE_MAGIC 0x54535653
+#define SETTINGS_CACHE_VERSION 1
+// Longer lines are cut
+#define SETTINGS_LINE_SIZE 96
+#define SETTINGS_SEPARATOR "------------------------------------------"
+
+// In the order they are saved, pilot and glider in their own section
+enum SettingKey {
+	kUnitSystem = 0,
+	kClimbThreshold,
+	kSinkThreshold,
+	kBeepOnStart,
+	kSinkAlarmOn,
+	kTimezoneUtc,
+	kSoundOff,
+	kLogRateHz,
+	kLogFormat,
+	kTakeoffSeconds,
+	kLandingSeconds,
+	kPilotName,
+	kGliderType,
+	kSettingCount
+};
+static const char* const kSettingKeys[kSettingCount] = {
+	KEY_UNIT_SYSTEM,
+	KEY_CLIMB_THRESHOLD,
+	KEY_SINK_THRESHOLD,
+	KEY_BEEP_ON_START,
+	KEY_SINK_ALARM_ON,
+	KEY_TIMEZONE_UTC,
+	KEY_SOUND_OFF,
+	KEY_LOG_RATE_HZ,
+	KEY_LOG_FORMAT,
+	KEY_TAKEOFF_SECONDS,
+	KEY_LANDING_SECONDS,
+	KEY_PILOT_NAME,
+	KEY_GLIDER_TYPE
+};
+// Indexed by Settings::LogFormat
+static const char* const kLogFormats[] = { "IGC", "BINARY", "BOTH", "JOURNAL" };
+static const int kLogFormatCount = sizeof(kLogFormats) / sizeof(kLogFormats[0]);
+
+/**
+ * SETTINGS_CACHE, the values parsed from the text file along with its size
+ * and modification time. Thresholds are kept as written, in the units of
+ * the unit system, and zero when missing. Written and read by the same
+ * firmware, a new layout needs a new version.
+ */
+struct settings_cache {
+	uint32_t magic;
+	uint8_t version;
+	uint32_t textSize;
+	uint16_t textDate;
+	uint16_t textTime;
+	bool metric;
+	bool beepsOnStart;
+	bool sinkAlarmOn;
+	bool soundOff;
+	int8_t timeZone;
+	uint8_t logRate;
+	uint8_t logFormat;
+	uint8_t takeoffSeconds;
+	uint8_t landingSeconds;
+	double climbThreshold;
+	double sinkThreshold;
+	char pilotName[64];
+	char gliderModel[64];
+	uint16_t crc;
+};
+
+// Drops spaces and the line end around a string, in place
+static char* trim(char* str)
+{
+	while (*str == ' ' || *str == '\t') str++;
+	char* end = str + strlen(str);
+	while (end > str && strchr(" \t\r\n", end[-1])) end--;
+	*end = 0;
+	return str;
+}
+
+static uint16_t cacheCrc(const settings_cache& cache)
+{
+	return flightLogCrc((const uint8_t*)&cache, offsetof(settings_cache, crc));
+}
 
 Settings::Settings() { }
 Settings::~Settings() { }
@@ -27,87 +120,180 @@ void Settings::readSettings()
 {
 	if (!m_hasSdCard) return;
 	SdFile settings;
-	settings.open("SETTINGS.TXT", FILE_READ);
-	if (!settings.isOpen()) {
-		lcdPrint(m_lcd, "SETTINGS.TXT", "", true);
-		lcdPrint(m_lcd, "   MISSING!", "", false);
+	dir_t entry;
+	if (!settings.open(SETTINGS_FILE, O_READ) || !settings.dirEntry(&entry)) {
+		lcdPrint(*m_lcd, "SETTINGS.TXT", "", true);
+		lcdPrint(*m_lcd, "   MISSING!", "", false);
 		delay(2000);
 		return;
 	}
 
-	SimpleArray<String> lines;
-	String str;
-	while (settings.available()) {
-		char c = settings.read();
-		if (c == '\n') {
-			lines.push(str);
-			str = "";
-		} else {
-			str += c;
-		}
-	}
-	double climbThreshold = 0;
-	double sinkThreshold = 0;
-
-	for (int i = 0, len = lines.size(); i < len; i++) 
+	settings_cache cache;
+	if (!readCache(entry, &cache))
 	{
-		auto line = lines[i];
-		if (line.startsWith("//")) continue;
-		auto parts = StringSplit(line, '=');
-		if (parts.size() == 2) {
-			auto key = parts[0];
-			auto value = parts[1].trim();
-			if (key == KEY_UNIT_SYSTEM)
-			{
-				m_isMetricSystem = (value == "METRIC");
-			}
-			else if (key == KEY_CLIMB_THRESHOLD)
-			{
-				climbThreshold = value.toFloat();
-			}
-			else if (key == KEY_SINK_THRESHOLD)
-			{
-				sinkThreshold = value.toFloat();
-			}
-			else if (key == KEY_BEEP_ON_START)
-			{
-				m_beepsOnStart = (value == String("TRUE"));
-			}
-			else if (key == KEY_SINK_ALARM_ON)
-			{
-				m_sinkAlarmOn = (value == "TRUE");
-			}
-			else if (key == KEY_TIMEZONE_UTC)
-			{
-				m_timeZone = value.toInt();
-		 	}
-			else if (key == KEY_PILOT_NAME)
+		// Keys missing from the file keep their defaults
+		fillCache(&cache);
+		char line[SETTINGS_LINE_SIZE];
+		int16_t n;
+		while ((n = settings.fgets(line, sizeof(line))) > 0)
+		{
+			bool cut = line[n - 1] != '\n' && settings.available();
+			char* separator = strchr(line, '=');
+			if (strncmp(line, "//", 2) != 0 && separator)
 			{
-				m_pilotName = value;
+				*separator = 0;
+				parseSetting(trim(line), trim(separator + 1), &cache);
 			}
-			else if (key == KEY_GLIDER_TYPE)
-			{
-				m_gliderModel = value;
-		 	} else if (key == KEY_SOUND_OFF) {
-		 		m_soundOff = (value == "TRUE");
-		 	}
+			// Skip the rest of a cut line
+			while (cut && (n = settings.fgets(line, sizeof(line))) > 0 && line[n - 1] != '\n') {}
 		}
+		cache.textSize = entry.fileSize;
+		cache.textDate = entry.lastWriteDate;
+		cache.textTime = entry.lastWriteTime;
+		writeCache(cache);
 	}
 	settings.close();
+	applyCache(cache);
+}
 
-	if (climbThreshold > 0) {
-		if (m_isMetricSystem) {
-			m_climbThreshold = Measurement<UnitSpeed>(climbThreshold, UnitSpeed::metersPerSecond());
-		} else {
-			m_climbThreshold = Measurement<UnitSpeed>(climbThreshold, UnitSpeed::feetPerMinute());
-		}
+bool Settings::readCache(const dir_t& entry, settings_cache* cache)
+{
+	SdFile file;
+	if (!file.open(SETTINGS_CACHE, O_READ)) return false;
+	bool valid = file.read(cache, sizeof(settings_cache)) == sizeof(settings_cache);
+	file.close();
+	return valid &&
+		cache->magic == SETTINGS_CACHE_MAGIC &&
+		cache->version == SETTINGS_CACHE_VERSION &&
+		cache->crc == cacheCrc(*cache) &&
+		cache->textSize == entry.fileSize &&
+		cache->textDate == entry.lastWriteDate &&
+		cache->textTime == entry.lastWriteTime;
+}
+
+void Settings::writeCache(settings_cache& cache)
+{
+	cache.magic = SETTINGS_CACHE_MAGIC;
+	cache.version = SETTINGS_CACHE_VERSION;
+	cache.crc = cacheCrc(cache);
+	SdFile file;
+	if (!file.open(SETTINGS_CACHE, O_CREAT | O_WRITE | O_TRUNC)) return;
+	file.write(&cache, sizeof(settings_cache));
+	file.close();
+}
+
+void Settings::fillCache(settings_cache* cache)
+{
+	// Zeroed padding keeps the crc stable
+	memset(cache, 0, sizeof(settings_cache));
+	cache->metric = m_isMetricSystem;
+	cache->beepsOnStart = m_beepsOnStart;
+	cache->sinkAlarmOn = m_sinkAlarmOn;
+	cache->soundOff = m_soundOff;
+	cache->timeZone = m_timeZone;
+	cache->logRate = m_logRate;
+	cache->logFormat = m_logFormat;
+	cache->takeoffSeconds = m_takeoffSeconds;
+	cache->landingSeconds = m_landingSeconds;
+	strncpy(cache->pilotName, m_pilotName.c_str(), sizeof(cache->pilotName) - 1);
+	strncpy(cache->gliderModel, m_gliderModel.c_str(), sizeof(cache->gliderModel) - 1);
+}
+
+void Settings::parseSetting(const char* key, const char* value, settings_cache* cache)
+{
+	int setting = 0;
+	while (setting < kSettingCount && strcmp(key, kSettingKeys[setting]) != 0) {
+		setting++;
 	}
-	if (sinkThreshold < 0) {
-		if (m_isMetricSystem) {
-			m_sinkThreshold = Measurement<UnitSpeed>(sinkThreshold, UnitSpeed::metersPerSecond());
-		} else {
-			m_sinkThreshold = Measurement<UnitSpeed>(sinkThreshold, UnitSpeed::feetPerMinute());
-		}
+	switch (setting)
+	{
+		case kUnitSystem:
+			cache->metric = strcmp(value, "METRIC") == 0;
+			break;
+		case kClimbThreshold:
+			cache->climbThreshold = atof(value);
+			break;
+		case kSinkThreshold:
+			cache->sinkThreshold = atof(value);
+			break;
+		case kBeepOnStart:
+			cache->beepsOnStart = strcmp(value, "TRUE") == 0;
+			break;
+		case kSinkAlarmOn:
+			cache->sinkAlarmOn = strcmp(value, "TRUE") == 0;
+			break;
+		case kTimezoneUtc:
+			cache->timeZone = constrain(atoi(value), -12, 14);
+			break;
+		case kSoundOff:
+			cache->soundOff = strcmp(value, "TRUE") == 0;
+			break;
+		case kLogRateHz:
+			cache->logRate = constrain(atoi(value), 1, 10);
+			break;
+		case kLogFormat:
+			for (int i = 0; i < kLogFormatCount; i++) {
+				if (strcmp(value, kLogFormats[i]) == 0) cache->logFormat = i;
+			}
+			break;
+		case kTakeoffSeconds:
+			cache->takeoffSeconds = constrain(atoi(value), 1, 60);
+			break;
+		case kLandingSeconds:
+			cache->landingSeconds = constrain(atoi(value), 1, 60);
+			break;
+		case kPilotName:
+			strncpy(cache->pilotName, value, sizeof(cache->pilotName) - 1);
+			break;
+		case kGliderType:
+			strncpy(cache->gliderModel, value, sizeof(cache->gliderModel) - 1);
+			break;
+		default:
+			break;
+	}
+}
+
+void Settings::applyCache(const settings_cache& cache)
+{
+	m_isMetricSystem = cache.metric;
+	m_beepsOnStart = cache.beepsOnStart;
+	m_sinkAlarmOn = cache.sinkAlarmOn;
+	m_soundOff = cache.soundOff;
+	m_timeZone = cache.timeZone;
+	m_logRate = cache.logRate;
+	m_logFormat = cache.logFormat;
+	m_takeoffSeconds = cache.takeoffSeconds;
+	m_landingSeconds = cache.landingSeconds;
+	m_pilotName = cache.pilotName;
+	m_gliderModel = cache.gliderModel;
+
+	const UnitSpeed& unit = m_isMetricSystem ? UnitSpeed::metersPerSecond() : UnitSpeed::feetPerMinute();
+	if (cache.climbThreshold > 0) {
+		m_climbThreshold = Measurement<UnitSpeed>(cache.climbThreshold, unit);
+	}
+	if (cache.sinkThreshold < 0) {
+		m_sinkThreshold = Measurement<UnitSpeed>(cache.sinkThreshold, unit);
+	}
+}
+
+void Settings::printSetting(Print& out, int setting)
+{
+	switch (setting)
+	{
+		case kUnitSystem: out.print(m_isMetricSystem ? "METRIC" : "IMPERIAL"); break;
+		case kClimbThreshold: out.print(m_climbThreshold.value()); break;
+		case kSinkThreshold: out.print(m_sinkThreshold.value()); break;
+		case kBeepOnStart: out.print(m_beepsOnStart ? "TRUE" : "FALSE"); break;
+		case kSinkAlarmOn: out.print(m_sinkAlarmOn ? "TRUE" : "FALSE"); break;
+		case kTimezoneUtc: out.print(m_timeZone); break;
+		case kSoundOff: out.print(m_soundOff ? "TRUE" : "FALSE"); break;
+		case kLogRateHz: out.print(m_logRate); break;
+		case kLogFormat: out.print(kLogFormats[m_logFormat]); break;
+		case kTakeoffSeconds: out.print(m_takeoffSeconds); break;
+		case kLandingSeconds: out.print(m_landingSeconds); break;
+		case kPilotName: out.print(m_pilotName); break;
+		case kGliderType: out.print(m_gliderModel); break;
+		default: break;
 	}
 }
 
@@ -116,9 +302,7 @@ void Settings::saveSettings()
 	if (!m_hasSdCard) return;
 
 	SdFile settings;
-	settings.open("SETTINGS.TXT", O_WRITE | O_CREAT);
-	settings.remove();
-	settings.open("SETTINGS.TXT", O_WRITE | O_CREAT);
+	if (!settings.open(SETTINGS_FILE, O_WRITE | O_CREAT | O_TRUNC)) return;
 
 	if (m_isMetricSystem) {
 		m_climbThreshold = m_climbThreshold.convertedTo(UnitSpeed::metersPerSecond());
@@ -128,28 +312,30 @@ void Settings::saveSettings()
 		m_sinkThreshold = m_sinkThreshold.convertedTo(UnitSpeed::feetPerMinute());
 	}
 
-	settings.println("------------------------------------------");
-	settings.println(String(KEY_UNIT_SYSTEM) + String("=") + String(m_isMetricSystem ? "METRIC" : "IMPERIAL"));
-	settings.println(String(KEY_CLIMB_THRESHOLD) + String("=") + String(m_climbThreshold.value()));
-	settings.println(String(KEY_SINK_THRESHOLD) + String("=") + String(m_sinkThreshold.value()));
-	settings.println(String(KEY_BEEP_ON_START) + String("=") + String(m_beepsOnStart ? "TRUE" : "FALSE"));
-	settings.println(String(KEY_SINK_ALARM_ON) + String("=") + String(m_sinkAlarmOn ? "TRUE" : "FALSE"));
-	settings.println(String(KEY_TIMEZONE_UTC) + String("=") + String(m_timeZone));
-	settings.println(String(KEY_SOUND_OFF) + String("=") + String(m_soundOff ? "TRUE" : "FALSE"));
-	settings.println("------------------------------------------");
-	settings.println(String(KEY_PILOT_NAME) + String("=") + m_pilotName);
-	settings.println(String(KEY_GLIDER_TYPE) + String("=") + m_gliderModel);
-	settings.println("------------------------------------------");
-
+	settings.println(SETTINGS_SEPARATOR);
+	for (int setting = 0; setting < kSettingCount; setting++)
+	{
+		if (setting == kPilotName) settings.println(SETTINGS_SEPARATOR);
+		settings.print(kSettingKeys[setting]);
+		settings.print('=');
+		printSetting(settings, setting);
+		settings.println();
+	}
+	settings.println(SETTINGS_SEPARATOR);
 	settings.close();
+
+	// The next boot parses the new text, without the time set files
+	// written here can all have the same date
+	SdFile cache;
+	if (cache.open(SETTINGS_CACHE, O_WRITE)) cache.remove();
 }
 
 void Settings::printYesNo(bool yes)
 {
 	if (yes) {
-		lcdPrint(m_lcd, "   NO   >YES<   ", "", false);
+		lcdPrint(*m_lcd, "   NO   >YES<   ", "", false);
 	} else {
-		lcdPrint(m_lcd, "  >NO<   YES    ", "", false);
+		lcdPrint(*m_lcd, "  >NO<   YES    ", "", false);
 	}
 }
 
@@ -173,13 +359,14 @@ void Settings::promtSecondaryMenu()
 	m_isMetricSystem = promtConfirmation("Metric system?", m_isMetricSystem);
 	m_sinkAlarmOn = promtConfirmation("Sink Alarm?", m_sinkAlarmOn);
 	m_beepsOnStart = promtConfirmation("Beep on start?", m_beepsOnStart);	
+	m_runCardBenchmark = m_hasSdCard && promtConfirmation("Card benchmark?", false);
 	saveSettings();
 }
 
 bool Settings::promtConfirmation(const String& title, bool def)
 {
 	bool result = def;
-	lcdPrint(m_lcd, title, "", true);
+	lcdPrint(*m_lcd, title, "", true);
 	printYesNo(def);
 	while (true) {
 		auto upButton = upButtonPressed();
@@ -203,8 +390,8 @@ void Settings::promptAltitudeMenu()
 		m_altitude.convertedTo(UnitLength::meters()) : 
 		m_altitude.convertedTo(UnitLength::feet());
 	
-	lcdPrint(m_lcd, "Current Alt:", "", true);
-	lcdPrint(m_lcd, "", m_altitude.description(), false);
+	lcdPrint(*m_lcd, "Current Alt:", "", true);
+	lcdPrint(*m_lcd, "", m_altitude, false);
 	while (true) 
 	{
 		auto upButton = m_buttonUp.isPressing();
@@ -222,7 +409,7 @@ void Settings::promptAltitudeMenu()
 				Measurement<UnitLength>(result, UnitLength::meters()) :
 				Measurement<UnitLength>(result, UnitLength::feet());	
 
-			lcdPrint(m_lcd, "", m_altitude.description(), false);
+			lcdPrint(*m_lcd, "", m_altitude, false);
 
 		} else if (menuButtonPressed()) {
 			delay(250);
@@ -237,8 +424,8 @@ void Settings::promptThresholdMenu(bool climbThreshold)
 		threshold.convertedTo(UnitSpeed::metersPerSecond(), 0.02) : 
 		threshold.convertedTo(UnitSpeed::feetPerMinute());
 
-	lcdPrint(m_lcd, climbThreshold ? "Climb Threshold:" : "Sink Threshold:" , "", true);
-	lcdPrint(m_lcd, "", threshold.description(), false);
+	lcdPrint(*m_lcd, climbThreshold ? "Climb Threshold:" : "Sink Threshold:" , "", true);
+	lcdPrint(*m_lcd, "", threshold, false);
 	while (true) 
 	{
 		auto upButton = m_buttonUp.isPressing();
@@ -267,7 +454,7 @@ bool Settings::countTo(int count, int num) {
 	return count >= num && (count % num) == 0;
 }
 
-double Settings::startCounter(double startAt, bool decrement, bool isMetersPerSecond, String& symbol) 
+double Settings::startCounter(double startAt, bool decrement, bool isMetersPerSecond, const char* symbol) 
 {
 	if (isMetersPerSecond) startAt /= 0.02;
 
@@ -301,11 +488,13 @@ double Settings::startCounter(double startAt, bool decrement, bool isMetersPerSe
 		} else {
 			result = isMetersPerSecond ? startAt + double(count) : (double)(round(startAt) + double(count));
 		}
+		char text[MEASUREMENT_TEXT_SIZE];
 		if (isMetersPerSecond) {
-			lcdPrint(m_lcd, "", String(result * 0.02, 2) + symbol, false);
+			formatMeasure(text, sizeof(text), result * 0.02, 0.02, 2, symbol);
 		} else {
-			lcdPrint(m_lcd, "", String(result, 0) + symbol, false);
+			formatMeasure(text, sizeof(text), result, 1, 0, symbol);
 		}
+		lcdPrint(*m_lcd, "", text, false);
 	}
 	return isMetersPerSecond ? (result * 0.02) : round(result);
 }
@@ -5,12 +5,23 @@
 #include "Units/UnitSpeed.h"
 #include "Units/UnitLength.h"
 #include "Units/Measurement.h"
-#include "LiquidCrystal_I2C.h"
+#include "Display.h"
 #include "Button.h"
+#include "SdFat/SdFat.h"
+
+struct settings_cache;
 
 class Settings
 {
 public:
+	// LOG_FORMAT values
+	enum LogFormat {
+		kLogIGC = 0,
+		kLogBinary,
+		kLogBoth,
+		kLogJournal
+	};
+
 	Settings();
 	~Settings();
 	void begin(int menuButtonPin, int upButtonPin, int downButtonPin);
@@ -34,24 +45,39 @@ public:
 	const bool sinkAlarmOn() { return m_sinkAlarmOn; }
 	const int timeZone() { return  m_timeZone; }
 	const bool soundOff() { return m_soundOff; }
+	const int logRate() { return m_logRate; }
+	const bool logsIGC() { return m_logFormat == kLogIGC || m_logFormat == kLogBoth; }
+	const bool logsBinary() { return m_logFormat == kLogBinary || m_logFormat == kLogBoth; }
+	const bool logsJournal() { return m_logFormat == kLogJournal; }
+	const int takeoffSeconds() { return m_takeoffSeconds; }
+	const int landingSeconds() { return m_landingSeconds; }
+	// Asked for in the last secondary menu
+	const bool cardBenchmarkRequested() { return m_runCardBenchmark; }
 	String pilotName() const { return m_pilotName; }
 	const String gliderModel() { return m_gliderModel; }
 	const Measurement<UnitSpeed> climbThreshold() { return m_climbThreshold; }
 	const Measurement<UnitSpeed> sinkThreshold() { return m_sinkThreshold; }
 	const Measurement<UnitLength> altitude() { return m_altitude; }
 	void setAltitude(Measurement<UnitLength>& altitude) { m_altitude = altitude; }
-	void setLCD(LiquidCrystal_I2C& lcd) { m_lcd = lcd; }
+	void setLCD(Display& lcd) { m_lcd = &lcd; }
 	void setGPSAlt(double meters) { m_gpsAlt = meters; }
 	void saveSettings();
 private:
 	bool countTo(int count, int num);
-	double startCounter(double startAt, bool decrement, bool isMetersPerSecond, String& symbol);
+	double startCounter(double startAt, bool decrement, bool isMetersPerSecond, const char* symbol);
 	void promptThresholdMenu(bool climbThreshold);
 	void promptGPSAltitudeMenu();
 	void promptAltitudeMenu();
 	bool promtConfirmation(const String& title, bool def);
 	void printYesNo(bool yes);
-	LiquidCrystal_I2C m_lcd { LiquidCrystal_I2C(0,0,0) };
+	bool readCache(const dir_t& entry, settings_cache* cache);
+	void writeCache(settings_cache& cache);
+	void fillCache(settings_cache* cache);
+	void parseSetting(const char* key, const char* value, settings_cache* cache);
+	void applyCache(const settings_cache& cache);
+	void printSetting(Print& out, int setting);
+	// The display's shadow buffer has to be the one of the sketch
+	Display* m_lcd { NULL };
 	Button m_buttonMenu;
 	Button m_buttonUp;
 	Button m_buttonDown;
@@ -81,12 +107,27 @@ private:
 	int m_timeZone {
 		-7
 	};
+	int m_logRate {
+		1
+	};
+	uint8_t m_logFormat {
+		kLogIGC
+	};
+	int m_takeoffSeconds {
+		10
+	};
+	int m_landingSeconds {
+		30
+	};
 	double m_gpsAlt {
 		0.0
 	};
 	bool m_hasSdCard {
 		false
 	};
+	bool m_runCardBenchmark {
+		false
+	};
 
 	String m_pilotName {
 		"Pedro Enrique"
@@ -30,6 +30,7 @@ static String GPRMC = "$GPRMC";
 #define P_GPS_DATE 9
 #define P_GPS_SPEED 7
 #define P_GPS_HEADING 8
+#define P_GPS_HOR_ACC 16
 #define P_GPS_ALT_ACC 17
 
 SimpleGPS::SimpleGPS(SoftwareSerial* serial) {
@@ -54,10 +55,41 @@ void SimpleGPS::begin()
 	delay(100);
 	m_serial->println("$PMTK220,250*29");
 	m_info[kTimestamp] = "000000";
+	m_info[kTimestampTenths] = "0";
 	m_info[kDate] = "0";
 	resetValues();
 }
 
+void SimpleGPS::setUpdateRate(int hz)
+{
+	if (hz < 1) hz = 1;
+	if (hz > 10) hz = 10;
+	// Three sentences at more than 4Hz no longer fit in 9600 baud
+	if (hz > 4) {
+		delay(100);
+		sendCommand("PMTK251,38400");
+		delay(100);
+		m_serial->begin(38400);
+	}
+	delay(100);
+	sendCommand("PMTK220," + String(1000 / hz));
+	m_updateRate = hz;
+}
+
+void SimpleGPS::sendCommand(const String& body)
+{
+	uint8_t checksum = 0;
+	for (unsigned int i = 0; i < body.length(); i++) {
+		checksum ^= body[i];
+	}
+	String hex(checksum, HEX);
+	hex.toUpperCase();
+	if (hex.length() == 1) {
+		hex = "0" + hex;
+	}
+	m_serial->println("$" + body + "*" + hex);
+}
+
 void SimpleGPS::resetValues()
 {
 	m_info[kAltitude] = "00000";
@@ -67,6 +99,8 @@ void SimpleGPS::resetValues()
 	m_info[kLongitude] = "00000000W";
 	m_info[kHeading] = "0.0";
 	m_info[kSpeed] = "0.0";
+	m_info[kSatellites] = "0";
+	m_info[kHorizontalAccuracy] = "1000";
 }
 
 bool SimpleGPS::update()
@@ -140,6 +174,10 @@ void SimpleGPS::parse() {
 			if (tmp.length() > 5) {
 				m_info[kTimestamp] = tmp.substring(0, 6);
 			}
+			// 123519.20 - tenths are only meaningful above 1Hz
+			if (tmp.length() > 7) {
+				m_info[kTimestampTenths] = tmp.substring(7, 8);
+			}
 		}
 		{
 			auto tmp = parts[P_GPS_LAT_GGA_NUM];
@@ -166,6 +204,10 @@ void SimpleGPS::parse() {
 				resetValues();
 			}
 		}
+		{
+			auto sats = parts[P_GPS_SATS];
+			m_info[kSatellites] = sats.length() > 0 ? sats : "0";
+		}
 		{
 			auto m = parts[P_GPS_ALT];
 			if (m.length() == 0) {
@@ -174,6 +216,7 @@ void SimpleGPS::parse() {
 			m_info[kMetersAltitude] = m;
 			m_info[kAltitude] = toIGCMeters(m_info[kMetersAltitude]);
 		}
+		m_fixCount++;
 		return;
 	}
 	/**
@@ -199,6 +242,11 @@ void SimpleGPS::parse() {
 			}
 			m_info[kAltitudeAccuracy] = acc;
 
+			auto hdop = parts[P_GPS_HOR_ACC];
+			if (hdop.length() == 0) {
+				hdop = "999";
+			}
+			m_info[kHorizontalAccuracy] = hdop;
 		}
 		return;
 	} 
@@ -258,6 +306,14 @@ void SimpleGPS::parse() {
 	} 
 }
 
+double SimpleGPS::latitude() const {
+	return igcToDecimal(m_info[kLatitude]);
+}
+
+double SimpleGPS::longitude() const {
+	return igcToDecimal(m_info[kLongitude]);
+}
+
 String SimpleGPS::toIGC(double baroMeters) {
 	auto alt_baro = toIGCMeters(String(baroMeters));
 	auto alt_gps = toIGCMeters(m_info[kMetersAltitude]);
@@ -267,15 +323,22 @@ String SimpleGPS::toIGC(double baroMeters) {
 	}
 	return r;
 }
+// Whole meters in five characters, 00123 or -0012 below sea level
 String SimpleGPS::toIGCMeters(String meters)
 {
-	if (meters.indexOf('.') != -1) {
-		meters.remove(meters.indexOf('.'));
+	long value = constrain(meters.toInt(), -9999L, 99999L);
+	char text[6];
+	char* out = text;
+	int width = 5;
+	if (value < 0) {
+		*out++ = '-';
+		value = -value;
+		width--;
 	}
-	auto diff = 5 - meters.length();
-	String zeros("");
-	for (unsigned int i = 0; i <diff; i++) {
-		zeros += "0";
+	for (int i = width - 1; i >= 0; i--) {
+		out[i] = '0' + value % 10;
+		value /= 10;
 	}
-	return zeros + meters;
+	out[width] = '\0';
+	return String(text);
 }
@@ -22,12 +22,23 @@ class SimpleGPS {
 		kDate = 5,
 		kMetersAltitude = 6,
 		kAltitudeAccuracy = 7,
-		kHeading = 8
+		kHeading = 8,
+		kSatellites = 9,
+		kHorizontalAccuracy = 10,
+		kTimestampTenths = 11
 	};
 	SimpleGPS() {};
 	SimpleGPS(SoftwareSerial* serial);
 	void begin();
+	void setUpdateRate(int hz);
+	int updateRate() const {
+		return m_updateRate;
+	}
 	bool update();
+	// GGA sentences parsed, one per fix the module sends, with a position or not
+	inline uint32_t fixCount() const {
+		return m_fixCount;
+	}
 	inline bool fixed() const {
 		return m_fixed;
 	}	
@@ -43,6 +54,15 @@ class SimpleGPS {
 	inline double altitudeAccuracy() {
 		return String(m_info[kAltitudeAccuracy]).toFloat();
 	}
+	inline double horizontalAccuracy() const {
+		return m_info[kHorizontalAccuracy].toFloat();
+	}
+	inline int satellites() const {
+		return m_info[kSatellites].toInt();
+	}
+	inline int tenths() const {
+		return m_info[kTimestampTenths].toInt();
+	}
 	inline double knots() const {
 		return m_info[kSpeed].toFloat();
 	}
@@ -74,17 +94,23 @@ class SimpleGPS {
 		auto a = m_info[kHeading];
 		return a.length() > 0 ? a : "0";
 	}
+	double latitude() const;
+	double longitude() const;
 	String toIGC(double baroMeters);
  private:
 	String toIGCMeters(String meters);
+	void sendCommand(const String& body);
 
 #ifdef P_TESTING
  	double m_timer {0};
 #endif
 	 SoftwareSerial* m_serial {NULL};
-	 String m_info[11];
+	 String m_info[12];
 	 String m_sentance;
 	 bool m_fixed;
+	 uint32_t m_fixCount {0};
+	 // begin() sets 4Hz
+	 int m_updateRate {4};
 	 void parse();
 	 void resetValues();
  };
@@ -6,50 +6,112 @@
 #ifndef Meassurement_h
 #define Meassurement_h
 
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
 #include "Unit.h"
 
+// Longest description() with its terminator
+#define MEASUREMENT_TEXT_SIZE 24
+// Most digits after the point formatMeasure() writes
+#define MEASUREMENT_MAX_DECIMALS 4
+
+/**
+ * `value` rounded to a multiple of `step`, or cut when `step` is -1, with
+ * `decimals` digits after the point and `suffix`, right aligned in `width`
+ * characters. The value is rounded once to a count of steps and written
+ * from that integer, so nothing is allocated. Returns the length, or
+ * 0 with an empty buffer when it does not fit in `size`.
+ */
+inline size_t formatMeasure(char* buffer, size_t size, double value, double step, uint8_t decimals,
+	const char* suffix, uint8_t width = 0)
+{
+	if (size == 0) return 0;
+	buffer[0] = '\0';
+	if (decimals > MEASUREMENT_MAX_DECIMALS) decimals = MEASUREMENT_MAX_DECIMALS;
+	long scale = 1;
+	for (uint8_t i = 0; i < decimals; i++) scale *= 10;
+
+	double scaled = value * scale;
+	if (isnan(scaled) || fabs(scaled) >= 2000000000.0) return 0;
+	long units;
+	long steps = step > 0 ? lround(step * scale) : 0;
+	if (step == -1.0) {
+		units = (long)scaled;
+	} else if (steps > 0) {
+		// Whole steps once, then exact in the last digit
+		units = lround(value / step) * steps;
+	} else {
+		units = lround(scaled);
+	}
+	bool negative = units < 0;
+	unsigned long magnitude = negative ? -units : units;
+
+	// Digits backwards, at least one before the point
+	char digits[16];
+	uint8_t count = 0;
+	do {
+		digits[count++] = '0' + magnitude % 10;
+		magnitude /= 10;
+	} while (magnitude > 0 || count <= decimals);
+
+	size_t suffixLength = suffix ? strlen(suffix) : 0;
+	size_t length = negative + count + (decimals > 0) + suffixLength;
+	size_t padding = width > length ? width - length : 0;
+	if (padding + length + 1 > size) return 0;
+
+	char* out = buffer;
+	memset(out, ' ', padding);
+	out += padding;
+	if (negative) *out++ = '-';
+	while (count > 0) {
+		if (count == decimals) *out++ = '.';
+		*out++ = digits[--count];
+	}
+	if (suffixLength) memcpy(out, suffix, suffixLength);
+	out[suffixLength] = '\0';
+	return padding + length;
+}
+
 template<class T>
 class Measurement
 {
 public:
-	Measurement(double value, T unit, double r = -1.0) : m_unit(unit), m_value(value), m_roundTo(r) { }
-	Measurement convertedTo(T otherUnit, double roundTo = -1.0) {
-		double fromBase = m_unit.baseUnitValue(m_value);
-		double toBase = otherUnit.value(fromBase);
-		return Measurement(toBase, otherUnit, roundTo);
+	constexpr Measurement(double value, T unit, double r = -1.0) : m_unit(unit), m_value(value), m_roundTo(r) { }
+	constexpr Measurement convertedTo(T otherUnit, double roundTo = -1.0) const {
+		return Measurement(m_unit.convert(m_value, otherUnit), otherUnit, roundTo);
 	}
-	double value() {
+	constexpr double value() const {
 		return m_value;
 	}
-	T unit() {
+	constexpr T unit() const {
 		return m_unit;
 	}
-	T baseUnit() {
+	constexpr T baseUnit() const {
 		return m_unit.base();
 	}
 	void roundTo(double r) 
 	{
-		m_roundTo = round;
+		m_roundTo = r;
 	}
 
-	String description() {
-#ifdef ARDUINO
-		if (m_roundTo == -1.0) {
-			return String(int(m_value)) + m_unit.symbol();
-		} else {
-			double roundTo = 1.0 / m_roundTo;
-			auto result = round(m_value * roundTo) / roundTo;
-			if (ceil(m_roundTo) == m_roundTo) {
-				return String(int(result)) + m_unit.symbol();
-			}
-			return String(result) + m_unit.symbol();
-		}
-#else
-		size_t count = std::to_string(m_value).size();
-		char buffer[count];
-		sprintf(buffer, "%.2f", m_value);
-		return String(buffer) + " " + m_unit.symbol();
-#endif
+	// Digits after the point: none when rounded to a whole step or not
+	// rounded, two otherwise
+	uint8_t decimals() const {
+		return m_roundTo == -1.0 || ceil(m_roundTo) == m_roundTo ? 0 : 2;
+	}
+	// Value and symbol into `buffer`, rounded as set and right aligned in
+	// `width` characters when given. Allocates nothing, returns the length
+	// or 0 when it does not fit. `precision` overrides decimals().
+	size_t formatTo(char* buffer, size_t size, int8_t precision = -1, uint8_t width = 0) const {
+		return formatMeasure(buffer, size, m_value, m_roundTo, precision < 0 ? decimals() : precision,
+			m_unit.symbol(), width);
+	}
+	String description() const {
+		char buffer[MEASUREMENT_TEXT_SIZE];
+		formatTo(buffer, sizeof(buffer));
+		return String(buffer);
 	}
 private:
 	T m_unit;
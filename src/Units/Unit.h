@@ -13,34 +13,51 @@
 typedef std::string String;
 #endif
 
+/**
+ * A unit is its symbol and how it converts to the base unit of its kind,
+ * `base = coefficient * value + constant`.
+ *
+ * Units are constexpr values with their symbol in flash, the factories of
+ * UnitSpeed, UnitLength and UnitDuration build nothing at run time. With
+ * both units known, as in `x.convertedTo(UnitSpeed::knots())`, the
+ * conversion folds to one multiply.
+ */
 template<class Derived>
 class Unit
 {
 public:
-	Unit(const String& symbol, double coefficient, double constant) {
-		m_symbol = symbol;
-		m_coefficient = coefficient;
-		m_constant = constant;
-	}
-	const String symbol() {
+	constexpr Unit(const char* symbol, double coefficient, double constant) :
+		m_symbol(symbol), m_coefficient(coefficient), m_constant(constant) { }
+	constexpr const char* symbol() const {
 		return m_symbol;
 	}
-	double coefficient() {
+	constexpr double coefficient() const {
 		return m_coefficient;
 	}
-	double constant() {
+	constexpr double constant() const {
 		return m_constant;
 	}
-	double baseUnitValue(double from) {
+	constexpr double baseUnitValue(double from) const {
 		return m_coefficient * from + m_constant;
 	}
-	double value(double fromBase) {
+	constexpr double value(double fromBase) const {
 		return (fromBase - m_constant) / m_coefficient;
 	}
-	
-	virtual Derived base() = 0;
+	// Multiplier from this unit to `other`
+	constexpr double factorTo(const Unit& other) const {
+		return m_coefficient / other.m_coefficient;
+	}
+	// `from` in this unit to `other`, the factor and offset are constants
+	// when both units are
+	constexpr double convert(double from, const Unit& other) const {
+		return m_constant == other.m_constant ? from * factorTo(other) :
+			from * factorTo(other) + (m_constant - other.m_constant) / other.m_coefficient;
+	}
+	constexpr Derived base() const {
+		return Derived::baseUnit();
+	}
 private:
-	String m_symbol;
+	const char* m_symbol;
 	double m_coefficient;
 	double m_constant;
 };
@@ -11,34 +11,34 @@
 class UnitDuration : public Unit<UnitDuration>
 {
 public:
-	UnitDuration(const char* symbol, double coefficient, double constant = 0) :
+	constexpr UnitDuration(const char* symbol, double coefficient, double constant = 0) :
 	Unit(symbol, coefficient, constant) { }
 	
-	UnitDuration base() {
-		return UnitDuration::seconds();
+	static constexpr UnitDuration baseUnit() {
+		return seconds();
 	}
-	static UnitDuration microseconds() {
-		return UnitDuration("μs", 0.0001);
+	static constexpr UnitDuration microseconds() {
+		return UnitDuration("μs", 0.000001);
 	}
-	static UnitDuration milliseconds() {
+	static constexpr UnitDuration milliseconds() {
 		return UnitDuration("ms", 0.001);
 	}
-	static UnitDuration centiseconds() {
+	static constexpr UnitDuration centiseconds() {
 		return UnitDuration("cs", 0.01);
 	}
-	static UnitDuration deciseconds() {
+	static constexpr UnitDuration deciseconds() {
 		return UnitDuration("ds", 0.1);
 	}
-	static UnitDuration seconds() {
+	static constexpr UnitDuration seconds() {
 		return UnitDuration("sec", 1.0);
 	}
-	static UnitDuration minutes() {
+	static constexpr UnitDuration minutes() {
 		return UnitDuration("min", 60.0);
 	}
-	static UnitDuration hours() {
+	static constexpr UnitDuration hours() {
 		return UnitDuration("hr", 3600.0);
 	}
-	static UnitDuration day() {
+	static constexpr UnitDuration day() {
 		return UnitDuration("day", 86400.0);
 	}
 	
@@ -11,25 +11,25 @@
 class UnitSpeed : public Unit<UnitSpeed>
 {
 public:
-	UnitSpeed(const char* symbol, double coefficient, double constant = 0.0) :
+	constexpr UnitSpeed(const char* symbol, double coefficient, double constant = 0.0) :
 	Unit(symbol, coefficient, constant) { }
 	
-	UnitSpeed base() {
-		return UnitSpeed::metersPerSecond();
+	static constexpr UnitSpeed baseUnit() {
+		return metersPerSecond();
 	}
-	static UnitSpeed metersPerSecond() {
+	static constexpr UnitSpeed metersPerSecond() {
 		return UnitSpeed("mps", 1.0);
 	}
-	static UnitSpeed kilometersPerHour() {
+	static constexpr UnitSpeed kilometersPerHour() {
 		return UnitSpeed("kmh", 0.277778);
 	}
-	static UnitSpeed milesPerHour() {
+	static constexpr UnitSpeed milesPerHour() {
 		return UnitSpeed("mph", 0.447040);
 	}
-	static UnitSpeed knots() {
+	static constexpr UnitSpeed knots() {
 		return UnitSpeed("kn", 0.514444);
 	}
-	static UnitSpeed feetPerMinute() {
+	static constexpr UnitSpeed feetPerMinute() {
 		return UnitSpeed("fpm", 0.00508);
 	}
 };
@@ -9,7 +9,9 @@
 #include <Arduino.h>
 #include "TimeLib.h"
 #include "SimpleArray.h"
-#include "LiquidCrystal_I2C.h"
+#include "Display.h"
+#include "Units/Measurement.h"
+#include "ClockFormat.h"
 
 static SimpleArray<String> StringSplit(String str, char deli) 
 {
@@ -31,36 +33,91 @@ static inline String iString(int n)
 {
 	return String(n).length() == 1 ? String("0") + String(n) : String(n);
 }
+
+static inline void formatTime(char* buffer)
+{
+	formatClock(buffer, hour(), minute(), second());
+}
 static inline String readableTime() 
 {
-	return iString(hour()) + ":" + iString(minute()) + ":" + iString(second());
+	char buffer[CLOCK_TEXT_SIZE];
+	formatTime(buffer);
+	return String(buffer);
 }
-
-static void lcdPrint(LiquidCrystal_I2C& lcd, const String& left, const String& right, bool firstLine) 
+static inline String readableDuration(unsigned long seconds)
 {
-	static String _left1("");
-	static String _left2("");
-	static String _right1("");
-	static String _right2("");
+	char buffer[CLOCK_TEXT_SIZE];
+	formatDuration(buffer, seconds);
+	return String(buffer);
+}
 
-	if (firstLine) {
-		if (_left1 == left && _right1 == right) return;
-		_left1 = left;
-		_right1 = right;
-	} else {
-		if (_left2 == left && _right2 == right) return;
-		_left2 = left;
-		_right2 = right;
-	}
-	auto spaces = 16 - left.length() - right.length();
-	if (spaces < 0) return;
+#define earthRadiusKm 6371.0
+#define deg2rad(DEG) (DEG * M_PI / 180)
 
-	String spacesString = "";
-	while (spaces--) {
-		spacesString += " ";
-	}
-	lcd.setCursor(0, firstLine ? 0 : 1);
-	lcd.print(left + spacesString + right);
+// IGC coordinate, 3718157N or 12153538W, to decimal degrees
+static double igcToDecimal(const String& point) {
+	if (point == "0") return 0.0;
+	double multiplier = ((point.indexOf("S") > -1) || (point.indexOf("W") > 1)) ? -1.0 : 1.0;
+	double degrees;
+	double minutes;
+	// Latitude, 8 chars: 3718157N
+    if (point.length() == 8) {
+    	// 37
+        degrees = point.substring(0, 0+2).toFloat();
+        // 18 + (157 / 1000)
+        minutes = point.substring(2, 2+2).toFloat() + (point.substring(4, 4+3).toFloat() / 1000);
+    } 
+    // Longitude: 12153538W
+    else {
+    	// 121
+        degrees = point.substring(0, 0+3).toFloat();
+        // 53 + (538 / 1000)
+        minutes = point.substring(3, 3+2).toFloat() + (point.substring(5, 5+3).toFloat() / 1000);
+    }
+    return (degrees + (minutes / 60)) * multiplier;
+}
+
+/**
+ * Returns the distance between two points on the Earth.
+ * Direct translation from http://en.wikipedia.org/wiki/Haversine_formula
+ * @param lat1d Latitude of the first point in degrees
+ * @param lon1d Longitude of the first point in degrees
+ * @param lat2d Latitude of the second point in degrees
+ * @param lon2d Longitude of the second point in degrees
+ * @return The distance between the two points in kilometers
+ */
+static double distanceEarth(double lat1d, double lon1d, double lat2d, double lon2d) {
+	double lat1r = deg2rad(lat1d);
+	double lon1r = deg2rad(lon1d);
+	double lat2r = deg2rad(lat2d);
+	double lon2r = deg2rad(lon2d);
+	double u = sin((lat2r - lat1r)/2);
+	double v = sin((lon2r - lon1r)/2);
+	return 2.0 * earthRadiusKm * asin(sqrt(u * u + cos(lat1r) * cos(lat2r) * v * v));
+}
+
+static inline void lcdSetLine(Display& lcd, const String& left, const String& right, bool firstLine) 
+{
+	lcdSetLine(lcd, left.c_str(), right.c_str(), firstLine);
+}
+
+// Only the characters that changed go to the display
+static void lcdPrint(Display& lcd, const char* left, const char* right, bool firstLine) 
+{
+	lcdSetLine(lcd, left, right, firstLine);
+	lcd.refresh();
+}
+static inline void lcdPrint(Display& lcd, const String& left, const String& right, bool firstLine) 
+{
+	lcdPrint(lcd, left.c_str(), right.c_str(), firstLine);
+}
+// Measurement on the right, formatted on the stack
+template<class T>
+static void lcdPrint(Display& lcd, const char* left, const Measurement<T>& right, bool firstLine) 
+{
+	char text[MEASUREMENT_TEXT_SIZE];
+	right.formatTo(text, sizeof(text));
+	lcdPrint(lcd, left, text, firstLine);
 }
 
 #endif
@@ -143,7 +143,7 @@
 //
 #define I2C_STRUCT(a1,f,c1,s,d,c2,flt,ra,smb,a2,slth,sltl,pins) \
     {a1, f, c1, s, d, c2, flt, ra, smb, a2, slth, sltl, {}, 0, 0, {}, 0, 0, I2C_OP_MODE_ISR, I2C_MASTER, pins, \
-     I2C_PULLUP_EXT, 100000, I2C_STOP, I2C_WAITING, 0, 0, 0, 0, I2C_DMA_OFF, nullptr, nullptr, nullptr, 0}
+     I2C_PULLUP_EXT, 100000, I2C_STOP, I2C_WAITING, 0, 0, 0, 0, I2C_DMA_OFF, nullptr, nullptr, nullptr, nullptr, 0}
 
 struct i2cStruct i2c_t3::i2cData[] =
 {
@@ -164,6 +164,55 @@ struct i2cStruct i2c_t3::i2cData[] =
 };
 
 
+// ------------------------------------------------------------------------------------------------------
+// Master Tx/Rx bookkeeping - every Master Tx/Rx is started and ended here once, for the telemetry and the
+//                            Master Done callback
+//
+static void i2c_master_start_(struct i2cStruct* i2c, uint8_t addr, size_t bytes)
+{
+    i2c->masterAddr = addr;
+    i2c->masterBytes = bytes;
+    i2c->masterStart = micros();
+    i2c->masterActive = 1;
+}
+
+static void i2c_master_end_(struct i2cStruct* i2c)
+{
+    i2c->masterActive = 0;
+    #if I2C_TELEMETRY
+        uint32_t elapsed = micros() - i2c->masterStart;
+        i2cTelemetry* t = nullptr;
+        for(uint8_t idx=0; idx < i2c->telemetryCount; idx++)
+        {
+            if(i2c->telemetry[idx].addr == i2c->masterAddr) { t = &i2c->telemetry[idx]; break; }
+        }
+        if(t == nullptr && i2c->telemetryCount < I2C_TELEMETRY_ADDRS)
+        {
+            t = &i2c->telemetry[i2c->telemetryCount++];
+            t->addr = i2c->masterAddr;
+        }
+        if(t != nullptr)
+        {
+            t->transactions++;
+            t->bytes += i2c->masterBytes;
+            switch(i2c->currentStatus)
+            {
+            case I2C_ADDR_NAK:
+            case I2C_DATA_NAK: t->naks++; break;
+            case I2C_TIMEOUT:  t->timeouts++; break;
+            case I2C_ARB_LOST: t->arbLost++; break;
+            default: break;
+            }
+            if(elapsed > t->maxMicros) t->maxMicros = elapsed;
+            uint8_t bucket = 0;
+            for(uint32_t limit = 64; elapsed >= limit && bucket < I2C_LATENCY_BUCKETS-1; limit <<= 1) bucket++;
+            t->latency[bucket]++;
+        }
+    #endif
+    if(i2c->user_onMasterDone != nullptr) i2c->user_onMasterDone();
+}
+
+
 // ------------------------------------------------------------------------------------------------------
 // Constructor/Destructor
 //
@@ -972,6 +1021,7 @@ void i2c_t3::sendTransmission_(struct i2cStruct* i2c, uint8_t bus, i2c_stop send
 
     // exit immediately if sending 0 bytes
     if(i2c->txBufferLength == 0) return;
+    i2c_master_start_(i2c, i2c->txBuffer[0] >> 1, i2c->txBufferLength);
 
     // update timeout
     timeout = (timeout == 0) ? i2c->defTimeout : timeout;
@@ -984,7 +1034,11 @@ void i2c_t3::sendTransmission_(struct i2cStruct* i2c, uint8_t bus, i2c_stop send
     *(i2c->S) = I2C_S_IICIF | I2C_S_ARBL; // clear intr, arbl
 
     // try to take control of the bus
-    if(!acquireBus_(i2c, bus, timeout, forceImm)) return;
+    if(!acquireBus_(i2c, bus, timeout, forceImm))
+    {
+        i2c_master_end_(i2c);
+        return;
+    }
 
     //
     // Immediate mode - blocking
@@ -1010,6 +1064,7 @@ void i2c_t3::sendTransmission_(struct i2cStruct* i2c, uint8_t bus, i2c_stop send
                 // TODO: this is clearly not right, after ARBL it should drop into IMM slave mode if IAAS=1
                 //       Right now Rx message would be ignored regardless of IAAS
                 *(i2c->C1) = I2C_C1_IICEN; // change to Rx mode, intr disabled (does this send STOP if ARBL flagged?)
+                i2c_master_end_(i2c);
                 return;
             }
             // check if slave ACK'd
@@ -1020,6 +1075,7 @@ void i2c_t3::sendTransmission_(struct i2cStruct* i2c, uint8_t bus, i2c_stop send
                 else
                     i2c->currentStatus = I2C_DATA_NAK; // NAK on Data
                 *(i2c->C1) = I2C_C1_IICEN; // send STOP, change to Rx mode, intr disabled
+                i2c_master_end_(i2c);
                 return;
             }
         }
@@ -1035,6 +1091,7 @@ void i2c_t3::sendTransmission_(struct i2cStruct* i2c, uint8_t bus, i2c_stop send
             *(i2c->C1) = I2C_C1_IICEN; // send STOP, change to Rx mode, intr disabled
         else
             *(i2c->C1) = I2C_C1_IICEN | I2C_C1_MST | I2C_C1_TX; // no STOP, stay in Tx mode, intr disabled
+        i2c_master_end_(i2c);
     }
     //
     // ISR/DMA mode - non-blocking
@@ -1052,6 +1109,7 @@ void i2c_t3::sendTransmission_(struct i2cStruct* i2c, uint8_t bus, i2c_stop send
             i2c->DMA->sourceBuffer(&i2c->txBuffer[2],i2c->txBufferLength-3); // DMA sends all except first/second/last bytes
             i2c->DMA->destination(*(i2c->D));
         }
+        i2c->masterActive = 2; // ends in the ISR
         // start ISR
         *(i2c->C1) = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX; // enable intr
         *(i2c->D) = i2c->txBuffer[0]; // writing first data byte will start ISR
@@ -1109,6 +1167,7 @@ void i2c_t3::sendRequest_(struct i2cStruct* i2c, uint8_t bus, uint8_t addr, size
     i2c->rxBufferIndex = 0; // reset buffer
     i2c->rxBufferLength = 0;
     timeout = (timeout == 0) ? i2c->defTimeout : timeout;
+    i2c_master_start_(i2c, addr, len + 1);
 
     // clear the status flags
     #if defined(__MKL26Z64__) || defined(__MK64FX512__) || defined(__MK66FX1M0__) // LC/3.5/3.6
@@ -1118,7 +1177,11 @@ void i2c_t3::sendRequest_(struct i2cStruct* i2c, uint8_t bus, uint8_t addr, size
     *(i2c->S) = I2C_S_IICIF | I2C_S_ARBL; // clear intr, arbl
 
     // try to take control of the bus
-    if(!acquireBus_(i2c, bus, timeout, forceImm)) return;
+    if(!acquireBus_(i2c, bus, timeout, forceImm))
+    {
+        i2c_master_end_(i2c);
+        return;
+    }
 
     //
     // Immediate mode - blocking
@@ -1142,6 +1205,7 @@ void i2c_t3::sendRequest_(struct i2cStruct* i2c, uint8_t bus, uint8_t addr, size
             // TODO: this is clearly not right, after ARBL it should drop into IMM slave mode if IAAS=1
             //       Right now Rx message would be ignored regardless of IAAS
             *(i2c->C1) = I2C_C1_IICEN; // change to Rx mode, intr disabled (does this send STOP if ARBL flagged?)
+            i2c_master_end_(i2c);
             return;
         }
         // check if slave ACK'd
@@ -1149,6 +1213,7 @@ void i2c_t3::sendRequest_(struct i2cStruct* i2c, uint8_t bus, uint8_t addr, size
         {
             i2c->currentStatus = I2C_ADDR_NAK; // NAK on Addr
             *(i2c->C1) = I2C_C1_IICEN; // send STOP, change to Rx mode, intr disabled
+            i2c_master_end_(i2c);
             return;
         }
         else
@@ -1200,6 +1265,7 @@ void i2c_t3::sendRequest_(struct i2cStruct* i2c, uint8_t bus, uint8_t addr, size
                 if(chkTimeout) i2c->timeoutRxNAK = 1; // set flag to indicate NAK sent
             }
         }
+        i2c_master_end_(i2c);
     }
     //
     // ISR/DMA mode - non-blocking
@@ -1216,6 +1282,7 @@ void i2c_t3::sendRequest_(struct i2cStruct* i2c, uint8_t bus, uint8_t addr, size
             i2c->DMA->source(*(i2c->D));
             i2c->DMA->destinationBuffer(&i2c->rxBuffer[0],i2c->reqCount-1); // DMA gets all except last byte
         }
+        i2c->masterActive = 2; // ends in the ISR
         // start ISR
         *(i2c->C1) = I2C_C1_IICEN | I2C_C1_IICIE | I2C_C1_MST | I2C_C1_TX; // enable intr
         *(i2c->D) = (addr << 1) | 1; // address + READ
@@ -1244,6 +1311,35 @@ uint8_t i2c_t3::getError(void)
 }
 
 
+#if I2C_TELEMETRY
+// ------------------------------------------------------------------------------------------------------
+// Telemetry - counters of a slave address, nullptr if the bus has none for it
+// parameters:
+//      addr = 7bit slave address
+//
+const i2cTelemetry* i2c_t3::telemetryFor(uint8_t addr)
+{
+    for(uint8_t idx=0; idx < i2c->telemetryCount; idx++)
+    {
+        if(i2c->telemetry[idx].addr == addr) return &i2c->telemetry[idx];
+    }
+    return nullptr;
+}
+
+
+// ------------------------------------------------------------------------------------------------------
+// Reset Telemetry - clears the counters of all addresses
+//
+void i2c_t3::resetTelemetry(void)
+{
+    __disable_irq();
+    memset(i2c->telemetry, 0, sizeof(i2c->telemetry));
+    i2c->telemetryCount = 0;
+    __enable_irq();
+}
+#endif
+
+
 // ------------------------------------------------------------------------------------------------------
 // Done Check - returns simple complete/not-complete value to indicate I2C status
 // return: 1=Tx/Rx complete (with or without errors), 0=still running
@@ -1292,6 +1388,10 @@ uint8_t i2c_t3::finish_(struct i2cStruct* i2c, uint8_t bus, uint32_t timeout)
        i2c->currentStatus == I2C_RECEIVING)
         i2c->currentStatus = I2C_TIMEOUT; // set to timeout state
 
+    // a timeout stops a Tx/Rx the ISR would have ended
+    if(i2c->currentStatus == I2C_TIMEOUT && i2c->masterActive == 2)
+        i2c_master_end_(i2c);
+
     // delay to allow bus to settle (eg. allow STOP to complete and be recognized,
     //                               not just on our side, but on slave side also)
     delayMicroseconds(4);
@@ -1398,17 +1498,31 @@ uint8_t i2c_t3::peekByte_(struct i2cStruct* i2c)
 // ======================================================================================================
 
 
+// Ends the Master Tx/Rx when the handler completed it
+static inline void i2c_master_done_(struct i2cStruct* i2c, i2c_status before)
+{
+    i2c_status after = i2c->currentStatus;
+    if((before == I2C_SENDING || before == I2C_SEND_ADDR || before == I2C_RECEIVING) &&
+       after != I2C_SENDING && after != I2C_SEND_ADDR && after != I2C_RECEIVING &&
+       i2c->masterActive == 2)
+        i2c_master_end_(i2c);
+}
+
 void i2c0_isr(void) // I2C0 ISR
 {
     I2C0_INTR_FLAG_ON;
+    i2c_status before = i2c_t3::i2cData[0].currentStatus;
     i2c_isr_handler(&(i2c_t3::i2cData[0]),0);
+    i2c_master_done_(&(i2c_t3::i2cData[0]), before);
     I2C0_INTR_FLAG_OFF;
 }
 #if I2C_BUS_NUM >= 2
     void i2c1_isr(void) // I2C1 ISR
     {
         I2C1_INTR_FLAG_ON;
+        i2c_status before = i2c_t3::i2cData[1].currentStatus;
         i2c_isr_handler(&(i2c_t3::i2cData[1]),1);
+        i2c_master_done_(&(i2c_t3::i2cData[1]), before);
         I2C1_INTR_FLAG_OFF;
     }
 #endif
@@ -1416,7 +1530,9 @@ void i2c0_isr(void) // I2C0 ISR
     void i2c2_isr(void) // I2C2 ISR
     {
         I2C2_INTR_FLAG_ON;
+        i2c_status before = i2c_t3::i2cData[2].currentStatus;
         i2c_isr_handler(&(i2c_t3::i2cData[2]),2);
+        i2c_master_done_(&(i2c_t3::i2cData[2]), before);
         I2C2_INTR_FLAG_OFF;
     }
 #endif
@@ -1424,7 +1540,9 @@ void i2c0_isr(void) // I2C0 ISR
     void i2c3_isr(void) // I2C3 ISR
     {
         I2C3_INTR_FLAG_ON;
+        i2c_status before = i2c_t3::i2cData[3].currentStatus;
         i2c_isr_handler(&(i2c_t3::i2cData[3]),3);
+        i2c_master_done_(&(i2c_t3::i2cData[3]), before);
         I2C3_INTR_FLAG_OFF;
     }
 #endif
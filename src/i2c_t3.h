@@ -206,6 +206,16 @@
 //
 //#define I2C_AUTO_RETRY
 
+// ------------------------------------------------------------------------------------------------------
+// Telemetry - set to 0 to leave out the per address counters of Master Tx/Rx (transactions, bytes, NAKs,
+//             timeouts, arbitration losses and a latency histogram), see telemetry().  Each bus keeps
+//             counters for the first I2C_TELEMETRY_ADDRS addresses it talks to.  Latency buckets double
+//             from 64us, the last one holds anything longer.
+//
+#define I2C_TELEMETRY 1
+#define I2C_TELEMETRY_ADDRS 4
+#define I2C_LATENCY_BUCKETS 8
+
 // ======================================================================================================
 // == End User Define Section ===========================================================================
 // ======================================================================================================
@@ -385,6 +395,22 @@ const uint8_t i2c_div_ratio[] =
     I2C_F_DIV2560,I2C_F_DIV3072,I2C_F_DIV3840};
 
 
+// ------------------------------------------------------------------------------------------------------
+// Master Tx/Rx counters of one slave address
+//
+struct i2cTelemetry
+{
+    uint8_t  addr;                           // 7bit slave address
+    uint32_t transactions;                   // Tx and Rx, failed ones included
+    uint32_t bytes;                          // Bytes on the bus, address byte included
+    uint32_t naks;                           // Address or data NAK
+    uint32_t timeouts;                       // Bus not acquired or Tx/Rx incomplete
+    uint32_t arbLost;                        // Arbitration lost
+    uint32_t maxMicros;                      // Longest transaction
+    uint32_t latency[I2C_LATENCY_BUCKETS];   // Transactions under 64us, 128us, ... and the rest
+};
+
+
 // ------------------------------------------------------------------------------------------------------
 // Main I2C data structure
 //
@@ -422,8 +448,17 @@ struct i2cStruct
     volatile i2c_dma_state activeDMA;        // Active DMA flag                   (User&ISR)
     void (*user_onReceive)(size_t len);      // Slave Rx Callback Function        (User)
     void (*user_onRequest)(void);            // Slave Tx Callback Function        (User)
+    void (*user_onMasterDone)(void);         // Master Done Callback Function     (User)
     DMAChannel* DMA;                         // DMA Channel object                (User&ISR)
     uint32_t defTimeout;                     // Default Timeout                   (User)
+    volatile uint8_t masterActive;           // Master Tx/Rx, 0=none 1=blocking 2=ends in ISR (User&ISR)
+    uint8_t  masterAddr;                     // Master Tx/Rx Address              (User)
+    size_t   masterBytes;                    // Master Tx/Rx Length, with address (User)
+    uint32_t masterStart;                    // Master Tx/Rx Start micros()       (User)
+    #if I2C_TELEMETRY
+        i2cTelemetry telemetry[I2C_TELEMETRY_ADDRS]; // Master Tx/Rx Counters (User&ISR)
+        uint8_t  telemetryCount;             // Addresses with counters           (User&ISR)
+    #endif
 };
 
 
@@ -978,6 +1013,26 @@ public:
     //
     inline void onRequest(void (*function)(void)) { i2c->user_onRequest = function; }
 
+    // ------------------------------------------------------------------------------------------------------
+    // Set callback function for Master Tx/Rx done, called when a sendTransmission() or sendRequest() ends,
+    // successful or not (check status()).  This is from the ISR in ISR/DMA mode, from the call itself in
+    // Immediate mode or when the bus could not be acquired.  Blocking calls trigger it too.
+    //
+    inline void onMasterDone(void (*function)(void)) { i2c->user_onMasterDone = function; }
+
+    #if I2C_TELEMETRY
+        // ------------------------------------------------------------------------------------------------------
+        // Telemetry - counters of Master Tx/Rx by slave address, see i2cTelemetry.  Counters are updated
+        //             from the ISR, copy them with interrupts off for consistent values.
+        // return: telemetryCount() = addresses with counters, telemetry(index) = their counters,
+        //         telemetryFor(addr) = counters of an address or nullptr
+        //
+        inline uint8_t telemetryCount(void) { return i2c->telemetryCount; }
+        inline const i2cTelemetry& telemetry(uint8_t index) { return i2c->telemetry[index]; }
+        const i2cTelemetry* telemetryFor(uint8_t addr);
+        void resetTelemetry(void);
+    #endif
+
     // ------------------------------------------------------------------------------------------------------
     // For compatibility with pre-1.0 sketches and libraries
     inline void send(uint8_t b)             { write(b); }
@@ -0,0 +1,97 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Reads a binary flight log (.svl) back into the IGC text the vario
+ *	wrote, for igcexport and flightlogcheck.
+ */
+
+#ifndef FlightLogReader_h
+#define FlightLogReader_h
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "../src/FlightLogFormat.h"
+
+struct flight_log_export {
+	unsigned long fixes { 0 };
+	unsigned long textBlocks { 0 };
+	// Bytes of damaged blocks passed over
+	unsigned long skipped { 0 };
+};
+
+static uint16_t readUint16(const uint8_t* src)
+{
+	return src[0] | (src[1] << 8);
+}
+
+// Returns the size of a valid block at offset, or 0
+static size_t checkBlock(const std::vector<uint8_t>& data, size_t offset)
+{
+	if (data.size() - offset < FLIGHT_LOG_BLOCK_HEADER + 2) return 0;
+	const uint8_t* block = &data[offset];
+	if (block[0] != FLIGHT_LOG_BLOCK_SYNC && block[0] != FLIGHT_LOG_TEXT_SYNC) return 0;
+	size_t payload = readUint16(block + 2);
+	size_t size = FLIGHT_LOG_BLOCK_HEADER + payload;
+	if (payload > FLIGHT_LOG_BLOCK_PAYLOAD || data.size() - offset < size + 2) return 0;
+	if (flightLogCrc(block, size) != readUint16(block + size)) return 0;
+	return size + 2;
+}
+
+/**
+ * Appends the IGC text of `data` to `igc`, the same bytes IGCFileRecorder
+ * writes with println(). Returns an error, or NULL.
+ */
+static const char* exportFlightLog(const std::vector<uint8_t>& data, std::string& igc, flight_log_export* result)
+{
+	if (data.size() < FLIGHT_LOG_HEADER_OVERHEAD ||
+		memcmp(&data[0], FLIGHT_LOG_MAGIC, 4) != 0 ||
+		data[4] != FLIGHT_LOG_VERSION) {
+		return "not a flight log of this version";
+	}
+	size_t headerLength = readUint16(&data[5]);
+	size_t offset = FLIGHT_LOG_HEADER_OVERHEAD - 2 + headerLength;
+	if (data.size() < offset + 2 || flightLogCrc(&data[0], offset) != readUint16(&data[offset])) {
+		return "damaged header";
+	}
+	igc.append((const char*)&data[7], headerLength);
+	igc += "\r\n";
+
+	offset += 2;
+	while (offset < data.size()) {
+		size_t size = checkBlock(data, offset);
+		if (size == 0) {
+			// Damaged block, look for the next one
+			offset++;
+			result->skipped++;
+			continue;
+		}
+		const uint8_t* block = &data[offset];
+		const uint8_t* payload = block + FLIGHT_LOG_BLOCK_HEADER;
+		size_t payloadSize = readUint16(block + 2);
+		if (block[0] == FLIGHT_LOG_TEXT_SYNC) {
+			igc.append((const char*)payload, payloadSize);
+			igc += "\r\n";
+			result->textBlocks++;
+			offset += size;
+			continue;
+		}
+		flight_log_fix fix = {};
+		size_t used = 0;
+		for (int i = 0; i < block[1]; i++) {
+			size_t n = flightLogDecode(payload + used, payloadSize - used, &fix);
+			if (n == 0) break;
+			used += n;
+			char line[FLIGHT_LOG_IGC_LENGTH + 1];
+			flightLogFormatIGC(&fix, line);
+			igc += line;
+			igc += "\r\n";
+			result->fixes++;
+		}
+		offset += size;
+	}
+	return NULL;
+}
+
+#endif
@@ -0,0 +1,137 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Block driver for running FatLib on a computer, backed by RAM or by a
+ *	disk image file. Every transfer is counted and timed with a simple SD
+ *	card latency model, nothing actually waits.
+ *
+ *	FatLib has to be built with -DENABLE_ARDUINO_FEATURES=0 so BlockDriver
+ *	is BaseBlockDriver.
+ */
+
+#ifndef HostBlockDriver_h
+#define HostBlockDriver_h
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include "../src/SdFat/FatLib/BaseBlockDriver.h"
+
+// Microseconds, roughly a class 10 card on a 24 MHz SPI bus
+struct host_block_latency {
+	double readBlock { 700 };
+	double writeBlock { 1200 };
+	// Command and busy time of a multi-block transfer, then per block
+	double multiBlockStart { 900 };
+	double multiBlockRead { 220 };
+	double multiBlockWrite { 260 };
+	double sync { 0 };
+};
+
+struct host_block_counters {
+	uint32_t blocksRead { 0 };
+	uint32_t blocksWritten { 0 };
+	// Single and multi-block commands
+	uint32_t readCommands { 0 };
+	uint32_t writeCommands { 0 };
+	uint32_t syncs { 0 };
+	double microseconds { 0 };
+};
+
+class HostBlockDriver : public BaseBlockDriver
+{
+public:
+	~HostBlockDriver() {
+		close();
+	}
+	// Zeroed RAM volume
+	bool begin(uint32_t blockCount) {
+		close();
+		m_ram.assign((size_t)blockCount * 512, 0);
+		m_blockCount = blockCount;
+		return true;
+	}
+	// Disk image, written in place
+	bool begin(const char* path) {
+		close();
+		m_file = fopen(path, "r+b");
+		if (!m_file) return false;
+		fseek(m_file, 0, SEEK_END);
+		m_blockCount = ftell(m_file) / 512;
+		return m_blockCount > 0;
+	}
+	void close() {
+		if (m_file) fclose(m_file);
+		m_file = NULL;
+		m_ram.clear();
+		m_blockCount = 0;
+	}
+	uint32_t blockCount() const {
+		return m_blockCount;
+	}
+	// Raw access to a RAM volume, NULL for an image file
+	uint8_t* data() {
+		return m_ram.empty() ? NULL : &m_ram[0];
+	}
+
+	host_block_latency& latency() {
+		return m_latency;
+	}
+	const host_block_counters& counters() const {
+		return m_counters;
+	}
+	void resetCounters() {
+		m_counters = host_block_counters();
+	}
+
+	bool readBlock(uint32_t block, uint8_t* dst) {
+		m_counters.readCommands++;
+		m_counters.microseconds += m_latency.readBlock;
+		return transfer(block, dst, 1, false);
+	}
+	bool writeBlock(uint32_t block, const uint8_t* src) {
+		m_counters.writeCommands++;
+		m_counters.microseconds += m_latency.writeBlock;
+		return transfer(block, (uint8_t*)src, 1, true);
+	}
+	bool readBlocks(uint32_t block, uint8_t* dst, size_t nb) {
+		m_counters.readCommands++;
+		m_counters.microseconds += m_latency.multiBlockStart + nb * m_latency.multiBlockRead;
+		return transfer(block, dst, nb, false);
+	}
+	bool writeBlocks(uint32_t block, const uint8_t* src, size_t nb) {
+		m_counters.writeCommands++;
+		m_counters.microseconds += m_latency.multiBlockStart + nb * m_latency.multiBlockWrite;
+		return transfer(block, (uint8_t*)src, nb, true);
+	}
+	bool syncBlocks() {
+		m_counters.syncs++;
+		m_counters.microseconds += m_latency.sync;
+		return !m_file || fflush(m_file) == 0;
+	}
+
+private:
+	bool transfer(uint32_t block, uint8_t* data, size_t nb, bool write) {
+		if (block >= m_blockCount || nb > m_blockCount - block) return false;
+		if (write) m_counters.blocksWritten += nb;
+		else m_counters.blocksRead += nb;
+		if (!m_file) {
+			uint8_t* ram = &m_ram[(size_t)block * 512];
+			if (write) memcpy(ram, data, nb * 512);
+			else memcpy(data, ram, nb * 512);
+			return true;
+		}
+		if (fseek(m_file, (long)block * 512, SEEK_SET)) return false;
+		if (write) return fwrite(data, 512, nb, m_file) == nb;
+		return fread(data, 512, nb, m_file) == nb;
+	}
+
+	std::vector<uint8_t> m_ram;
+	FILE* m_file { NULL };
+	uint32_t m_blockCount { 0 };
+	host_block_latency m_latency;
+	host_block_counters m_counters;
+};
+
+#endif
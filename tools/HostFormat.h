@@ -0,0 +1,67 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Formats a HostBlockDriver RAM volume for fatbench and fsinfocheck.
+ */
+
+#ifndef HostFormat_h
+#define HostFormat_h
+
+#include "HostBlockDriver.h"
+
+static void putUint16(uint8_t* dst, uint16_t value)
+{
+	dst[0] = value;
+	dst[1] = value >> 8;
+}
+
+static void putUint32(uint8_t* dst, uint32_t value)
+{
+	putUint16(dst, value);
+	putUint16(dst + 2, value >> 16);
+}
+
+// FAT32 super floppy with one block per cluster, enough clusters for FAT32
+static void formatFat32(HostBlockDriver& driver)
+{
+	const uint32_t reserved = 32;
+	uint8_t* volume = driver.data();
+	uint32_t blocks = driver.blockCount();
+	// Room for an entry per block, a little more than the clusters left
+	uint32_t fatBlocks = ((blocks - reserved + 2) * 4 + 511) / 512;
+
+	uint8_t* boot = volume;
+	memcpy(boot, "\xEB\x58\x90" "MSWIN4.1", 11);
+	putUint16(boot + 11, 512);
+	boot[13] = 1;
+	putUint16(boot + 14, reserved);
+	boot[16] = 2;
+	boot[21] = 0xF8;
+	putUint32(boot + 32, blocks);
+	putUint32(boot + 36, fatBlocks);
+	putUint32(boot + 44, 2);
+	putUint16(boot + 48, 1);
+	putUint16(boot + 50, 6);
+	boot[66] = 0x29;
+	memcpy(boot + 71, "NO NAME    FAT32   ", 19);
+	boot[510] = 0x55;
+	boot[511] = 0xAA;
+	memcpy(volume + 6 * 512, boot, 512);
+
+	uint8_t* info = volume + 512;
+	putUint32(info, 0x41615252);
+	putUint32(info + 484, 0x61417272);
+	putUint32(info + 488, 0xFFFFFFFF);
+	putUint32(info + 492, 0xFFFFFFFF);
+	putUint32(info + 508, 0xAA550000);
+
+	for (int i = 0; i < 2; i++) {
+		uint8_t* fat = volume + (reserved + i * fatBlocks) * 512;
+		putUint32(fat, 0x0FFFFFF8);
+		putUint32(fat + 4, 0x0FFFFFFF);
+		putUint32(fat + 8, 0x0FFFFFFF);
+	}
+}
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Runs the SD card paths of a flight through FatLib on a computer and
+ *	reports the card I/O per logged fix.
+ *
+ *	Build: c++ -O2 -DENABLE_ARDUINO_FEATURES=0 -o fatbench tools/fatbench.cpp \
+ *	         src/SdFat/FatLib/FatVolume.cpp src/SdFat/FatLib/FatFile.cpp \
+ *	         src/SdFat/FatLib/FatFileLFN.cpp src/SdFat/FatLib/FatFileSFN.cpp \
+ *	         src/SdFat/FatLib/FatFilePrint.cpp src/SdFat/FatLib/FmtNumber.cpp \
+ *	         src/SdFat/FatLib/StdioStream.cpp
+ *	Usage: fatbench [IMAGE] [FIXES]
+ *
+ *	Without an image a blank 64 MB FAT32 volume is made in RAM. An image,
+ *	FAT16 or FAT32, is changed in place.
+ *
+ *	After the flight, 60 long-named flights are made in one folder and
+ *	reopened 200 times for 10 more B-records each. Add
+ *	-DFAT_CACHE_BLOCKS=N to the build to compare cache sizes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "HostBlockDriver.h"
+#include "HostFormat.h"
+#include "../src/SdFat/FatLib/FatFileSystem.h"
+#include "../src/SdFat/FatLib/StdioStream.h"
+
+#define RAM_VOLUME_BLOCKS 131072
+#define FIXES_PER_SYNC 10
+#define REVISIT_FLIGHTS 60
+#define REVISIT_CYCLES 200
+
+static void report(const char* step, HostBlockDriver& driver, int fixes)
+{
+	const host_block_counters& c = driver.counters();
+	printf("%-10s %8u %8u %8u %8u %6u %10.1f", step,
+		c.blocksRead, c.blocksWritten, c.readCommands, c.writeCommands,
+		c.syncs, c.microseconds / 1000.0);
+	if (fixes > 0) {
+		printf("   per fix: %.2f reads %.2f writes %.0f us",
+			(double)c.blocksRead / fixes, (double)c.blocksWritten / fixes,
+			c.microseconds / fixes);
+	}
+	printf("\n");
+	driver.resetCounters();
+}
+
+int main(int argc, char** argv)
+{
+	HostBlockDriver driver;
+	const char* image = argc > 1 ? argv[1] : NULL;
+	int fixes = argc > 2 ? atoi(argv[2]) : 3600;
+	if (image) {
+		if (!driver.begin(image)) {
+			fprintf(stderr, "Could not open %s\n", image);
+			return 1;
+		}
+	} else {
+		driver.begin(RAM_VOLUME_BLOCKS);
+		formatFat32(driver);
+	}
+
+	FatFileSystem fs;
+	if (!fs.begin(&driver)) {
+		fprintf(stderr, "No FAT16 or FAT32 volume\n");
+		return 1;
+	}
+	printf("FAT%d, %u clusters of %u blocks\n", fs.vol()->fatType(),
+		fs.vol()->clusterCount(), fs.vol()->blocksPerCluster());
+	printf("%-10s %8s %8s %8s %8s %6s %10s\n", "step",
+		"read", "written", "rd cmds", "wr cmds", "syncs", "model ms");
+	report("mount", driver, 0);
+
+	// Settings file, through the stdio stream like the vario reads it
+	StdioStream settings;
+	if (settings.fopen("SETTINGS.TXT", "w")) {
+		settings.fputs("UNIT_SYSTEM=METRIC\r\nLOG_RATE_HZ=1\r\n");
+		settings.fclose();
+	}
+	char line[64];
+	if (settings.fopen("SETTINGS.TXT", "r")) {
+		while (settings.fgets(line, sizeof(line))) {}
+		settings.fclose();
+	}
+	report("settings", driver, 0);
+
+	// One flight in the folder of its month: header, then a B-record per fix
+	// with a sync every few fixes
+	FatFile folder;
+	FatFile file;
+	if (!folder.open(fs.vwd(), "/FLIGHTS/2017/06", O_READ) &&
+		!folder.mkdir(fs.vwd(), "/FLIGHTS/2017/06", true)) {
+		fprintf(stderr, "Could not create the flights folder\n");
+		return 1;
+	}
+	if (!file.open(&folder, "761X0021.IGC", O_CREAT | O_WRITE | O_TRUNC)) {
+		fprintf(stderr, "Could not create the flight log\n");
+		return 1;
+	}
+	const char* header =
+		"APEC002 SimpleVario\r\nHFDTE010617\r\nHFPLTPILOT:Pedro Enrique\r\n"
+		"HFGTYGLIDERTYPE:Wills Wing Sport 2\r\nI053638FXA3941VXA4243SIU4447VAT4848TDS\r\n";
+	file.write(header, strlen(header));
+	file.sync();
+	report("takeoff", driver, 0);
+
+	for (int i = 0; i < fixes; i++) {
+		int seconds = 12 * 3600 + i;
+		snprintf(line, sizeof(line), "B%02d%02d%02d4740123N12212345WA0123401300005004080123%d\r\n",
+			seconds / 3600, (seconds / 60) % 60, seconds % 60, i % 10);
+		file.write(line, strlen(line));
+		if (i % FIXES_PER_SYNC == FIXES_PER_SYNC - 1) file.sync();
+	}
+	report("flight", driver, fixes);
+
+	file.close();
+	report("landing", driver, 0);
+	printf("cache hits %u misses %u, file %u bytes\n",
+		fs.vol()->cacheHitCount(), fs.vol()->cacheMissCount(), file.fileSize());
+
+	// Many flights in one folder, reopened in turn: directory lookups, FAT
+	// walks and appends compete for the cache
+	FatFile revisits;
+	if (!revisits.mkdir(fs.vwd(), "/FLIGHTS/2017/07", true)) {
+		fprintf(stderr, "Could not create the revisits folder\n");
+		return 1;
+	}
+	char name[40];
+	for (int i = 0; i < REVISIT_FLIGHTS; i++) {
+		snprintf(name, sizeof(name), "2017-07-%02d Flight %02d.IGC", 1 + i % 30, i);
+		if (!file.open(&revisits, name, O_CREAT | O_WRITE | O_TRUNC)) {
+			fprintf(stderr, "Could not create %s\n", name);
+			return 1;
+		}
+		file.write(header, strlen(header));
+		file.close();
+	}
+	report("folder", driver, 0);
+	uint32_t hits = fs.vol()->cacheHitCount();
+	uint32_t misses = fs.vol()->cacheMissCount();
+	for (int i = 0; i < REVISIT_CYCLES; i++) {
+		int flight = (i * 7) % REVISIT_FLIGHTS;
+		snprintf(name, sizeof(name), "2017-07-%02d Flight %02d.IGC", 1 + flight % 30, flight);
+		if (!file.open(&revisits, name, O_WRITE | O_APPEND)) {
+			fprintf(stderr, "Could not reopen %s\n", name);
+			return 1;
+		}
+		for (int j = 0; j < FIXES_PER_SYNC; j++) {
+			int seconds = 13 * 3600 + i * FIXES_PER_SYNC + j;
+			snprintf(line, sizeof(line), "B%02d%02d%02d4740123N12212345WA0123401300005004080123%d\r\n",
+				seconds / 3600, (seconds / 60) % 60, seconds % 60, j);
+			file.write(line, strlen(line));
+		}
+		file.close();
+	}
+	report("revisits", driver, REVISIT_CYCLES * FIXES_PER_SYNC);
+	printf("%d cache blocks, revisits hits %u misses %u\n", FAT_CACHE_BLOCKS,
+		fs.vol()->cacheHitCount() - hits, fs.vol()->cacheMissCount() - misses);
+	return 0;
+}
@@ -0,0 +1,172 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Writes a synthetic flight into a binary flight log the way
+ *	FlightLogWriter does, exports it back and checks that the IGC text
+ *	comes out byte for byte. Then damages a block and checks that only its
+ *	own fixes are lost.
+ *
+ *	Build: c++ -O2 -o flightlogcheck tools/flightlogcheck.cpp
+ *	Usage: flightlogcheck [FIXES]
+ *
+ *	The track crosses midnight, the equator and the prime meridian, flies
+ *	below sea level and sinks, and has L-records between the fixes.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "FlightLogReader.h"
+
+#define HEADER_TEXT "APEC002 SimpleVario\r\nHFDTE010124\r\nI053638FXA3941VXA4042SIU4346VAT4747TDS"
+#define FIXES_PER_EVENT 1000
+
+struct written_block {
+	size_t offset;
+	int fixes;
+};
+
+// A B-record with its extensions, formatted by printf and not by the code
+// under test
+static std::string fixLine(long i)
+{
+	long tenths = (23L * 3600 + 50 * 60) * 10 + i * 2;
+	long seconds = (tenths / 10) % 86400;
+	// Thousandths of minute, south and west are negative
+	long latitude = -3000 + i * 7;
+	long longitude = 4000 - i * 9;
+	long lat = labs(latitude);
+	long lon = labs(longitude);
+	int baro = (int)(60 - i / 40);
+	int gps = baro + 3;
+	int vario = (int)(40 * sin(i / 50.0));
+	char line[96];
+	snprintf(line, sizeof(line), "B%02ld%02ld%02ld%02ld%05ld%c%03ld%05ld%cA%05d%05d%03d%03d%02d%04d%ld",
+		seconds / 3600, seconds / 60 % 60, seconds % 60,
+		lat / 60000, lat % 60000, latitude < 0 ? 'S' : 'N',
+		lon / 60000, lon % 60000, longitude < 0 ? 'W' : 'E',
+		baro, gps, (int)(i % 30), (int)(i % 45), (int)(4 + i % 9), vario, tenths % 10);
+	return line;
+}
+
+static std::vector<std::string> makeTrack(long fixes)
+{
+	std::vector<std::string> lines;
+	lines.push_back("LPECTAKEOFF:235000 SPEED");
+	for (long i = 0; i < fixes; i++) {
+		lines.push_back(fixLine(i));
+		if (i % FIXES_PER_EVENT == FIXES_PER_EVENT - 1) lines.push_back("LPECTHERMAL");
+	}
+	// Parses, but would come back as 00000
+	std::string negativeZero = fixLine(fixes);
+	negativeZero.replace(25, 5, "-0000");
+	lines.push_back(negativeZero);
+	lines.push_back("LPECLANDING:000000 STILL");
+	return lines;
+}
+
+static void append(std::vector<uint8_t>& file, const uint8_t* data, size_t size)
+{
+	file.insert(file.end(), data, data + size);
+}
+
+/**
+ * The file FlightLogWriter writes for these lines: the header, a fix
+ * block until it is full, a text block for any other line. Returns the
+ * fixes that went as text and where each fix block is.
+ */
+static unsigned long writeLog(const std::vector<std::string>& lines, std::vector<uint8_t>& file,
+	std::vector<written_block>& blocks)
+{
+	uint16_t length = sizeof(HEADER_TEXT) - 1;
+	uint8_t prefix[FLIGHT_LOG_HEADER_OVERHEAD - 2];
+	memcpy(prefix, FLIGHT_LOG_MAGIC, 4);
+	prefix[4] = FLIGHT_LOG_VERSION;
+	prefix[5] = length & 0xFF;
+	prefix[6] = length >> 8;
+	uint16_t crc = flightLogCrc(prefix, sizeof(prefix));
+	crc = flightLogCrc((const uint8_t*)HEADER_TEXT, length, crc);
+	uint8_t suffix[2] = { (uint8_t)(crc & 0xFF), (uint8_t)(crc >> 8) };
+	append(file, prefix, sizeof(prefix));
+	append(file, (const uint8_t*)HEADER_TEXT, length);
+	append(file, suffix, sizeof(suffix));
+
+	static flight_log_block block;
+	flightLogBlockClear(&block);
+	unsigned long textFixes = 0;
+	for (size_t i = 0; i <= lines.size(); i++) {
+		flight_log_fix fix;
+		bool last = i == lines.size();
+		bool parsed = !last && flightLogParseIGC(lines[i].c_str(), lines[i].length(), &fix);
+		if (parsed && flightLogBlockAdd(&block, &fix)) continue;
+		if (block.count) {
+			blocks.push_back({ file.size(), block.count });
+			append(file, block.data, flightLogBlockSeal(&block));
+			flightLogBlockClear(&block);
+		}
+		if (last) break;
+		if (parsed) {
+			flightLogBlockAdd(&block, &fix);
+		} else {
+			if (lines[i][0] == 'B') textFixes++;
+			append(file, block.data, flightLogBlockText(&block, lines[i].c_str(), lines[i].length()));
+		}
+	}
+	return textFixes;
+}
+
+static std::string igcText(const std::vector<std::string>& lines, size_t skipFrom = 0, size_t skipTo = 0)
+{
+	std::string igc = HEADER_TEXT "\r\n";
+	size_t fix = 0;
+	for (size_t i = 0; i < lines.size(); i++) {
+		bool isFix = lines[i][0] == 'B';
+		bool skipped = isFix && fix >= skipFrom && fix < skipTo;
+		if (isFix) fix++;
+		if (skipped) continue;
+		igc += lines[i] + "\r\n";
+	}
+	return igc;
+}
+
+int main(int argc, char** argv)
+{
+	long fixes = argc > 1 ? atol(argv[1]) : 20000;
+	if (fixes < FIXES_PER_EVENT) {
+		fprintf(stderr, "usage: flightlogcheck [FIXES], at least %d\n", FIXES_PER_EVENT);
+		return 1;
+	}
+	std::vector<std::string> lines = makeTrack(fixes);
+	std::vector<uint8_t> file;
+	std::vector<written_block> blocks;
+	unsigned long textFixes = writeLog(lines, file, blocks);
+	std::string igc = igcText(lines);
+
+	int failures = 0;
+	std::string exported;
+	flight_log_export result;
+	const char* error = exportFlightLog(file, exported, &result);
+	bool same = !error && exported == igc;
+	printf("%s round trip: %ld fixes, %zu bytes of IGC in %zu bytes, %lu fixes as text\n",
+		same ? "ok  " : "FAIL", fixes + 1, igc.size(), file.size(), textFixes);
+	failures += !same;
+	if (textFixes != 1) {
+		printf("FAIL only the -0000 altitude should be text, %lu were\n", textFixes);
+		failures++;
+	}
+
+	// A bit flipped in the middle of a fix block
+	const written_block& damaged = blocks[blocks.size() / 2];
+	size_t before = 0;
+	for (size_t i = 0; i < blocks.size() / 2; i++) before += blocks[i].fixes;
+	file[damaged.offset + FLIGHT_LOG_BLOCK_HEADER + 10] ^= 0x10;
+	exported.clear();
+	result = flight_log_export();
+	error = exportFlightLog(file, exported, &result);
+	same = !error && exported == igcText(lines, before, before + damaged.fixes);
+	printf("%s damaged block: %d fixes lost, %lu bytes skipped\n", same ? "ok  " : "FAIL",
+		damaged.fixes, result.skipped);
+	failures += !same;
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,308 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Replays a flight, one sample a second, through the takeoff and landing
+ *	detection and checks where the flight starts and ends.
+ *
+ *	Build: c++ -O2 -o flightreplay tools/flightreplay.cpp src/FlightDetector.cpp
+ *	Usage: flightreplay [TRACK.csv|TRACK.igc [TAKEOFF LANDING [TAKEOFF_SECONDS LANDING_SECONDS]]]
+ *
+ *	Without a track the built-in ones are replayed, then the IGC files in
+ *	tools/flightreplay, so run it from the top of the repository. A track
+ *	has a line per second of altitude (m), climb rate (m/s) and ground
+ *	speed (kt, below zero without a fix), separated by commas or spaces;
+ *	lines starting with # are left out. TAKEOFF and LANDING are the
+ *	expected sample numbers, counted from 0, or -1 for none.
+ *
+ *	An IGC file is turned into one sample a second from its B-records: the
+ *	pressure altitude, the VAT extension for the climb or else the
+ *	altitude change over 5 seconds, and the speed between fixes. Seconds
+ *	without a fix keep the last altitude and climb and have no speed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <strings.h>
+#include <vector>
+#include "../src/FlightDetector.h"
+
+struct track_sample {
+	double altitude;
+	double climbRate;
+	double knots;
+};
+
+struct replay_result {
+	int takeoff;
+	int landing;
+	const char* takeoffReason;
+	int flights;
+};
+
+// First takeoff and the landing after it, and how many takeoffs in all
+static replay_result replay(const std::vector<track_sample>& track, int takeoffSeconds, int landingSeconds)
+{
+	FlightDetector detector;
+	detector.setWindows(takeoffSeconds, landingSeconds);
+	replay_result result { -1, -1, "", 0 };
+	for (size_t i = 0; i < track.size(); i++) {
+		const track_sample& s = track[i];
+		FlightDetector::Event event = detector.update(s.altitude, s.climbRate, s.knots);
+		if (event == FlightDetector::kTakeoff && result.flights++ == 0) {
+			result.takeoff = i;
+			result.takeoffReason = detector.reason();
+		} else if (event == FlightDetector::kLanding && result.landing < 0) {
+			result.landing = i;
+		}
+	}
+	return result;
+}
+
+static bool readTrack(const char* path, std::vector<track_sample>& track)
+{
+	FILE* file = fopen(path, "r");
+	if (!file) return false;
+	char line[128];
+	while (fgets(line, sizeof(line), file)) {
+		if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+		for (char* c = line; *c; c++) {
+			if (*c == ',') *c = ' ';
+		}
+		track_sample s;
+		if (sscanf(line, "%lf %lf %lf", &s.altitude, &s.climbRate, &s.knots) != 3) {
+			fprintf(stderr, "bad sample %d: %s", (int)track.size(), line);
+			fclose(file);
+			return false;
+		}
+		track.push_back(s);
+	}
+	fclose(file);
+	return true;
+}
+
+// Minutes of arc in an IGC coordinate, DDMMmmm or DDDMMmmm and N, S, E or W
+static double igcMinutes(const char* text, int degreeDigits)
+{
+	int degrees = 0;
+	for (int i = 0; i < degreeDigits; i++) degrees = degrees * 10 + text[i] - '0';
+	double minutes = atoi(std::string(text + degreeDigits, 5).c_str()) / 1000.0;
+	char hemisphere = text[degreeDigits + 5];
+	double value = degrees * 60 + minutes;
+	return hemisphere == 'S' || hemisphere == 'W' ? -value : value;
+}
+
+// Meters between two fixes given in minutes of arc, close enough for a second apart
+static double igcDistance(double lat1, double lon1, double lat2, double lon2)
+{
+	const double metersPerMinute = 1852.0;
+	double x = (lon2 - lon1) * cos((lat1 + lat2) / 2 / 60 * M_PI / 180);
+	double y = lat2 - lat1;
+	return sqrt(x * x + y * y) * metersPerMinute;
+}
+
+static bool readIgc(const char* path, std::vector<track_sample>& track)
+{
+	FILE* file = fopen(path, "r");
+	if (!file) return false;
+	// Columns of the VAT extension, counted from 1, from the I-record
+	int vatStart = 0;
+	int vatEnd = 0;
+	long lastSeconds = -1;
+	double lastLat = 0;
+	double lastLon = 0;
+	std::vector<double> altitudes;
+	char line[256];
+	while (fgets(line, sizeof(line), file)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		if (line[0] == 'I' && strlen(line) >= 3) {
+			int count = (line[1] - '0') * 10 + line[2] - '0';
+			for (int i = 0; i < count && (int)strlen(line) >= 3 + (i + 1) * 7; i++) {
+				const char* extension = line + 3 + i * 7;
+				if (strncmp(extension + 4, "VAT", 3) == 0) {
+					vatStart = atoi(std::string(extension, 2).c_str());
+					vatEnd = atoi(std::string(extension + 2, 2).c_str());
+				}
+			}
+			continue;
+		}
+		if (line[0] != 'B' || strlen(line) < 35) continue;
+
+		long seconds = atoi(std::string(line + 1, 2).c_str()) * 3600L +
+			atoi(std::string(line + 3, 2).c_str()) * 60 + atoi(std::string(line + 5, 2).c_str());
+		// Past midnight, and one fix a second at most
+		while (lastSeconds >= 0 && seconds < lastSeconds - 43200) seconds += 86400;
+		if (lastSeconds >= 0 && seconds <= lastSeconds) continue;
+		double lat = igcMinutes(line + 7, 2);
+		double lon = igcMinutes(line + 15, 3);
+		double altitude = atoi(std::string(line + 25, 5).c_str());
+		bool fixed = line[24] == 'A';
+
+		// The seconds missed keep the last sample, without speed
+		for (long s = lastSeconds + 1; lastSeconds >= 0 && s < seconds; s++) {
+			track_sample missed = track.back();
+			missed.knots = -1;
+			track.push_back(missed);
+			altitudes.push_back(missed.altitude);
+		}
+		altitudes.push_back(altitude);
+		track_sample sample;
+		sample.altitude = altitude;
+		if (vatEnd >= vatStart && vatStart > 0 && (int)strlen(line) >= vatEnd) {
+			sample.climbRate = atoi(std::string(line + vatStart - 1, vatEnd - vatStart + 1).c_str()) / 10.0;
+		} else {
+			size_t back = altitudes.size() > 5 ? 5 : altitudes.size() - 1;
+			sample.climbRate = back ? (altitude - altitudes[altitudes.size() - 1 - back]) / back : 0;
+		}
+		sample.knots = -1;
+		if (fixed && lastSeconds >= 0) {
+			sample.knots = igcDistance(lastLat, lastLon, lat, lon) / (seconds - lastSeconds) * 3600 / 1852;
+		} else if (fixed) {
+			sample.knots = 0;
+		}
+		track.push_back(sample);
+		lastSeconds = seconds;
+		lastLat = lat;
+		lastLon = lon;
+	}
+	fclose(file);
+	return !track.empty();
+}
+
+static bool isIgc(const char* path)
+{
+	size_t length = strlen(path);
+	return length > 4 && strcasecmp(path + length - 4, ".igc") == 0;
+}
+
+// `seconds` of the same climb and speed, the altitude following the climb
+static void appendLeg(std::vector<track_sample>& track, int seconds, double climbRate, double knots)
+{
+	double altitude = track.empty() ? 500 : track.back().altitude;
+	for (int i = 0; i < seconds; i++) {
+		altitude += climbRate;
+		track.push_back({ altitude, climbRate, knots });
+	}
+}
+
+// Foot launch into a glide, landing in a field
+static std::vector<track_sample> launchRunTrack()
+{
+	std::vector<track_sample> track;
+	appendLeg(track, 60, 0, 0);
+	appendLeg(track, 540, -1, 20);
+	appendLeg(track, 120, 0, 0);
+	return track;
+}
+
+// Lifted off a hill in a thermal and glided down, no fix all flight
+static std::vector<track_sample> thermalNoFixTrack()
+{
+	std::vector<track_sample> track;
+	appendLeg(track, 30, 0, -1);
+	appendLeg(track, 300, 1.5, -1);
+	appendLeg(track, 300, -1.5, -1);
+	appendLeg(track, 60, 0, -1);
+	return track;
+}
+
+// Slow ridge soaring, off by climb with the speed under the takeoff's
+static std::vector<track_sample> ridgeTrack()
+{
+	std::vector<track_sample> track;
+	appendLeg(track, 40, 0, 0);
+	appendLeg(track, 60, 1.2, 4);
+	for (int beat = 0; beat < 15; beat++) {
+		appendLeg(track, 20, 0.5, 4);
+		appendLeg(track, 20, -0.5, 4);
+	}
+	appendLeg(track, 60, -1.1, 4);
+	appendLeg(track, 60, 0, 0);
+	return track;
+}
+
+// A pressure front on the ground, an hour of drift is no flight
+static std::vector<track_sample> driftTrack()
+{
+	std::vector<track_sample> track;
+	appendLeg(track, 3600, 0.05, 0);
+	return track;
+}
+
+// The glider carried back up the hill after landing, a short walk is not a takeoff
+static std::vector<track_sample> walkTrack()
+{
+	std::vector<track_sample> track = launchRunTrack();
+	appendLeg(track, 30, 0.3, 2.5);
+	appendLeg(track, 60, 0, 0);
+	return track;
+}
+
+static void printResult(const replay_result& result, int samples)
+{
+	printf("%d samples, takeoff %d %s, landing %d, %d flights", samples, result.takeoff,
+		result.takeoffReason, result.landing, result.flights);
+}
+
+// A track with a takeoff is expected to be one flight
+static bool check(const char* name, const std::vector<track_sample>& track, int takeoff, int landing,
+	int takeoffSeconds, int landingSeconds)
+{
+	replay_result result = replay(track, takeoffSeconds, landingSeconds);
+	bool ok = result.takeoff == takeoff && result.landing == landing && result.flights == (takeoff >= 0);
+	printf("%s %s: ", ok ? "ok  " : "FAIL", name);
+	printResult(result, track.size());
+	if (!ok) printf(", expected %d and %d", takeoff, landing);
+	printf("\n");
+	return ok;
+}
+
+static bool checkIgc(const char* path, int takeoff, int landing)
+{
+	std::vector<track_sample> track;
+	if (!readIgc(path, track)) {
+		printf("FAIL %s: cannot read it\n", path);
+		return false;
+	}
+	return check(path, track, takeoff, landing, 10, 30);
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1) {
+		std::vector<track_sample> track;
+		if (!(isIgc(argv[1]) ? readIgc(argv[1], track) : readTrack(argv[1], track))) {
+			fprintf(stderr, "cannot read %s\n", argv[1]);
+			return 1;
+		}
+		int takeoffSeconds = argc > 5 ? atoi(argv[4]) : 10;
+		int landingSeconds = argc > 5 ? atoi(argv[5]) : 30;
+		if (argc < 4) {
+			printResult(replay(track, takeoffSeconds, landingSeconds), track.size());
+			printf("\n");
+			return 0;
+		}
+		return check(argv[1], track, atoi(argv[2]), atoi(argv[3]), takeoffSeconds, landingSeconds) ? 0 : 1;
+	}
+
+	int failures = 0;
+	// The default TAKEOFF_SECONDS and LANDING_SECONDS
+	failures += !check("launch run", launchRunTrack(), 62, 625, 10, 30);
+	// Leaving the thermal is no landing
+	failures += !check("thermal without fix", thermalNoFixTrack(), 36, 656, 10, 30);
+	failures += !check("ridge", ridgeTrack(), 48, 785, 10, 30);
+	failures += !check("drift", driftTrack(), -1, -1, 10, 30);
+	failures += !check("walk back up", walkTrack(), 62, 625, 10, 30);
+	// Short windows react sooner
+	failures += !check("launch run, 5 s and 15 s", launchRunTrack(), 61, 612, 5, 15);
+	// Launch and touchdown are in each file's L-records. Landing back at the
+	// launch height, kiting and a parked glider bobbing in the ridge wind,
+	// and a walk out after a short flight must not start or end a flight.
+	failures += !checkIgc("tools/flightreplay/toplanding.igc", 210, 1762);
+	failures += !checkIgc("tools/flightreplay/ridge.igc", 250, 3676);
+	failures += !checkIgc("tools/flightreplay/sledride.igc", 94, 352);
+	return failures ? 1 : 0;
+}
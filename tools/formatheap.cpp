@@ -0,0 +1,220 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Runs the text the flight screens are made of through the formatters
+ *	and counts the heap allocations they make, which must be none. Each
+ *	case is checked against the text the vario shows. The flight screen
+ *	is then laid out the way updateLCD() does, on a display that keeps
+ *	its cells in RAM.
+ *
+ *	Build: c++ -O2 -o formatheap tools/formatheap.cpp
+ *	Usage: formatheap [ROUNDS]
+ *
+ *	A description() is made too, into a String long enough to be on the
+ *	heap, and the counter must see it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+#include "../src/Units/Measurement.h"
+#include "../src/Units/UnitLength.h"
+#include "../src/Units/UnitSpeed.h"
+#include "../src/ClockFormat.h"
+#include "../src/DisplayText.h"
+#include "../src/FlightScreen.h"
+
+// As in Arduino.ino
+#define CLIMB_BAR_CELLS 8
+
+static unsigned long allocations = 0;
+
+void* operator new(size_t size)
+{
+	allocations++;
+	void* p = malloc(size ? size : 1);
+	if (!p) throw std::bad_alloc();
+	return p;
+}
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+static int failures = 0;
+
+static void expect(const char* what, const char* text, const char* expected)
+{
+	if (strcmp(text, expected) == 0) return;
+	printf("FAIL %s: \"%s\", expected \"%s\"\n", what, text, expected);
+	failures++;
+}
+
+// The cells of a 16x2 display
+class HostDisplay
+{
+public:
+	HostDisplay() {
+		for (int row = 0; row < 2; row++) {
+			memset(m_cells[row], '#', 16);
+			m_cells[row][16] = '\0';
+		}
+	}
+	uint8_t columns() {
+		return 16;
+	}
+	void setText(uint8_t col, uint8_t row, const char* text, uint8_t length) {
+		memcpy(&m_cells[row][col], text, length);
+	}
+	const char* line(int row) const {
+		return m_cells[row];
+	}
+private:
+	char m_cells[2][17];
+};
+
+struct ScreenCase {
+	double knots;
+	double climbRate;
+	double altitude;
+	double distance;
+	bool metric;
+	bool climbBar;
+	bool totalDistance;
+	const char* expectedTop;
+	const char* expectedBottom;
+};
+
+// The bar cells are left as they were, shown here as #. Altitude and
+// distance are cut, not rounded, as on the vario.
+static const ScreenCase kScreens[] = {
+	{ 20, 1.234, 1234.6, 12.34, true, false, false, "01:02:05   1234m", "37kmh    1.24mps" },
+	{ 20, -0.51, 1234.6, 12.34, true, true, false, "01:02:05   1234m", "########-0.52mps" },
+	{ 20, 1.234, 1234.6, 12.34, true, false, true, "01:02:05   1234m", "12km     1.24mps" },
+	{ 20, 1.234, 1234.6, 12.34, false, false, false, "01:02:05  4050ft", "23mph     250fpm" },
+	{ 20, -2.5, 1234.6, 12.34, false, false, true, "01:02:05  4050ft", "7.75mi   -500fpm" },
+};
+
+static void runScreens()
+{
+	char time[CLOCK_TEXT_SIZE];
+	formatDuration(time, 3725);
+	for (size_t i = 0; i < sizeof(kScreens) / sizeof(kScreens[0]); i++) {
+		const ScreenCase& c = kScreens[i];
+		HostDisplay lcd;
+		flight_screen_text text;
+		formatFlightScreen(&text, c.knots, c.climbRate, c.altitude, c.distance, c.metric);
+		lcdSetLine(lcd, time, text.altitude, true);
+		if (c.climbBar) {
+			lcdSetRight(lcd, text.climbRate, CLIMB_BAR_CELLS, false);
+		} else if (c.totalDistance) {
+			lcdSetLine(lcd, text.distance, text.climbRate, false);
+		} else {
+			lcdSetLine(lcd, text.speed, text.climbRate, false);
+		}
+		expect("screen top", lcd.line(0), c.expectedTop);
+		expect("screen bottom", lcd.line(1), c.expectedBottom);
+	}
+}
+
+struct MeasureCase {
+	double value;
+	double step;
+	uint8_t decimals;
+	const char* suffix;
+	uint8_t width;
+	const char* expected;
+};
+
+static const MeasureCase kMeasures[] = {
+	{ 1234.56, 1, 0, "m", 0, "1235m" },
+	{ 2.345, 0.1, 1, "m/s", 7, " 2.3m/s" },
+	// Rounded once, not to the step and then again to the digits
+	{ -0.009, 0.01, 2, "m/s", 0, "-0.01m/s" },
+	{ -0.004, 0.01, 2, "m/s", 0, "0.00m/s" },
+	{ 3.3, 0.5, 1, "", 0, "3.5" },
+	{ 9.99, -1, 1, "km", 0, "9.9km" },
+	{ 0, 1, 0, "kt", 5, "  0kt" },
+};
+
+// Returns the allocations made
+static unsigned long runRound()
+{
+	unsigned long before = allocations;
+	char text[MEASUREMENT_TEXT_SIZE];
+	for (size_t i = 0; i < sizeof(kMeasures) / sizeof(kMeasures[0]); i++) {
+		const MeasureCase& c = kMeasures[i];
+		formatMeasure(text, sizeof(text), c.value, c.step, c.decimals, c.suffix, c.width);
+		expect("formatMeasure", text, c.expected);
+	}
+	// Too long for the buffer, left empty
+	char small[4];
+	expect("formatMeasure small", formatMeasure(small, sizeof(small), 12345, 1, 0, "") ? "?" : small, "");
+
+	Measurement<UnitSpeed> speed(10, UnitSpeed::metersPerSecond());
+	speed.convertedTo(UnitSpeed::kilometersPerHour(), 1).formatTo(text, sizeof(text));
+	expect("formatTo", text, "36kmh");
+	Measurement<UnitLength> distance(12.3456, UnitLength::kilometers(), 0.01);
+	distance.formatTo(text, sizeof(text), -1, 9);
+	expect("formatTo width", text, "  12.35km");
+
+	char clock[CLOCK_TEXT_SIZE];
+	formatClock(clock, 7, 5, 9);
+	expect("formatClock", clock, "07:05:09");
+	formatDuration(clock, 3725);
+	expect("formatDuration", clock, "01:02:05");
+	formatDuration(clock, 100 * 3600 + 59);
+	expect("formatDuration 100h", clock, "100:00:59");
+
+	runScreens();
+	return allocations - before;
+}
+
+int main(int argc, char** argv)
+{
+	long rounds = argc > 1 ? atol(argv[1]) : 1000;
+	if (rounds <= 0) {
+		fprintf(stderr, "usage: formatheap [ROUNDS]\n");
+		return 1;
+	}
+	unsigned long made = 0;
+	for (long i = 0; i < rounds && !failures; i++) {
+		made += runRound();
+	}
+
+	// The counter has to see an allocation when there is one
+	unsigned long before = allocations;
+	Measurement<UnitLength> altitude(1234.5678, UnitLength::meters(), 1);
+	String description = altitude.description();
+	expect("description", description.c_str(), "1235m");
+	description += " above the takeoff, on the way up";
+	bool counted = allocations > before;
+
+	printf("%ld rounds, %lu allocations\n", rounds, made);
+	if (!counted) {
+		printf("FAIL the allocation counter missed description()\n");
+		failures++;
+	}
+	if (made) {
+		printf("FAIL the formatters allocated\n");
+		failures++;
+	}
+	return failures ? 1 : 0;
+}
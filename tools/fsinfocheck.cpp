@@ -0,0 +1,136 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Checks the free cluster count FatLib keeps in the FAT32 FSINFO block:
+ *	it follows random creates, appends and removes, a remount takes it with
+ *	no reads, and a hint that is unknown or larger than the volume is
+ *	rebuilt from the FAT.
+ *
+ *	Build: c++ -O2 -DENABLE_ARDUINO_FEATURES=0 -o fsinfocheck tools/fsinfocheck.cpp \
+ *	         src/SdFat/FatLib/FatVolume.cpp src/SdFat/FatLib/FatFile.cpp \
+ *	         src/SdFat/FatLib/FatFileLFN.cpp src/SdFat/FatLib/FatFileSFN.cpp \
+ *	         src/SdFat/FatLib/FatFilePrint.cpp src/SdFat/FatLib/FmtNumber.cpp
+ *	Usage: fsinfocheck [OPERATIONS]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "HostBlockDriver.h"
+#include "HostFormat.h"
+#include "../src/SdFat/FatLib/FatFileSystem.h"
+
+#define RAM_VOLUME_BLOCKS 131072
+#define FSINFO_BLOCK 1
+#define FSINFO_FREE_COUNT 488
+#define FILE_NAMES 20
+
+static HostBlockDriver driver;
+static FatFileSystem fs;
+static int failures = 0;
+
+static void check(bool ok, const char* what, long value, long expected)
+{
+	printf("%s %s: %ld, expected %ld\n", ok ? "ok  " : "FAIL", what, value, expected);
+	failures += !ok;
+}
+
+// Free clusters counted straight from the first FAT on the RAM volume
+static long scanFat()
+{
+	const uint8_t* fat = driver.data() + (size_t)fs.vol()->fatStartBlock() * 512;
+	long free = 0;
+	for (uint32_t cluster = 2; cluster <= fs.vol()->clusterCount() + 1; cluster++) {
+		const uint8_t* entry = fat + cluster * 4;
+		uint32_t value = entry[0] | (entry[1] << 8) | (entry[2] << 16) | ((uint32_t)entry[3] << 24);
+		if ((value & 0x0FFFFFFF) == 0) free++;
+	}
+	return free;
+}
+
+static uint32_t fsInfoCount()
+{
+	const uint8_t* count = driver.data() + FSINFO_BLOCK * 512 + FSINFO_FREE_COUNT;
+	return count[0] | (count[1] << 8) | (count[2] << 16) | ((uint32_t)count[3] << 24);
+}
+
+// Written behind the mounted volume, after it has flushed its own count
+static void setFsInfoCount(uint32_t value)
+{
+	fs.vol()->cacheClear();
+	putUint32(driver.data() + FSINFO_BLOCK * 512 + FSINFO_FREE_COUNT, value);
+}
+
+// Mounts again and returns the free count, with the blocks read for it
+static long remountCount(uint32_t* reads)
+{
+	if (!fs.begin(&driver)) {
+		fprintf(stderr, "Could not mount the volume\n");
+		exit(1);
+	}
+	driver.resetCounters();
+	long free = fs.vol()->freeClusterCount();
+	*reads = driver.counters().blocksRead;
+	return free;
+}
+
+static void writeBytes(FatFile& file, long size)
+{
+	static uint8_t data[4096];
+	while (size > 0) {
+		long n = size < (long)sizeof(data) ? size : sizeof(data);
+		file.write(data, n);
+		size -= n;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	int operations = argc > 1 ? atoi(argv[1]) : 300;
+	driver.begin(RAM_VOLUME_BLOCKS);
+	formatFat32(driver);
+	uint32_t reads;
+
+	long free = remountCount(&reads);
+	check(free == scanFat() && reads > 0, "unknown count scanned", free, scanFat());
+
+	// Random flights: a new file, more data on one, or one removed
+	srand(1);
+	char name[16];
+	int mismatches = 0;
+	for (int i = 0; i < operations; i++) {
+		FatFile file;
+		snprintf(name, sizeof(name), "F%02d.IGC", rand() % FILE_NAMES);
+		int op = rand() % 3;
+		if (op == 0 && file.open(fs.vwd(), name, O_CREAT | O_WRITE | O_TRUNC)) {
+			writeBytes(file, rand() % 40000);
+			file.close();
+		} else if (op == 1 && file.open(fs.vwd(), name, O_CREAT | O_WRITE | O_APPEND)) {
+			writeBytes(file, rand() % 20000);
+			file.close();
+		} else if (op == 2 && file.open(fs.vwd(), name, O_WRITE)) {
+			file.remove();
+		}
+		long kept = fs.vol()->freeClusterCount();
+		long scanned = scanFat();
+		if (kept != scanned || fsInfoCount() != (uint32_t)scanned) mismatches++;
+	}
+	check(mismatches == 0, "operations with a wrong count or FSINFO", mismatches, 0);
+
+	long expected = scanFat();
+	free = remountCount(&reads);
+	check(free == expected && reads == 0, "remount reads", reads, 0);
+
+	setFsInfoCount(0xFFFFFFFF);
+	free = remountCount(&reads);
+	check(free == expected && reads > 0, "0xFFFFFFFF hint rescanned", free, expected);
+
+	setFsInfoCount(fs.vol()->clusterCount() + 1);
+	free = remountCount(&reads);
+	check(free == expected && reads > 0, "hint above the clusters rescanned", free, expected);
+
+	// The rescan is written back on the next sync
+	fs.vol()->cacheClear();
+	check(fsInfoCount() == (uint32_t)expected, "FSINFO after the rescan", fsInfoCount(), expected);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,66 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Just enough of the Teensy core to build the display code on a
+ *	computer, for the tools built with -Itools/host. src/i2c_t3.h is empty
+ *	off the Teensy, so the fake I2C bus of HostWire.h comes with it.
+ */
+
+#ifndef HostArduino_h
+#define HostArduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+template<class T> static inline T min(T a, T b)
+{
+	return a < b ? a : b;
+}
+template<class T> static inline T max(T a, T b)
+{
+	return a > b ? a : b;
+}
+
+// The bus calls back at once. A tool can set an interrupt to land the next
+// time interrupts come back on, defined with Wire.
+extern void (*hostPendingInterrupt)();
+static inline void noInterrupts() {}
+static inline void interrupts()
+{
+	void (*interrupt)() = hostPendingInterrupt;
+	hostPendingInterrupt = NULL;
+	if (interrupt) interrupt();
+}
+// Time stands still, the bus schedule always finds a gap
+static inline uint32_t micros()
+{
+	return 0;
+}
+static inline uint32_t millis()
+{
+	return 0;
+}
+
+class Print
+{
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t value) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size) {
+		size_t n = 0;
+		while (size--) n += write(*buffer++);
+		return n;
+	}
+	size_t write(const char* text) {
+		return write((const uint8_t*)text, strlen(text));
+	}
+	size_t print(const char* text) {
+		return write(text);
+	}
+};
+
+#include "HostWire.h"
+
+#endif
@@ -0,0 +1,99 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	An i2c_t3 bus for the host tools. Transfers complete at once and go
+ *	to the HostI2CDevice attached to their address, background ones call
+ *	the master done hook like the bus interrupt would.
+ */
+
+#ifndef HostWire_h
+#define HostWire_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum i2c_mode { I2C_MASTER, I2C_SLAVE };
+enum i2c_pins { I2C_PINS_18_19, I2C_PINS_29_30 };
+enum i2c_pullup { I2C_PULLUP_EXT, I2C_PULLUP_INT };
+enum i2c_op_mode { I2C_OP_MODE_IMM, I2C_OP_MODE_ISR, I2C_OP_MODE_DMA };
+enum i2c_stop { I2C_NOSTOP, I2C_STOP };
+enum i2c_status { I2C_WAITING, I2C_SENDING, I2C_SEND_ADDR, I2C_RECEIVING, I2C_TIMEOUT, I2C_ADDR_NAK,
+	I2C_DATA_NAK, I2C_ARB_LOST, I2C_BUF_OVF };
+
+class HostI2CDevice
+{
+public:
+	virtual ~HostI2CDevice() {}
+	// One write transfer, without the address byte
+	virtual void received(const uint8_t* data, size_t size) = 0;
+};
+
+class i2c_t3
+{
+public:
+	void begin(i2c_mode mode, uint8_t address, i2c_pins pins, i2c_pullup pullup, uint32_t rate,
+		i2c_op_mode opMode = I2C_OP_MODE_ISR) {}
+	void onMasterDone(void (*hook)()) {
+		m_masterDone = hook;
+	}
+	// Transfers to `address`, any other address is not acknowledged
+	void attach(uint8_t address, HostI2CDevice* device) {
+		m_deviceAddress = address;
+		m_device = device;
+	}
+
+	void beginTransmission(uint8_t address) {
+		m_address = address;
+		m_size = 0;
+	}
+	size_t write(uint8_t value) {
+		if (m_size == sizeof(m_buffer)) return 0;
+		m_buffer[m_size++] = value;
+		return 1;
+	}
+	size_t write(const uint8_t* data, size_t size) {
+		size_t n = 0;
+		while (n < size && write(data[n])) n++;
+		return n;
+	}
+	uint8_t endTransmission() {
+		return deliver() ? 0 : 2;
+	}
+	void sendTransmission() {
+		deliver();
+		if (m_masterDone) m_masterDone();
+	}
+	void sendRequest(uint8_t address, size_t bytes, i2c_stop stop) {
+		m_status = I2C_ADDR_NAK;
+		if (m_masterDone) m_masterDone();
+	}
+	uint8_t done() {
+		return 1;
+	}
+	uint8_t finish(uint32_t timeout = 0) {
+		return m_status == I2C_WAITING;
+	}
+	i2c_status status() {
+		return m_status;
+	}
+private:
+	bool deliver() {
+		bool ok = m_device && m_address == m_deviceAddress;
+		m_status = ok ? I2C_WAITING : I2C_ADDR_NAK;
+		if (ok) m_device->received(m_buffer, m_size);
+		return ok;
+	}
+
+	void (*m_masterDone)() { NULL };
+	HostI2CDevice* m_device { NULL };
+	uint8_t m_deviceAddress { 0 };
+	uint8_t m_address { 0 };
+	uint8_t m_buffer[259];
+	size_t m_size { 0 };
+	i2c_status m_status { I2C_WAITING };
+};
+
+extern i2c_t3 Wire;
+
+#endif
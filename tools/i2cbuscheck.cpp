@@ -0,0 +1,80 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Runs the barometer's timer and chain against I2CBus the way MS5611
+ *	drives it, with a tick landing at the worst moments, and checks that
+ *	every conversion is started by a tick and only once.
+ *
+ *	Build: c++ -O2 -Itools/host -o i2cbuscheck tools/i2cbuscheck.cpp src/I2CBus.cpp
+ *	Usage: i2cbuscheck
+ */
+
+#include <stdio.h>
+#include "../src/I2CBus.h"
+
+i2c_t3 Wire;
+void (*hostPendingInterrupt)() = NULL;
+
+static I2CBus bus(Wire);
+static int starts = 0;
+static bool chainActive = false;
+
+// As MS5611::start, the chain's first transfer is on its way
+static void start(void* context, bool ok)
+{
+	chainActive = true;
+	starts++;
+}
+
+// As MS5611::endChain
+static void endChain()
+{
+	chainActive = false;
+	bus.release();
+}
+
+// As MS5611::tick, a chain still running a period later has hung
+static void tick()
+{
+	if (chainActive) endChain();
+	bus.acquireAsync(I2CBus::kBaro, start, NULL);
+}
+
+static int failures = 0;
+
+static void check(const char* what, int value, int expected)
+{
+	bool ok = value == expected;
+	printf("%s %s: %d, expected %d\n", ok ? "ok  " : "FAIL", what, value, expected);
+	failures += !ok;
+}
+
+int main()
+{
+	// Free bus, the tick starts the chain at once
+	tick();
+	check("free bus, starts", starts, 1);
+	endChain();
+
+	// The display holds the bus, the tick waits and starts on release
+	starts = 0;
+	bus.acquire(I2CBus::kDisplay);
+	tick();
+	check("display holding, starts", starts, 0);
+	bus.release();
+	check("display released, starts", starts, 1);
+	endChain();
+
+	// The next tick lands as the bus is handed over. It may end the chain
+	// and start its own, but the end of a chain starts nothing by itself.
+	starts = 0;
+	bus.acquire(I2CBus::kDisplay);
+	tick();
+	hostPendingInterrupt = tick;
+	bus.release();
+	int started = starts;
+	endChain();
+	check("handoff with a tick, starts by the chain's end", starts - started, 0);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Turns a binary flight log (.svl) back into the IGC file the vario
+ *	would have written.
+ *
+ *	Build: c++ -O2 -o igcexport tools/igcexport.cpp
+ *	Usage: igcexport FLIGHT.svl [FLIGHT.igc]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "FlightLogReader.h"
+
+static bool readFile(const char* path, std::vector<uint8_t>& data)
+{
+	FILE* file = fopen(path, "rb");
+	if (!file) return false;
+	uint8_t buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer + n);
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3) {
+		fprintf(stderr, "usage: %s FLIGHT.svl [FLIGHT.igc]\n", argv[0]);
+		return 2;
+	}
+	std::vector<uint8_t> data;
+	if (!readFile(argv[1], data)) {
+		fprintf(stderr, "%s: cannot read %s\n", argv[0], argv[1]);
+		return 1;
+	}
+	std::string igc;
+	flight_log_export result;
+	const char* error = exportFlightLog(data, igc, &result);
+	if (error) {
+		fprintf(stderr, "%s: %s: %s\n", argv[0], argv[1], error);
+		return 1;
+	}
+
+	FILE* out = argc == 3 ? fopen(argv[2], "wb") : stdout;
+	if (!out) {
+		fprintf(stderr, "%s: cannot write %s\n", argv[0], argv[2]);
+		return 1;
+	}
+	fwrite(igc.data(), 1, igc.size(), out);
+	if (out != stdout) fclose(out);
+	fprintf(stderr, "%lu fixes", result.fixes);
+	if (result.skipped) fprintf(stderr, ", %lu damaged bytes skipped", result.skipped);
+	fprintf(stderr, "\n");
+	return 0;
+}
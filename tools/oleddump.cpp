@@ -0,0 +1,283 @@
+/**
+ *	SimpleVario!!
+ *	Copyright Pedro Enrique
+ *
+ *	Draws a screen of text through OledDisplay and writes what the panel
+ *	shows as a PBM image, so screens can be looked at and compared
+ *	without the vario. The pages go over a fake I2C bus into a model of
+ *	the controller's RAM, SH1106 column offset included. Each text line is
+ *	a row of the grid.
+ *
+ *	Build: c++ -O2 -Itools/host -o oleddump tools/oleddump.cpp \
+ *	         src/OledDisplay.cpp src/OledFrame.cpp src/I2CBus.cpp
+ *	Usage: oleddump [-sh1106] COLS ROWS SCREEN.pbm [LINE]... [-- LINE...]
+ *
+ *	With a second set of lines after "--" the first screen is sent, then
+ *	the second is drawn over it and sent a page at a time by update(), and
+ *	the pages that went out are listed. Without arguments the screens in
+ *	tools/oleddump are drawn on both controllers and compared with their
+ *	images, so run it from the top of the repository.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "../src/OledDisplay.h"
+
+// The SH1106 has RAM for 132 columns
+#define PANEL_RAM_COLUMNS 132
+
+i2c_t3 Wire;
+void (*hostPendingInterrupt)() = NULL;
+
+/**
+ * The controller at the other end of the bus: commands set the page and
+ * column, data fills the RAM from there. The panel shows 128 columns from
+ * `offset`, in the orientation the init commands set for the module.
+ */
+class HostOledPanel : public HostI2CDevice
+{
+public:
+	HostOledPanel(int offset) : m_offset(offset) {
+		memset(m_ram, 0, sizeof(m_ram));
+	}
+	void received(const uint8_t* data, size_t size) {
+		if (size == 0) return;
+		if (data[0] == 0x00) {
+			for (size_t i = 1; i < size; i++) {
+				i += command(data[i]);
+			}
+			return;
+		}
+		// Single commands, each after its control byte, then the pixels
+		size_t i = 0;
+		while (i + 1 < size && data[i] == 0x80) {
+			command(data[i + 1]);
+			i += 2;
+		}
+		if (i < size && data[i] == 0x40) {
+			m_pages |= 1 << m_page;
+			for (i++; i < size && m_column < PANEL_RAM_COLUMNS; i++) {
+				m_ram[m_page][m_column++] = data[i];
+			}
+		}
+	}
+	bool pixel(int x, int y) const {
+		return m_ram[y / 8][x + m_offset] & (1 << (y % 8));
+	}
+	bool on() const {
+		return m_on;
+	}
+	// Pages written since the last call, bit n for page n
+	uint8_t takePages() {
+		uint8_t pages = m_pages;
+		m_pages = 0;
+		return pages;
+	}
+private:
+	// Returns the parameter bytes that follow
+	size_t command(uint8_t value) {
+		if (value >= 0xB0 && value <= 0xB7) m_page = value & 0x07;
+		else if (value <= 0x0F) m_column = (m_column & 0xF0) | value;
+		else if (value >= 0x10 && value <= 0x1F) m_column = (m_column & 0x0F) | ((value & 0x0F) << 4);
+		else if (value == 0xAF) m_on = true;
+		else if (value == 0xAE) m_on = false;
+		switch (value) {
+			case 0x20: case 0x81: case 0x8D: case 0xA8: case 0xAD:
+			case 0xD3: case 0xD5: case 0xD9: case 0xDA: case 0xDB:
+				return 1;
+			default:
+				return 0;
+		}
+	}
+
+	uint8_t m_ram[OLED_PAGES][PANEL_RAM_COLUMNS];
+	int m_offset;
+	uint8_t m_page { 0 };
+	uint8_t m_column { 0 };
+	bool m_on { false };
+	uint8_t m_pages { 0 };
+};
+
+// A display on its own bus, as wired on the vario
+struct host_screen {
+	i2c_t3 wire;
+	I2CBus bus;
+	HostOledPanel panel;
+	OledDisplay display;
+
+	host_screen(bool sh1106, int cols, int rows) :
+		bus(wire),
+		panel(sh1106 ? SH1106_COLUMN_OFFSET : 0),
+		display(OLED_ADDRESS, cols, rows, sh1106 ? OledDisplay::kSH1106 : OledDisplay::kSSD1306) {
+		wire.attach(OLED_ADDRESS, &panel);
+		bus.begin(I2C_PINS_18_19);
+		display.setBus(&bus);
+		display.begin(cols, rows);
+		panel.takePages();
+	}
+};
+
+static void drawLines(OledDisplay& display, const std::vector<std::string>& lines)
+{
+	for (size_t row = 0; row < lines.size() && row < display.rows(); row++) {
+		std::string line = lines[row];
+		line.resize(display.columns(), ' ');
+		display.setText(0, row, line.c_str(), display.columns());
+	}
+}
+
+// A page at a time, the way the main loop sends a screen
+static int sendByUpdate(OledDisplay& display)
+{
+	int updates = 1;
+	while (!display.update()) updates++;
+	return updates;
+}
+
+static std::string panelImage(const HostOledPanel& panel)
+{
+	std::string image;
+	char header[32];
+	snprintf(header, sizeof(header), "P1\n%d %d\n", OLED_WIDTH, OLED_HEIGHT);
+	image = header;
+	for (int y = 0; y < OLED_HEIGHT; y++) {
+		for (int x = 0; x < OLED_WIDTH; x++) {
+			image += panel.pixel(x, y) ? '1' : '0';
+		}
+		image += '\n';
+	}
+	return image;
+}
+
+static bool readFile(const char* path, std::string& text)
+{
+	FILE* file = fopen(path, "r");
+	if (!file) return false;
+	char buffer[4096];
+	size_t n;
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, n);
+	fclose(file);
+	return true;
+}
+
+static void printPages(uint8_t pages)
+{
+	printf("pages:");
+	for (int page = 0; page < OLED_PAGES; page++) {
+		if (pages & (1 << page)) printf(" %d", page);
+	}
+	printf("\n");
+}
+
+struct ScreenCase {
+	const char* name;
+	std::vector<std::string> first;
+	std::vector<std::string> second;
+	// Pages the second screen changes, 0 without one
+	uint8_t pages;
+};
+
+// The flight screen, the next one a second later, and the results with
+// only their bottom line changed
+static const ScreenCase kScreens[] = {
+	{ "flight", { "12:34:56   1234m", "37kmh    1.24mps" }, {}, 0 },
+	{ "flightnext", { "12:34:56   1234m", "37kmh    1.24mps" }, { "12:34:57   1234m", "36kmh    1.30mps" }, 0x66 },
+	{ "results", { "FLIGHT 01:02:05", "MAX 1850m 3.4mps" }, { "FLIGHT 01:02:05", "DIST 12km" }, 0x60 },
+};
+
+static int checkScreens()
+{
+	int failures = 0;
+	// One on each bus, the vario's Wire and Wire1
+	host_screen ssd1306(false, 16, 2);
+	host_screen sh1106(true, 16, 2);
+	host_screen* screens[] = { &ssd1306, &sh1106 };
+	for (size_t i = 0; i < sizeof(kScreens) / sizeof(kScreens[0]); i++) {
+		const ScreenCase& c = kScreens[i];
+		std::string path = std::string("tools/oleddump/") + c.name + ".pbm";
+		std::string expected;
+		if (!readFile(path.c_str(), expected)) {
+			printf("FAIL %s: cannot read it\n", path.c_str());
+			failures++;
+			continue;
+		}
+		for (int s = 0; s < 2; s++) {
+			host_screen& screen = *screens[s];
+			screen.display.clear();
+			drawLines(screen.display, c.first);
+			screen.display.refresh();
+			uint8_t pages = 0;
+			if (!c.second.empty()) {
+				screen.panel.takePages();
+				drawLines(screen.display, c.second);
+				sendByUpdate(screen.display);
+				pages = screen.panel.takePages();
+			}
+			std::string image = panelImage(screen.panel);
+			int wrong = 0;
+			for (size_t p = 0; p < image.size() && p < expected.size(); p++) {
+				wrong += image[p] != expected[p];
+			}
+			bool ok = image.size() == expected.size() && wrong == 0 && pages == c.pages && screen.panel.on();
+			printf("%s %s on the %s: %d pixels differ, pages sent %02X, expected %02X\n",
+				ok ? "ok  " : "FAIL", path.c_str(), s ? "SH1106" : "SSD1306", wrong, pages, c.pages);
+			failures += !ok;
+		}
+	}
+	return failures;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 1) {
+		return checkScreens() ? 1 : 0;
+	}
+	bool sh1106 = strcmp(argv[1], "-sh1106") == 0;
+	argv += sh1106;
+	argc -= sh1106;
+	if (argc < 4) {
+		fprintf(stderr, "usage: oleddump [-sh1106] COLS ROWS SCREEN.pbm [LINE]... [-- LINE...]\n");
+		return 1;
+	}
+	int cols = atoi(argv[1]);
+	int rows = atoi(argv[2]);
+	if (cols <= 0 || rows <= 0 || cols > DISPLAY_MAX_COLS || rows > DISPLAY_MAX_ROWS) {
+		fprintf(stderr, "bad grid %sx%s, at most %dx%d\n", argv[1], argv[2], DISPLAY_MAX_COLS, DISPLAY_MAX_ROWS);
+		return 1;
+	}
+	std::vector<std::string> first;
+	std::vector<std::string> second;
+	bool split = false;
+	for (int i = 4; i < argc; i++) {
+		if (!split && strcmp(argv[i], "--") == 0) {
+			split = true;
+			continue;
+		}
+		(split ? second : first).push_back(argv[i]);
+	}
+
+	host_screen screen(sh1106, cols, rows);
+	const OledFrame& frame = screen.display.frame();
+	printf("%dx%d cells of %dx%d pixels\n", frame.columns(), frame.rows(), frame.cellWidth(), frame.cellHeight());
+	drawLines(screen.display, first);
+	screen.display.refresh();
+	if (split) {
+		// Sent, only the second screen's changes go out
+		screen.panel.takePages();
+		uint32_t bytes = screen.display.bytesSent();
+		drawLines(screen.display, second);
+		int updates = sendByUpdate(screen.display);
+		printPages(screen.panel.takePages());
+		printf("%d updates, %u bytes\n", updates, (unsigned)(screen.display.bytesSent() - bytes));
+	}
+
+	std::string image = panelImage(screen.panel);
+	FILE* file = fopen(argv[3], "w");
+	if (!file || fwrite(image.data(), 1, image.size(), file) != image.size() || fclose(file) != 0) {
+		fprintf(stderr, "cannot write %s\n", argv[3]);
+		return 1;
+	}
+	return 0;
+}